@@ -0,0 +1,23 @@
+# Keep a lot of large objects (anything bigger than the largest small-object size class) alive,
+# and then time a number of collections; every pointer into one of them has to get resolved back
+# to its object while marking.
+import gc
+import time
+
+def make_large(n):
+    # 512 pointers, so the backing array is 4KB:
+    return [n] * 512
+
+def f():
+    live = [make_large(i) for i in xrange(20000)]
+    # plus more large objects that point to those:
+    refs = [live[i:i + 600] for i in xrange(0, 20000, 600)]
+
+    start = time.time()
+    for i in xrange(20):
+        gc.collect()
+    elapsed = time.time() - start
+
+    print len(live), len(refs)
+    print "%d collections in %.2fs" % (20, elapsed)
+f()
@@ -14,6 +14,8 @@
 
 #include "analysis/scoping_analysis.h"
 
+#include <algorithm>
+
 #include "core/ast.h"
 #include "core/common.h"
 #include "core/util.h"
@@ -81,6 +83,17 @@ static bool isCompilerCreatedName(const std::string& name) {
     return name[0] == '!' || name[0] == '#';
 }
 
+int ScopeInfo::getLocalSlot(const std::string& name) {
+    auto it = local_slots.find(name);
+    if (it != local_slots.end())
+        return it->second;
+
+    int slot = local_slot_names.size();
+    local_slots[name] = slot;
+    local_slot_names.push_back(name);
+    return slot;
+}
+
 class ModuleScopeInfo : public ScopeInfo {
 public:
     ScopeInfo* getParent() override { return NULL; }
@@ -160,6 +173,15 @@ public:
         assert(parent);
         assert(usage);
         assert(ast);
+
+        std::vector<std::string> locals;
+        for (const std::string& name : usage->written) {
+            if (!refersToGlobal(name) && !refersToClosure(name))
+                locals.push_back(name);
+        }
+        std::sort(locals.begin(), locals.end());
+        for (const std::string& name : locals)
+            getLocalSlot(name);
     }
 
     ~ScopeInfoBase() override { delete this->usage; }
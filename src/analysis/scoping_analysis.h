@@ -23,6 +23,10 @@ class AST;
 class AST_Module;
 
 class ScopeInfo {
+private:
+    std::unordered_map<std::string, int> local_slots;
+    std::vector<std::string> local_slot_names;
+
 public:
     ScopeInfo() {}
     virtual ~ScopeInfo() {}
@@ -42,6 +46,14 @@ public:
     virtual const std::unordered_set<std::string>& getClassDefLocalNames() = 0;
 
     virtual std::string mangleName(const std::string& id) = 0;
+
+    // The interpreter keeps the scope's locals in a flat array instead of a map keyed by name; these hand out the
+    // indices into it.  The names that the analysis saw getting stored to get the first slots, and any other names
+    // (ie the temporaries that the CFG creates) get the next free slot the first time they're asked about, so the
+    // number of slots can grow.
+    int getLocalSlot(const std::string& name);
+    int getNumLocalSlots() const { return local_slot_names.size(); }
+    const std::string& getLocalSlotName(int slot) const { return local_slot_names[slot]; }
 };
 
 class ScopingAnalysis {
@@ -621,7 +621,40 @@ void Assembler::inc(Register reg) {
 }
 
 void Assembler::inc(Indirect mem) {
-    UNIMPLEMENTED();
+    int src_idx = mem.base.regnum;
+
+    int rex = REX_W;
+    if (src_idx >= 8) {
+        rex |= REX_B;
+        src_idx -= 8;
+    }
+
+    assert(src_idx >= 0 && src_idx < 8);
+
+    emitRex(rex);
+    emitByte(0xff);
+
+    bool needssib = (src_idx == 0b100);
+
+    // A base of rbp/r13 with mode 0b00 means rip-relative addressing, so those always need a displacement:
+    int mode;
+    if (mem.offset == 0 && src_idx != 0b101)
+        mode = 0b00;
+    else if (-0x80 <= mem.offset && mem.offset < 0x80)
+        mode = 0b01;
+    else
+        mode = 0b10;
+
+    emitModRM(mode, 0, src_idx);
+
+    if (needssib)
+        emitSIB(0b00, 0b100, src_idx);
+
+    if (mode == 0b01) {
+        emitByte(mem.offset);
+    } else if (mode == 0b10) {
+        emitInt(mem.offset, 4);
+    }
 }
 
 
@@ -634,6 +667,18 @@ void Assembler::callq(Register r) {
     emitByte(0xd3);
 }
 
+void Assembler::jmpq(Register r) {
+    int reg_idx = r.regnum;
+    if (reg_idx >= 8) {
+        emitRex(REX_B);
+        reg_idx -= 8;
+    }
+    assert(reg_idx >= 0 && reg_idx < 8);
+
+    emitByte(0xff);
+    emitModRM(0b11, 0b100, reg_idx);
+}
+
 void Assembler::retq() {
     emitByte(0xc3);
 }
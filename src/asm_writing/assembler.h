@@ -129,6 +129,7 @@ public:
     void inc(Indirect mem);
 
     void callq(Register reg);
+    void jmpq(Register reg);
     void retq();
 
     void cmp(Register reg1, Register reg2);
@@ -159,6 +160,7 @@ public:
     void emitAnnotation(int num);
 
     uint8_t* curInstPointer() { return addr; }
+    int bytesLeft() { return end_addr - addr; }
     bool isExactlyFull() { return addr == end_addr; }
 };
 
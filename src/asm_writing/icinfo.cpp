@@ -24,6 +24,7 @@
 #include "codegen/patchpoints.h"
 #include "core/common.h"
 #include "core/options.h"
+#include "core/stats.h"
 #include "core/types.h"
 
 namespace pyston {
@@ -91,6 +92,10 @@ void ICSlotRewrite::commit(uint64_t decision_path, CommitHook* hook) {
     if (ic_entry == NULL)
         return;
 
+    static StatCounter ic_rewrites("ic_rewrites");
+    ic_rewrites.log();
+    ic->num_rewrites++;
+
     for (int i = 0; i < dependencies.size(); i++) {
         ICInvalidator* invalidator = dependencies[i].first;
         invalidator->addDependent(ic_entry);
@@ -99,6 +104,18 @@ void ICSlotRewrite::commit(uint64_t decision_path, CommitHook* hook) {
     uint8_t* slot_start = (uint8_t*)ic->start_addr + ic_entry->idx * ic->getSlotSize();
     uint8_t* continue_point = (uint8_t*)ic->continue_addr;
 
+    // Count the hits on this slot; this goes after all of the guards, right before the jump back to the
+    // continue point.  It has to leave every register alone, so it borrows r11 by pushing it.  If it doesn't fit,
+    // the slot just never looks hit, which makes it the first to get evicted.
+    static const int HIT_COUNTER_BYTES = 17, MAX_JMP_BYTES = 5;
+    if (assembler->bytesLeft() >= HIT_COUNTER_BYTES + MAX_JMP_BYTES) {
+        int64_t* num_hits = &ic->slots[ic_entry->idx].num_hits;
+        assembler->push(R11);
+        assembler->mov(Immediate(num_hits), R11);
+        assembler->inc(Indirect(R11, 0));
+        assembler->pop(R11);
+    }
+
     hook->finishAssembly(continue_point - slot_start);
 
     assert(assembler->isExactlyFull());
@@ -145,7 +162,12 @@ ICSlotRewrite* ICInfo::startRewrite(const char* debug_name) {
     return new ICSlotRewrite(this, debug_name);
 }
 
+// How many recent hits on an IC's slots make up for one eviction.
+static const int64_t IC_EVICTION_DECAY_HITS = 1000;
+
 ICSlotInfo* ICInfo::pickEntryForRewrite(uint64_t decision_path, const char* debug_name) {
+    assert(!megamorphic);
+
     for (int i = 0; i < getNumSlots(); i++) {
         SlotInfo& sinfo = slots[i];
         if (!sinfo.is_patched) {
@@ -155,31 +177,85 @@ ICSlotInfo* ICInfo::pickEntryForRewrite(uint64_t decision_path, const char* debu
 
             sinfo.is_patched = true;
             sinfo.decision_path = decision_path;
+            sinfo.num_hits = 0;
             return &sinfo.entry;
         }
     }
 
-    int num_slots = getNumSlots();
-    for (int _i = 0; _i < num_slots; _i++) {
-        int i = (_i + next_slot_to_try) % num_slots;
-
+    // All the slots are in use, so evict the compatible one that has been hit the least recently-ish:
+    int victim = -1;
+    for (int i = 0; i < getNumSlots(); i++) {
         SlotInfo& sinfo = slots[i];
-        if (sinfo.is_patched && sinfo.decision_path != decision_path) {
+        if (sinfo.decision_path != decision_path)
             continue;
-        }
 
-        if (VERBOSITY()) {
-            printf("committing %s icentry to in-use slot %d at %p\n", debug_name, i, start_addr);
-        }
-        next_slot_to_try++;
+        if (victim == -1 || sinfo.num_hits < slots[victim].num_hits)
+            victim = i;
+    }
+
+    if (victim == -1) {
+        if (VERBOSITY())
+            printf("not committing %s icentry since it is not compatible (%lx)\n", debug_name, decision_path);
+        return NULL;
+    }
 
-        sinfo.is_patched = true;
-        sinfo.decision_path = decision_path;
-        return &sinfo.entry;
+    static StatCounter ic_evictions("ic_evictions");
+    ic_evictions.log();
+#if !DISABLE_STATS
+    Stats::log(Stats::getStatId(std::string("ic_evictions_") + debug_name));
+#endif
+
+    // Evictions that are spread out between lots of hits are just the IC's working set shifting over time, not
+    // thrashing, so they get forgotten the same way that the hits do:
+    int64_t recent_hits = 0;
+    for (SlotInfo& sinfo : slots) {
+        recent_hits += sinfo.num_hits;
     }
+    if (recent_hits >= IC_EVICTION_DECAY_HITS)
+        num_evictions /= 2;
+    num_evictions++;
+
+    if (num_evictions > IC_MEGAMORPHIC_EVICTIONS) {
+        becomeMegamorphic(debug_name);
+        return NULL;
+    }
+
+    // Age the counts, so that slots that were hot a while ago don't stick around forever:
+    for (SlotInfo& sinfo : slots) {
+        sinfo.num_hits /= 2;
+    }
+
+    SlotInfo& sinfo = slots[victim];
+    if (VERBOSITY()) {
+        printf("committing %s icentry to in-use slot %d at %p\n", debug_name, victim, start_addr);
+    }
+
+    sinfo.is_patched = true;
+    sinfo.decision_path = decision_path;
+    sinfo.num_hits = 0;
+    return &sinfo.entry;
+}
+
+void ICInfo::becomeMegamorphic(const char* debug_name) {
+    assert(!megamorphic);
+    megamorphic = true;
+
+    static StatCounter ic_megamorphic("ic_megamorphic_transitions");
+    ic_megamorphic.log();
+#if !DISABLE_STATS
+    Stats::log(Stats::getStatId(std::string("ic_megamorphic_") + debug_name));
+#endif
+
     if (VERBOSITY())
-        printf("not committing %s icentry since it is not compatible (%lx)\n", debug_name, decision_path);
-    return NULL;
+        printf("%s ic at %p is megamorphic after %ld rewrites and %ld evictions\n", debug_name, start_addr,
+               num_rewrites, num_evictions);
+
+    // There's no point in running through guards that are unlikely to pass, so send everything straight to the
+    // slowpath:
+    for (SlotInfo& sinfo : slots) {
+        if (sinfo.is_patched)
+            clear(&sinfo.entry);
+    }
 }
 
 
@@ -187,7 +263,7 @@ ICSlotInfo* ICInfo::pickEntryForRewrite(uint64_t decision_path, const char* debu
 ICInfo::ICInfo(void* start_addr, void* slowpath_rtn_addr, void* continue_addr, StackInfo stack_info, int num_slots,
                int slot_size, llvm::CallingConv::ID calling_conv, const std::unordered_set<int>& live_outs,
                assembler::GenericRegister return_register, TypeRecorder* type_recorder)
-    : next_slot_to_try(0), stack_info(stack_info), num_slots(num_slots), slot_size(slot_size),
+    : num_rewrites(0), num_evictions(0), megamorphic(false), stack_info(stack_info), num_slots(num_slots), slot_size(slot_size),
       calling_conv(calling_conv), live_outs(live_outs.begin(), live_outs.end()), return_register(return_register),
       type_recorder(type_recorder), failed(false), start_addr(start_addr), slowpath_rtn_addr(slowpath_rtn_addr),
       continue_addr(continue_addr) {
@@ -267,6 +343,10 @@ void ICInfo::clear(ICSlotInfo* icentry) {
     if (VERBOSITY())
         printf("clearing patchpoint %p, slot at %p\n", start_addr, start);
 
+    // The slot is free for the next rewrite:
+    slots[icentry->idx].is_patched = false;
+    slots[icentry->idx].num_hits = 0;
+
     std::unique_ptr<Assembler> writer(new Assembler(start, getSlotSize()));
     writer->nop();
     writer->jmp(JumpDestination::fromStart(getSlotSize()));
@@ -279,6 +359,6 @@ void ICInfo::clear(ICSlotInfo* icentry) {
 }
 
 bool ICInfo::shouldAttempt() {
-    return !failed;
+    return !failed && !megamorphic;
 }
 }
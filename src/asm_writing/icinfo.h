@@ -84,16 +84,23 @@ private:
     struct SlotInfo {
         bool is_patched;
         uint64_t decision_path;
+        // Incremented by the slot's code every time it gets all the way through its guards (see
+        // ICSlotRewrite::commit), and halved on every eviction from this IC, so it approximates how much the slot
+        // has been hit recently.
+        int64_t num_hits;
         ICSlotInfo entry;
 
-        SlotInfo(ICInfo* ic, int idx) : is_patched(false), decision_path(0), entry(ic, idx) {}
+        SlotInfo(ICInfo* ic, int idx) : is_patched(false), decision_path(0), num_hits(0), entry(ic, idx) {}
     };
+    // The generated code points into this, so it must not get resized after construction:
     std::vector<SlotInfo> slots;
-    // For now, just use a round-robin eviction policy.
-    // This is probably a bunch worse than LRU, but it's also
-    // probably a bunch better than the "always evict slot #0" policy
-    // that it's replacing.
-    int next_slot_to_try;
+
+    // num_evictions gets halved whenever the slots were hit a lot since the previous eviction, so it only keeps
+    // growing while the IC thrashes.
+    int64_t num_rewrites, num_evictions;
+    // Set once the IC has had to evict more than IC_MEGAMORPHIC_EVICTIONS times without that decay; after that it
+    // stops getting rewritten, and all its calls go straight to the slowpath (which has its own lookup caches).
+    bool megamorphic;
 
     const StackInfo stack_info;
     const int num_slots;
@@ -106,6 +113,7 @@ private:
 
     // for ICSlotRewrite:
     ICSlotInfo* pickEntryForRewrite(uint64_t decision_path, const char* debug_name);
+    void becomeMegamorphic(const char* debug_name);
 
 public:
     ICInfo(void* start_addr, void* slowpath_rtn_addr, void* continue_addr, StackInfo stack_info, int num_slots,
@@ -122,6 +130,7 @@ public:
     void clear(ICSlotInfo* entry);
 
     bool shouldAttempt();
+    bool isMegamorphic() { return megamorphic; }
 
     friend class ICSlotRewrite;
 };
@@ -14,11 +14,15 @@
 
 #include "codegen/ast_interpreter.h"
 
-#include <llvm/ADT/StringMap.h>
+#include <algorithm>
 #include <unordered_map>
 
+#include "llvm/ADT/SmallVector.h"
+
 #include "analysis/function_analysis.h"
 #include "analysis/scoping_analysis.h"
+#include "codegen/baseline_jit.h"
+#include "codegen/bytecode.h"
 #include "codegen/codegen.h"
 #include "codegen/compvars.h"
 #include "codegen/irgen.h"
@@ -26,6 +30,8 @@
 #include "codegen/irgen/irgenerator.h"
 #include "codegen/irgen/util.h"
 #include "codegen/osrentry.h"
+#include "codegen/tiering.h"
+#include "codegen/unwinding.h"
 #include "core/ast.h"
 #include "core/cfg.h"
 #include "core/common.h"
@@ -42,9 +48,6 @@
 
 namespace pyston {
 
-#define OSR_THRESHOLD 100
-#define REOPT_THRESHOLD 10
-
 union Value {
     bool b;
     int64_t n;
@@ -59,21 +62,72 @@ union Value {
 
 class ASTInterpreter {
 public:
-    typedef llvm::StringMap<Box*> SymMap;
-
     ASTInterpreter(CompiledFunction* compiled_function);
 
     void initArguments(int nargs, BoxedClosure* closure, BoxedGenerator* generator, Box* arg1, Box* arg2, Box* arg3,
                        Box** args);
-    static Value execute(ASTInterpreter& interpreter, AST_stmt* start_at = NULL);
+    // Sets up the interpreter to take over a compiled frame that's getting deoptimized.
+    void initFromFrameState(const FrameStackState& frame_state);
+    // If start_at is given, this is continuing a deoptimized frame that stopped in the middle of that
+    // statement, with deopt_value being the value of the statement's expression.
+    static Value execute(ASTInterpreter& interpreter, AST_stmt* start_at = NULL, Box* deopt_value = NULL);
 
 private:
     Box* createFunction(AST* node, AST_arguments* args, const std::vector<AST_stmt*>& body);
     Value doBinOp(Box* left, Box* right, int op, BinExpType exp_type);
     void doStore(AST_expr* node, Value value);
     void doStore(const std::string& name, Value value);
+    void doStore(AST_Name* node, Value value);
+    AST_Name::LookupType getLookupType(AST_Name* node);
+    // Returns the frame's storage for the local in the given slot (see ScopeInfo::getLocalSlot), which is NULL if
+    // the local isn't defined.  The reference is only good until the next new name gets a slot.
+    Box*& getLocal(int slot);
+    Box*& getLocal(const std::string& name) { return getLocal(scope_info->getLocalSlot(name)); }
     void eraseDeadSymbols();
 
+    // Runs the bytecode starting at the given instruction, until the function returns.
+    Value run(int start_pc);
+    int finishDeoptedStmt(int pc, Box* deopt_value);
+    void finishDeoptedStmt(AST_stmt* node, Box* deopt_value);
+    // The code for each of the instructions that fall through to the next one:
+    void execAssign(const BytecodeInstr* instr);
+    void execStoreName(const BytecodeInstr* instr);
+    void execExpr(const BytecodeInstr* instr);
+    void execStmt(const BytecodeInstr* instr);
+    void execLoad(const BytecodeInstr* instr);
+    void execBinOp(const BytecodeInstr* instr);
+    void execAugBinOp(const BytecodeInstr* instr);
+    void execCompare(const BytecodeInstr* instr);
+    void execGetattr(const BytecodeInstr* instr);
+    void execGetitem(const BytecodeInstr* instr);
+    void execCall(const BytecodeInstr* instr);
+    void execCallattr(const BytecodeInstr* instr);
+    // Helpers for the register instructions:
+    Box* readOperand(const BytecodeInstr* instr, int i);
+    void setResult(const BytecodeInstr* instr, Box* value) {
+        if (instr->dst != -1)
+            getLocal(instr->dst) = value;
+    }
+    // These return the index of the next instruction:
+    int doBranch(const BytecodeInstr* instr);
+    int doInvoke(const BytecodeInstr* instr);
+    // Returns true if this OSR'd out of the interpreter, in which case the rest of the function has already been
+    // run, and rtn is its return value.
+    bool doBackedge(const BytecodeInstr* instr, Value& rtn);
+
+    bool shouldUseBaselineJit();
+    BaselineCode* getBaselineCode();
+    // The entry points that baseline-JIT'd code calls; see BaselineJitHandlers.
+    template <void (ASTInterpreter::*exec)(const BytecodeInstr*)>
+    static void baselineFallthrough(ASTInterpreter* interpreter, const BytecodeInstr* instr) {
+        interpreter->current_inst = instr->stmt;
+        (interpreter->*exec)(instr);
+    }
+    static uint64_t baselineBranch(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+    static uint64_t baselineInvoke(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+    static Box* baselineBackedge(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+    static Box* baselineReturn(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+
     Value visit_assert(AST_Assert* node);
     Value visit_assign(AST_Assign* node);
     Value visit_binop(AST_BinOp* node);
@@ -110,18 +164,16 @@ private:
 
     // pseudo
     Value visit_augBinOp(AST_AugBinOp* node);
-    Value visit_branch(AST_Branch* node);
     Value visit_clsAttribute(AST_ClsAttribute* node);
-    Value visit_invoke(AST_Invoke* node);
-    Value visit_jump(AST_Jump* node);
     Value visit_langPrimitive(AST_LangPrimitive* node);
 
     CompiledFunction* compiled_func;
     SourceInfo* source_info;
     ScopeInfo* scope_info;
+    Bytecode* bytecode;
 
-    SymMap sym_table;
-    CFGBlock* next_block, *current_block;
+    std::vector<Box*> locals;
+    CFGBlock* current_block;
     AST_stmt* current_inst;
     ExcInfo last_exception;
     BoxedClosure* passed_closure, *created_closure;
@@ -137,7 +189,7 @@ public:
 
     CompiledFunction* getCF() { return compiled_func; }
     FrameInfo* getFrameInfo() { return &frame_info; }
-    const SymMap& getSymbolTable() { return sym_table; }
+    BoxedDict* getLocalsDict(bool only_user_visible);
     void gcVisit(GCVisitor* visitor);
 };
 
@@ -148,16 +200,19 @@ static std::unordered_map<void*, ASTInterpreter*> s_interpreterMap;
 
 Box* astInterpretFunction(CompiledFunction* cf, int nargs, Box* closure, Box* generator, Box* arg1, Box* arg2,
                           Box* arg3, Box** args) {
-    if (unlikely(cf->times_called > REOPT_THRESHOLD)) {
+    if (unlikely(cf->times_called > getReoptThreshold(EffortLevel::INTERPRETED))) {
         CompiledFunction* optimized = reoptCompiledFuncInternal(cf);
-        if (closure && generator)
-            return optimized->closure_generator_call((BoxedClosure*)closure, (BoxedGenerator*)generator, arg1, arg2,
-                                                     arg3, args);
-        else if (closure)
-            return optimized->closure_call((BoxedClosure*)closure, arg1, arg2, arg3, args);
-        else if (generator)
-            return optimized->generator_call((BoxedGenerator*)generator, arg1, arg2, arg3, args);
-        return optimized->call(arg1, arg2, arg3, args);
+        // With background compilation, we keep interpreting until the compiled version is ready:
+        if (optimized != cf) {
+            if (closure && generator)
+                return optimized->closure_generator_call((BoxedClosure*)closure, (BoxedGenerator*)generator, arg1,
+                                                         arg2, arg3, args);
+            else if (closure)
+                return optimized->closure_call((BoxedClosure*)closure, arg1, arg2, arg3, args);
+            else if (generator)
+                return optimized->generator_call((BoxedGenerator*)generator, arg1, arg2, arg3, args);
+            return optimized->call(arg1, arg2, arg3, args);
+        }
     }
 
     ++cf->times_called;
@@ -169,12 +224,14 @@ Box* astInterpretFunction(CompiledFunction* cf, int nargs, Box* closure, Box* ge
     return v.o ? v.o : None;
 }
 
-Box* astInterpretFrom(CompiledFunction* cf, AST_stmt* start_at, BoxedDict* locals) {
-    assert(locals->d.size() == 0);
+Box* astInterpretFrom(const FrameStackState& frame_state, Box* deopt_value) {
+    assert(frame_state.cf);
+    assert(frame_state.current_stmt);
 
-    ASTInterpreter interpreter(cf);
+    ASTInterpreter interpreter(frame_state.cf);
+    interpreter.initFromFrameState(frame_state);
 
-    Value v = ASTInterpreter::execute(interpreter, start_at);
+    Value v = ASTInterpreter::execute(interpreter, frame_state.current_stmt, deopt_value);
 
     return v.o ? v.o : None;
 }
@@ -200,19 +257,27 @@ FrameInfo* getFrameInfoForInterpretedFrame(void* frame_ptr) {
 BoxedDict* localsForInterpretedFrame(void* frame_ptr, bool only_user_visible) {
     ASTInterpreter* interpreter = s_interpreterMap[frame_ptr];
     assert(interpreter);
+    return interpreter->getLocalsDict(only_user_visible);
+}
+
+BoxedDict* ASTInterpreter::getLocalsDict(bool only_user_visible) {
     BoxedDict* rtn = new BoxedDict();
-    for (auto&& l : interpreter->getSymbolTable()) {
-        if (only_user_visible && (l.getKey()[0] == '!' || l.getKey()[0] == '#'))
+    for (int i = 0; i < locals.size(); i++) {
+        if (!locals[i])
             continue;
 
-        rtn->d[new BoxedString(l.getKey())] = l.getValue();
+        const std::string& name = scope_info->getLocalSlotName(i);
+        if (only_user_visible && (name[0] == '!' || name[0] == '#'))
+            continue;
+
+        rtn->d[new BoxedString(name)] = locals[i];
     }
     return rtn;
 }
 
 void ASTInterpreter::gcVisit(GCVisitor* visitor) {
-    for (const auto& p2 : getSymbolTable()) {
-        visitor->visitPotential(p2.second);
+    for (Box* b : locals) {
+        visitor->visitPotential(b);
     }
 
     if (passed_closure)
@@ -231,7 +296,7 @@ void gatherInterpreterRoots(GCVisitor* visitor) {
 
 
 ASTInterpreter::ASTInterpreter(CompiledFunction* compiled_function)
-    : compiled_func(compiled_function), source_info(compiled_function->clfunc->source), scope_info(0), next_block(0),
+    : compiled_func(compiled_function), source_info(compiled_function->clfunc->source), scope_info(0), bytecode(0),
       current_block(0), current_inst(0), last_exception(NULL, NULL, NULL), passed_closure(0), created_closure(0),
       generator(0), edgecount(0), frame_info(ExcInfo(NULL, NULL, NULL)) {
 
@@ -240,6 +305,11 @@ ASTInterpreter::ASTInterpreter(CompiledFunction* compiled_function)
         source_info->cfg = computeCFG(f->source, f->source->body);
 
     scope_info = source_info->getScopeInfo();
+    locals.resize(scope_info->getNumLocalSlots(), NULL);
+
+    if (!source_info->bytecode)
+        source_info->bytecode = compileBytecode(source_info);
+    bytecode = source_info->bytecode;
 }
 
 void ASTInterpreter::initArguments(int nargs, BoxedClosure* _closure, BoxedGenerator* _generator, Box* arg1, Box* arg2,
@@ -258,8 +328,7 @@ void ASTInterpreter::initArguments(int nargs, BoxedClosure* _closure, BoxedGener
     if (source_info->arg_names.args) {
         for (AST_expr* e : *source_info->arg_names.args) {
             RELEASE_ASSERT(e->type == AST_TYPE::Name, "not implemented");
-            AST_Name* name = (AST_Name*)e;
-            doStore(name->id, argsArray[i++]);
+            doStore(ast_cast<AST_Name>(e), argsArray[i++]);
         }
     }
 
@@ -272,6 +341,24 @@ void ASTInterpreter::initArguments(int nargs, BoxedClosure* _closure, BoxedGener
     }
 }
 
+void ASTInterpreter::initFromFrameState(const FrameStackState& frame_state) {
+    for (const auto& p : frame_state.locals->d) {
+        assert(p.first->cls == str_cls);
+        const std::string& name = static_cast<BoxedString*>(p.first)->s;
+
+        if (name == PASSED_GENERATOR_NAME)
+            generator = static_cast<BoxedGenerator*>(p.second);
+        else if (name == PASSED_CLOSURE_NAME)
+            passed_closure = static_cast<BoxedClosure*>(p.second);
+        else if (name == CREATED_CLOSURE_NAME)
+            created_closure = static_cast<BoxedClosure*>(p.second);
+        else if (name[0] != '!')
+            getLocal(name) = p.second;
+    }
+
+    frame_info = *frame_state.frame_info;
+}
+
 namespace {
 class RegisterHelper {
 private:
@@ -288,26 +375,173 @@ public:
 };
 }
 
-Value ASTInterpreter::execute(ASTInterpreter& interpreter, AST_stmt* start_at) {
+Value ASTInterpreter::execute(ASTInterpreter& interpreter, AST_stmt* start_at, Box* deopt_value) {
     threading::allowGLReadPreemption();
 
-    assert(start_at == NULL);
-
     void* frame_addr = __builtin_frame_address(0);
     RegisterHelper frame_registerer(&interpreter, frame_addr);
 
-    Value v;
-    interpreter.next_block = interpreter.source_info->cfg->getStartingBlock();
-    while (interpreter.next_block) {
-        interpreter.current_block = interpreter.next_block;
-        interpreter.next_block = 0;
-
-        for (AST_stmt* s : interpreter.current_block->body) {
-            interpreter.current_inst = s;
-            v = interpreter.visit_stmt(s);
-        }
+    if (start_at == NULL)
+        return interpreter.run(0);
+
+    int pc = interpreter.bytecode->indexOf(start_at);
+    RELEASE_ASSERT(pc != -1, "couldn't find the statement to resume at");
+    return interpreter.run(interpreter.finishDeoptedStmt(pc, deopt_value));
+}
+
+Value ASTInterpreter::run(int start_pc) {
+    if (shouldUseBaselineJit())
+        return Value(getBaselineCode()->execute(this, start_pc));
+
+    // Dispatch with computed gotos; this table has to be in the same order as BytecodeOp:
+    static void* const dispatch_table[] = {
+        &&op_PASS,     &&op_ASSIGN,  &&op_STORE_NAME, &&op_EXPR,     &&op_STMT,   &&op_LOAD,
+        &&op_BINOP,    &&op_AUGBINOP, &&op_COMPARE,   &&op_GETATTR,  &&op_GETITEM, &&op_CALL,
+        &&op_CALLATTR, &&op_BRANCH,  &&op_JUMP,       &&op_BACKEDGE, &&op_INVOKE, &&op_RETURN,
+    };
+    static_assert(sizeof(dispatch_table) / sizeof(dispatch_table[0]) == (int)BytecodeOp::NUM_OPS,
+                  "dispatch table doesn't match BytecodeOp");
+
+    const BytecodeInstr* const instrs = &bytecode->instrs[0];
+    const BytecodeInstr* pc = &instrs[start_pc];
+
+#define DISPATCH()                                                                                                     \
+    do {                                                                                                               \
+        current_block = pc->block;                                                                                     \
+        current_inst = pc->stmt;                                                                                       \
+        goto* dispatch_table[(int)pc->op];                                                                             \
+    } while (0)
+#define NEXT()                                                                                                         \
+    do {                                                                                                               \
+        ++pc;                                                                                                          \
+        DISPATCH();                                                                                                    \
+    } while (0)
+#define JUMP(target)                                                                                                   \
+    do {                                                                                                               \
+        pc = &instrs[(target)];                                                                                        \
+        DISPATCH();                                                                                                    \
+    } while (0)
+
+    DISPATCH();
+
+op_PASS:
+    NEXT();
+op_ASSIGN:
+    execAssign(pc);
+    NEXT();
+op_STORE_NAME:
+    execStoreName(pc);
+    NEXT();
+op_EXPR:
+    execExpr(pc);
+    NEXT();
+op_STMT:
+    execStmt(pc);
+    NEXT();
+op_LOAD:
+    execLoad(pc);
+    NEXT();
+op_BINOP:
+    execBinOp(pc);
+    NEXT();
+op_AUGBINOP:
+    execAugBinOp(pc);
+    NEXT();
+op_COMPARE:
+    execCompare(pc);
+    NEXT();
+op_GETATTR:
+    execGetattr(pc);
+    NEXT();
+op_GETITEM:
+    execGetitem(pc);
+    NEXT();
+op_CALL:
+    execCall(pc);
+    NEXT();
+op_CALLATTR:
+    execCallattr(pc);
+    NEXT();
+op_BRANCH:
+    JUMP(doBranch(pc));
+op_JUMP:
+    JUMP(pc->target);
+op_BACKEDGE: {
+    Value rtn;
+    if (doBackedge(pc, rtn))
+        return rtn;
+    if (shouldUseBaselineJit())
+        return Value(getBaselineCode()->execute(this, pc->target));
+    JUMP(pc->target);
+}
+op_INVOKE:
+    JUMP(doInvoke(pc));
+op_RETURN:
+    return visit_return(static_cast<AST_Return*>(pc->stmt));
+
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+}
+
+bool ASTInterpreter::shouldUseBaselineJit() {
+    // Interpreters that are continuing a deoptimized frame don't count as interpreted, and stay in the
+    // interpreter proper:
+    if (!ENABLE_BASELINE_JIT || BASELINE_JIT_THRESHOLD == 0 || !compiled_func->is_interpreted)
+        return false;
+    return source_info->baseline_code || compiled_func->times_called + edgecount >= BASELINE_JIT_THRESHOLD;
+}
+
+BaselineCode* ASTInterpreter::getBaselineCode() {
+    if (!source_info->baseline_code) {
+        static const BaselineJitHandlers handlers = []() {
+            BaselineJitHandlers h{};
+            h.fallthrough[(int)BytecodeOp::ASSIGN] = baselineFallthrough<&ASTInterpreter::execAssign>;
+            h.fallthrough[(int)BytecodeOp::STORE_NAME] = baselineFallthrough<&ASTInterpreter::execStoreName>;
+            h.fallthrough[(int)BytecodeOp::EXPR] = baselineFallthrough<&ASTInterpreter::execExpr>;
+            h.fallthrough[(int)BytecodeOp::STMT] = baselineFallthrough<&ASTInterpreter::execStmt>;
+            h.fallthrough[(int)BytecodeOp::LOAD] = baselineFallthrough<&ASTInterpreter::execLoad>;
+            h.fallthrough[(int)BytecodeOp::BINOP] = baselineFallthrough<&ASTInterpreter::execBinOp>;
+            h.fallthrough[(int)BytecodeOp::AUGBINOP] = baselineFallthrough<&ASTInterpreter::execAugBinOp>;
+            h.fallthrough[(int)BytecodeOp::COMPARE] = baselineFallthrough<&ASTInterpreter::execCompare>;
+            h.fallthrough[(int)BytecodeOp::GETATTR] = baselineFallthrough<&ASTInterpreter::execGetattr>;
+            h.fallthrough[(int)BytecodeOp::GETITEM] = baselineFallthrough<&ASTInterpreter::execGetitem>;
+            h.fallthrough[(int)BytecodeOp::CALL] = baselineFallthrough<&ASTInterpreter::execCall>;
+            h.fallthrough[(int)BytecodeOp::CALLATTR] = baselineFallthrough<&ASTInterpreter::execCallattr>;
+            h.branch = baselineBranch;
+            h.invoke = baselineInvoke;
+            h.backedge = baselineBackedge;
+            h.ret = baselineReturn;
+            return h;
+        }();
+        source_info->baseline_code = compileBaseline(source_info, bytecode, handlers);
     }
-    return v;
+    return source_info->baseline_code;
+}
+
+uint64_t ASTInterpreter::baselineBranch(ASTInterpreter* interpreter, const BytecodeInstr* instr) {
+    interpreter->current_inst = instr->stmt;
+    return interpreter->doBranch(instr) == instr->target;
+}
+
+uint64_t ASTInterpreter::baselineInvoke(ASTInterpreter* interpreter, const BytecodeInstr* instr) {
+    interpreter->current_inst = instr->stmt;
+    return interpreter->doInvoke(instr) == instr->target;
+}
+
+Box* ASTInterpreter::baselineBackedge(ASTInterpreter* interpreter, const BytecodeInstr* instr) {
+    interpreter->current_inst = instr->stmt;
+    interpreter->current_block = instr->block;
+
+    Value rtn;
+    if (!interpreter->doBackedge(instr, rtn))
+        return NULL;
+    return rtn.o ? rtn.o : None;
+}
+
+Box* ASTInterpreter::baselineReturn(ASTInterpreter* interpreter, const BytecodeInstr* instr) {
+    interpreter->current_inst = instr->stmt;
+    return interpreter->visit_return(static_cast<AST_Return*>(instr->stmt)).o;
 }
 
 void ASTInterpreter::eraseDeadSymbols() {
@@ -318,17 +552,51 @@ void ASTInterpreter::eraseDeadSymbols() {
         source_info->phis
             = computeRequiredPhis(source_info->arg_names, source_info->cfg, source_info->liveness, scope_info);
 
-    std::vector<std::string> dead_symbols;
-    for (auto&& it : sym_table) {
-        if (!source_info->liveness->isLiveAtEnd(it.getKey(), current_block)) {
-            dead_symbols.push_back(it.getKey());
-        } else if (source_info->phis->isRequiredAfter(it.getKey(), current_block)) {
-            assert(!scope_info->refersToGlobal(it.getKey()));
+    for (int i = 0; i < locals.size(); i++) {
+        if (!locals[i])
+            continue;
+
+        const std::string& name = scope_info->getLocalSlotName(i);
+        if (!source_info->liveness->isLiveAtEnd(name, current_block)) {
+            locals[i] = NULL;
+        } else if (source_info->phis->isRequiredAfter(name, current_block)) {
+            assert(!scope_info->refersToGlobal(name));
         } else {
         }
     }
-    for (auto&& dead : dead_symbols)
-        sym_table.erase(dead);
+}
+
+// The compiled code stops in the middle of the statement, right after evaluating its expression (see
+// IRGeneratorImpl::canDeoptToInterpreter), so all that's left to do is whatever comes after that.  Returns the
+// index of the instruction to continue at.
+int ASTInterpreter::finishDeoptedStmt(int pc, Box* deopt_value) {
+    const BytecodeInstr* instr = &bytecode->instrs[pc];
+    current_block = instr->block;
+    current_inst = instr->stmt;
+
+    AST_stmt* node = instr->stmt;
+    if (node->type == AST_TYPE::Invoke) {
+        AST_Invoke* invoke = ast_cast<AST_Invoke>(node);
+        try {
+            finishDeoptedStmt(invoke->stmt, deopt_value);
+            return instr->target;
+        } catch (ExcInfo e) {
+            last_exception = e;
+            return instr->alt_target;
+        }
+    }
+
+    finishDeoptedStmt(node, deopt_value);
+    return pc + 1;
+}
+
+void ASTInterpreter::finishDeoptedStmt(AST_stmt* node, Box* deopt_value) {
+    if (node->type == AST_TYPE::Assign) {
+        for (AST_expr* e : ast_cast<AST_Assign>(node)->targets)
+            doStore(e, deopt_value);
+    } else {
+        RELEASE_ASSERT(node->type == AST_TYPE::Expr, "%d", node->type);
+    }
 }
 
 Value ASTInterpreter::doBinOp(Box* left, Box* right, int op, BinExpType exp_type) {
@@ -352,16 +620,39 @@ void ASTInterpreter::doStore(const std::string& name, Value value) {
     if (scope_info->refersToGlobal(name)) {
         setattr(source_info->parent_module, name.c_str(), value.o);
     } else {
-        sym_table[name] = value.o;
+        getLocal(name) = value.o;
         if (scope_info->saveInClosure(name))
             setattr(created_closure, name.c_str(), value.o);
     }
 }
 
+AST_Name::LookupType ASTInterpreter::getLookupType(AST_Name* node) {
+    return resolveName(source_info, node);
+}
+
+Box*& ASTInterpreter::getLocal(int slot) {
+    assert(slot >= 0);
+    // Names that the scoping analysis didn't know about get their slots as they're first seen, which might be after
+    // this frame was set up:
+    if (unlikely(slot >= locals.size()))
+        locals.resize(scope_info->getNumLocalSlots(), NULL);
+    return locals[slot];
+}
+
+void ASTInterpreter::doStore(AST_Name* node, Value value) {
+    AST_Name::LookupType lookup_type = getLookupType(node);
+    if (lookup_type == AST_Name::GLOBAL) {
+        setattr(source_info->parent_module, node->id.c_str(), value.o);
+    } else {
+        getLocal(node->local_slot) = value.o;
+        if (lookup_type == AST_Name::DEREF)
+            setattr(created_closure, node->id.c_str(), value.o);
+    }
+}
+
 void ASTInterpreter::doStore(AST_expr* node, Value value) {
     if (node->type == AST_TYPE::Name) {
-        AST_Name* name = (AST_Name*)node;
-        doStore(name->id, value);
+        doStore((AST_Name*)node, value);
     } else if (node->type == AST_TYPE::Attribute) {
         AST_Attribute* attr = (AST_Attribute*)node;
         setattr(visit_expr(attr->value).o, attr->attr.c_str(), value.o);
@@ -410,25 +701,117 @@ Value ASTInterpreter::visit_slice(AST_Slice* node) {
     return createSlice(lower.o, upper.o, step.o);
 }
 
-Value ASTInterpreter::visit_branch(AST_Branch* node) {
-    Value v = visit_expr(node->test);
-    ASSERT(v.o == True || v.o == False, "Should have called NONZERO before this branch");
+void ASTInterpreter::execAssign(const BytecodeInstr* instr) {
+    visit_assign(static_cast<AST_Assign*>(instr->stmt));
+}
 
-    if (v.o == True)
-        next_block = node->iftrue;
-    else
-        next_block = node->iffalse;
-    return Value();
+void ASTInterpreter::execStoreName(const BytecodeInstr* instr) {
+    AST_Assign* node = static_cast<AST_Assign*>(instr->stmt);
+    doStore(static_cast<AST_Name*>(node->targets[0]), visit_expr(node->value));
+}
+
+void ASTInterpreter::execExpr(const BytecodeInstr* instr) {
+    visit_expr(static_cast<AST_Expr*>(instr->stmt));
+}
+
+void ASTInterpreter::execStmt(const BytecodeInstr* instr) {
+    visit_stmt(instr->stmt);
 }
 
-Value ASTInterpreter::visit_jump(AST_Jump* node) {
-    bool backedge = node->target->idx < current_block->idx && compiled_func;
-    if (backedge)
-        threading::allowGLReadPreemption();
+Box* ASTInterpreter::readOperand(const BytecodeInstr* instr, int i) {
+    const BytecodeOperand& operand = bytecode->getOperand(instr, i);
+    if (operand.slot == -1)
+        return visit_expr(operand.expr).o;
+
+    Box* value = getLocal(operand.slot);
+    if (unlikely(!value))
+        assertNameDefined(0, ast_cast<AST_Name>(operand.expr)->id.c_str(), UnboundLocalError, true);
+    return value;
+}
+
+void ASTInterpreter::execLoad(const BytecodeInstr* instr) {
+    setResult(instr, readOperand(instr, 0));
+}
+
+void ASTInterpreter::execBinOp(const BytecodeInstr* instr) {
+    Box* left = readOperand(instr, 0);
+    Box* right = readOperand(instr, 1);
+    setResult(instr, doBinOp(left, right, instr->arg, BinExpType::BinOp).o);
+}
+
+void ASTInterpreter::execAugBinOp(const BytecodeInstr* instr) {
+    Box* left = readOperand(instr, 0);
+    Box* right = readOperand(instr, 1);
+    setResult(instr, doBinOp(left, right, instr->arg, BinExpType::AugBinOp).o);
+}
+
+void ASTInterpreter::execCompare(const BytecodeInstr* instr) {
+    Box* left = readOperand(instr, 0);
+    Box* right = readOperand(instr, 1);
+    setResult(instr, doBinOp(left, right, instr->arg, BinExpType::Compare).o);
+}
+
+void ASTInterpreter::execGetattr(const BytecodeInstr* instr) {
+    setResult(instr, getattr(readOperand(instr, 0), instr->attr));
+}
+
+void ASTInterpreter::execGetitem(const BytecodeInstr* instr) {
+    Box* value = readOperand(instr, 0);
+    Box* slice = readOperand(instr, 1);
+    setResult(instr, getitem(value, slice));
+}
+
+void ASTInterpreter::execCall(const BytecodeInstr* instr) {
+    Box* func = readOperand(instr, 0);
+
+    // The arguments stay on the stack, where the GC can see them:
+    int nargs = instr->num_operands - 1;
+    llvm::SmallVector<Box*, 8> args(nargs);
+    for (int i = 0; i < nargs; i++)
+        args[i] = readOperand(instr, i + 1);
+
+    setResult(instr, runtimeCall(func, ArgPassSpec(nargs), nargs > 0 ? args[0] : 0, nargs > 1 ? args[1] : 0,
+                                 nargs > 2 ? args[2] : 0, nargs > 3 ? &args[3] : 0, NULL));
+}
+
+void ASTInterpreter::execCallattr(const BytecodeInstr* instr) {
+    Box* obj = readOperand(instr, 0);
+
+    int nargs = instr->num_operands - 1;
+    llvm::SmallVector<Box*, 8> args(nargs);
+    for (int i = 0; i < nargs; i++)
+        args[i] = readOperand(instr, i + 1);
+
+    CallattrFlags flags({.cls_only = instr->arg != 0, .null_on_nonexistent = false });
+    setResult(instr, callattr(obj, instr->attr.getPtr(), flags, ArgPassSpec(nargs), nargs > 0 ? args[0] : 0,
+                              nargs > 1 ? args[1] : 0, nargs > 2 ? args[2] : 0, nargs > 3 ? &args[3] : 0, NULL));
+}
+
+int ASTInterpreter::doBranch(const BytecodeInstr* instr) {
+    Box* v = readOperand(instr, 0);
+    ASSERT(v == True || v == False, "Should have called NONZERO before this branch");
+
+    if (v == True)
+        return instr->target;
+    return instr->alt_target;
+}
+
+bool ASTInterpreter::doBackedge(const BytecodeInstr* instr, Value& rtn) {
+    AST_Jump* node = static_cast<AST_Jump*>(instr->stmt);
+
+    threading::allowGLReadPreemption();
+    ++edgecount;
+
+    // Interpreters that are continuing a deoptimized frame OSR back into compiled code too, so that a loop
+    // whose speculation failed once doesn't run the rest of its iterations in the interpreter.  The OSR entry
+    // is keyed on the deoptimized version, so later deopts from that version reuse the compiled loop.
+    if (ENABLE_OSR) {
+        if (edgecount > getOSRThreshold(EffortLevel::INTERPRETED)) {
+            if (!compiled_func->is_interpreted) {
+                static StatCounter sc_deopt_osr("num_osr_from_deopt");
+                sc_deopt_osr.log();
+            }
 
-    if (ENABLE_OSR && backedge) {
-        ++edgecount;
-        if (edgecount > OSR_THRESHOLD) {
             eraseDeadSymbols();
 
             const OSREntryDescriptor* found_entry = nullptr;
@@ -445,19 +828,17 @@ Value ASTInterpreter::visit_jump(AST_Jump* node) {
 
             auto phis = compiled_func->clfunc->source->phis;
             for (auto& name : phis->definedness.getDefinedNamesAtEnd(current_block)) {
-                auto it = sym_table.find(name);
                 if (!compiled_func->clfunc->source->liveness->isLiveAtEnd(name, current_block))
                     continue;
 
+                Box* value = getLocal(name);
                 if (phis->isPotentiallyUndefinedAfter(name, current_block)) {
-                    bool is_defined = it != sym_table.end();
+                    bool is_defined = value != NULL;
                     sorted_symbol_table[getIsDefinedName(name)] = (Box*)is_defined;
-                    if (is_defined)
-                        assert(it->getValue() != NULL);
-                    sorted_symbol_table[name] = is_defined ? it->getValue() : NULL;
+                    sorted_symbol_table[name] = value;
                 } else {
-                    ASSERT(it != sym_table.end(), "%s", name.c_str());
-                    sorted_symbol_table[it->getKey()] = it->getValue();
+                    ASSERT(value, "%s", name.c_str());
+                    sorted_symbol_table[name] = value;
                 }
             }
 
@@ -501,29 +882,26 @@ Value ASTInterpreter::visit_jump(AST_Jump* node) {
             Box* arg2 = arg_array.size() >= 2 ? arg_array[1] : 0;
             Box* arg3 = arg_array.size() >= 3 ? arg_array[2] : 0;
             Box** args = arg_array.size() >= 4 ? &arg_array[3] : 0;
-            return partial_func->call(arg1, arg2, arg3, args);
+            rtn = partial_func->call(arg1, arg2, arg3, args);
+            return true;
         }
     }
 
-    next_block = node->target;
-    return Value();
+    return false;
 }
 
-Value ASTInterpreter::visit_invoke(AST_Invoke* node) {
-    Value v;
+int ASTInterpreter::doInvoke(const BytecodeInstr* instr) {
     try {
-        v = visit_stmt(node->stmt);
-        next_block = node->normal_dest;
+        visit_stmt(static_cast<AST_Invoke*>(instr->stmt)->stmt);
+        return instr->target;
     } catch (ExcInfo e) {
-        next_block = node->exc_dest;
         last_exception = e;
+        return instr->alt_target;
     }
-
-    return v;
 }
 
 Value ASTInterpreter::visit_clsAttribute(AST_ClsAttribute* node) {
-    return getattr(visit_expr(node->value).o, node->attr.c_str());
+    return getattr(visit_expr(node->value).o, node->getInternedAttr());
 }
 
 Value ASTInterpreter::visit_augBinOp(AST_AugBinOp* node) {
@@ -585,15 +963,7 @@ Value ASTInterpreter::visit_langPrimitive(AST_LangPrimitive* node) {
 
     } else if (node->opcode == AST_LangPrimitive::LOCALS) {
         assert(node->args.size() == 0);
-        BoxedDict* dict = new BoxedDict;
-        for (auto& p : sym_table) {
-            llvm::StringRef s = p.first();
-            if (s[0] == '!' || s[0] == '#')
-                continue;
-
-            dict->d[new BoxedString(s.str())] = p.second;
-        }
-        v = dict;
+        v = getLocalsDict(true);
     } else if (node->opcode == AST_LangPrimitive::NONZERO) {
         assert(node->args.size() == 1);
         Value obj = visit_expr(node->args[0]);
@@ -652,13 +1022,7 @@ Value __attribute__((flatten)) ASTInterpreter::visit_stmt(AST_stmt* node) {
         case AST_TYPE::Global:
             return visit_global((AST_Global*)node);
 
-        // pseudo
-        case AST_TYPE::Branch:
-            return visit_branch((AST_Branch*)node);
-        case AST_TYPE::Jump:
-            return visit_jump((AST_Jump*)node);
-        case AST_TYPE::Invoke:
-            return visit_invoke((AST_Invoke*)node);
+        // Branch, Jump and Invoke are their own bytecode instructions, and never get here.
         default:
             RELEASE_ASSERT(0, "not implemented");
     };
@@ -667,7 +1031,6 @@ Value __attribute__((flatten)) ASTInterpreter::visit_stmt(AST_stmt* node) {
 
 Value ASTInterpreter::visit_return(AST_Return* node) {
     Value s(node->value ? visit_expr(node->value) : None);
-    next_block = 0;
     return s;
 }
 
@@ -787,7 +1150,7 @@ Value ASTInterpreter::visit_assert(AST_Assert* node) {
 
 Value ASTInterpreter::visit_global(AST_Global* node) {
     for (std::string& name : node->names)
-        sym_table.erase(name);
+        getLocal(name) = NULL;
     return Value();
 }
 
@@ -808,25 +1171,27 @@ Value ASTInterpreter::visit_delete(AST_Delete* node) {
             }
             case AST_TYPE::Name: {
                 AST_Name* target = (AST_Name*)target_;
-                if (scope_info->refersToGlobal(target->id)) {
+                AST_Name::LookupType lookup_type = getLookupType(target);
+                if (lookup_type == AST_Name::GLOBAL) {
                     // Can't use delattr since the errors are different:
                     delGlobal(source_info->parent_module, &target->id);
                     continue;
                 }
 
-                assert(!scope_info->refersToClosure(target->id));
-                assert(!scope_info->saveInClosure(
-                    target->id)); // SyntaxError: can not delete variable 'x' referenced in nested scope
+                assert(lookup_type != AST_Name::CLOSURE);
+                // SyntaxError: can not delete variable 'x' referenced in nested scope
+                assert(lookup_type != AST_Name::DEREF);
 
                 // A del of a missing name generates different error messages in a function scope vs a classdef scope
-                bool local_error_msg = (source_info->ast->type != AST_TYPE::ClassDef);
+                bool local_error_msg = (lookup_type != AST_Name::NAME);
 
-                if (sym_table.count(target->id) == 0) {
+                Box*& value = getLocal(target->local_slot);
+                if (value == NULL) {
                     assertNameDefined(0, target->id.c_str(), NameError, local_error_msg);
                     return Value();
                 }
 
-                sym_table.erase(target->id);
+                value = NULL;
                 break;
             }
             default:
@@ -1039,23 +1404,23 @@ Value ASTInterpreter::visit_str(AST_Str* node) {
 }
 
 Value ASTInterpreter::visit_name(AST_Name* node) {
-    if (scope_info->refersToGlobal(node->id))
-        return getGlobal(source_info->parent_module, &node->id);
-    else if (scope_info->refersToClosure(node->id)) {
-        return getattr(passed_closure, node->id.c_str());
-    } else {
-        SymMap::iterator it = sym_table.find(node->id);
-        if (it != sym_table.end()) {
-            Box* value = it->second;
-            return value;
+    switch (getLookupType(node)) {
+        case AST_Name::GLOBAL:
+            return getGlobal(source_info->parent_module, node->getInternedId().getPtr());
+        case AST_Name::CLOSURE:
+            return getattr(passed_closure, node->id.c_str());
+        default: {
+            Box* value = getLocal(node->local_slot);
+            if (value)
+                return value;
+
+            // classdefs have different scoping rules than functions:
+            if (node->lookup_type == AST_Name::NAME)
+                return getGlobal(source_info->parent_module, node->getInternedId().getPtr());
+
+            assertNameDefined(0, node->id.c_str(), UnboundLocalError, true);
+            return Value();
         }
-
-        // classdefs have different scoping rules than functions:
-        if (source_info->ast->type == AST_TYPE::ClassDef)
-            return getGlobal(source_info->parent_module, &node->id);
-
-        assertNameDefined(0, node->id.c_str(), UnboundLocalError, true);
-        return Value();
     }
 }
 
@@ -1082,6 +1447,6 @@ Value ASTInterpreter::visit_tuple(AST_Tuple* node) {
 }
 
 Value ASTInterpreter::visit_attribute(AST_Attribute* node) {
-    return getattr(visit_expr(node->value).o, node->attr.c_str());
+    return getattr(visit_expr(node->value).o, node->getInternedAttr());
 }
 }
@@ -25,13 +25,16 @@ class AST_stmt;
 class Box;
 class BoxedDict;
 struct CompiledFunction;
+struct FrameStackState;
 struct LineInfo;
 
 extern const void* interpreter_instr_addr;
 
 Box* astInterpretFunction(CompiledFunction* f, int nargs, Box* closure, Box* generator, Box* arg1, Box* arg2, Box* arg3,
                           Box** args);
-Box* astInterpretFrom(CompiledFunction* cf, AST_stmt* start_at, BoxedDict* locals);
+// Continues running a compiled frame that got deoptimized right after evaluating the expression of its
+// current statement, which came out to deopt_value.
+Box* astInterpretFrom(const FrameStackState& frame_state, Box* deopt_value);
 
 AST_stmt* getCurrentStatementForInterpretedFrame(void* frame_ptr);
 CompiledFunction* getCFForInterpretedFrame(void* frame_ptr);
@@ -0,0 +1,263 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/baseline_jit.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <vector>
+
+#include "asm_writing/assembler.h"
+#include "codegen/bytecode.h"
+#include "codegen/unwinding.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/types.h"
+#include "core/util.h"
+#include "runtime/ics.h"
+
+namespace pyston {
+
+using namespace assembler;
+
+// Upper bounds on how much code we emit, used to size the assembly buffer:
+static const int MAX_BYTES_PER_INSTR = 64;
+static const int MAX_PROLOGUE_EPILOGUE_BYTES = 64;
+
+// Where the generated code keeps the ASTInterpreter* it was called with:
+static const int INTERPRETER_RBP_OFFSET = -8;
+
+// Baseline code lives as long as the bytecode it was generated from, which is forever, so it just gets carved out
+// of large chunks.  Each chunk has an area for code followed by an area for the functions' eh_frames, which refer to
+// the code with 32-bit pc-relative offsets.  Keeping the eh_frames together lets the whole chunk be registered with
+// the unwinders once (see EhFrameChunk), instead of making every exception search through one registration per
+// function.  The code area is never writable and executable at the same time; see compileBaseline().
+#define PAGE_SIZE 4096
+static const size_t CHUNK_CODE_SIZE = 1 << 20;
+static const size_t CHUNK_EH_FRAME_SIZE = 1 << 16;
+
+namespace {
+struct CodeChunk {
+    uint8_t* code_cur, *code_end;
+    uint8_t* eh_frame_cur, *eh_frame_end;
+    EhFrameChunk* eh_frame_chunk;
+};
+}
+static CodeChunk cur_chunk;
+
+// Reserves space for code_size bytes of code, and returns where its eh_frame should go, which is right after the
+// previous function's eh_frame.
+static void allocateCode(size_t code_size, uint8_t** code, uint8_t** eh_frame, EhFrameChunk** eh_frame_chunk) {
+    code_size = (code_size + 15) & ~15;
+    if (cur_chunk.code_cur == NULL || cur_chunk.code_cur + code_size > cur_chunk.code_end
+        || cur_chunk.eh_frame_cur + FRAME_POINTER_EH_FRAME_SIZE > cur_chunk.eh_frame_end) {
+        size_t chunk_code_size = (std::max(code_size, CHUNK_CODE_SIZE) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        void* p = mmap(NULL, chunk_code_size + CHUNK_EH_FRAME_SIZE, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        RELEASE_ASSERT(p != MAP_FAILED, "%d", errno);
+
+        cur_chunk.code_cur = (uint8_t*)p;
+        cur_chunk.code_end = cur_chunk.code_cur + chunk_code_size;
+        cur_chunk.eh_frame_cur = cur_chunk.code_end;
+        cur_chunk.eh_frame_end = cur_chunk.eh_frame_cur + CHUNK_EH_FRAME_SIZE;
+        cur_chunk.eh_frame_chunk = createEhFrameChunk((uint64_t)p, (uint64_t)cur_chunk.eh_frame_cur);
+
+        int r = mprotect(cur_chunk.eh_frame_cur, CHUNK_EH_FRAME_SIZE, PROT_READ | PROT_WRITE);
+        RELEASE_ASSERT(r == 0, "%d", errno);
+    }
+
+    *code = cur_chunk.code_cur;
+    *eh_frame = cur_chunk.eh_frame_cur;
+    *eh_frame_chunk = cur_chunk.eh_frame_chunk;
+    cur_chunk.code_cur += code_size;
+}
+
+namespace {
+class BaselineEmitter {
+private:
+    const Bytecode* bytecode;
+    const BaselineJitHandlers& handlers;
+    Assembler& assem;
+    uint8_t* const buf_start;
+
+    int epilogue_offset;
+    std::vector<int> instr_offsets;
+    // Jumps to instructions that might not have been emitted yet; these all get emitted with a 32-bit displacement,
+    // which gets filled in at the end.  Each entry is the offset of the end of the jump instruction, and the index
+    // of the instruction that it jumps to.
+    std::vector<std::pair<int, int>> instr_jumps;
+
+    int curOffset() { return assem.curInstPointer() - buf_start; }
+
+    void emitCallToHandler(void* func, const BytecodeInstr* instr) {
+        assem.mov(Indirect(RBP, INTERPRETER_RBP_OFFSET), RDI);
+        assem.mov(Immediate((uint64_t)instr), RSI);
+        assem.emitCall(func, R11);
+    }
+
+    void emitJumpToInstr(int target, int pc) {
+        if (target == pc + 1)
+            return;
+        // Any destination that's at least 0x80 bytes away gets the long encoding:
+        assem.jmp(JumpDestination::fromStart(curOffset() + 0x100));
+        instr_jumps.emplace_back(curOffset(), target);
+    }
+
+    void emitCondJumpToInstr(int target, ConditionCode condition) {
+        assem.jmp_cond(JumpDestination::fromStart(curOffset() + 0x100), condition);
+        instr_jumps.emplace_back(curOffset(), target);
+    }
+
+    void emitInstr(int pc) {
+        const BytecodeInstr* instr = &bytecode->instrs[pc];
+        switch (instr->op) {
+            case BytecodeOp::PASS:
+                break;
+            case BytecodeOp::ASSIGN:
+            case BytecodeOp::STORE_NAME:
+            case BytecodeOp::EXPR:
+            case BytecodeOp::STMT:
+            case BytecodeOp::LOAD:
+            case BytecodeOp::BINOP:
+            case BytecodeOp::AUGBINOP:
+            case BytecodeOp::COMPARE:
+            case BytecodeOp::GETATTR:
+            case BytecodeOp::GETITEM:
+            case BytecodeOp::CALL:
+            case BytecodeOp::CALLATTR:
+                assert(handlers.fallthrough[(int)instr->op]);
+                emitCallToHandler((void*)handlers.fallthrough[(int)instr->op], instr);
+                break;
+            case BytecodeOp::BRANCH:
+                emitCallToHandler((void*)handlers.branch, instr);
+                assem.test(RAX, RAX);
+                emitCondJumpToInstr(instr->target, COND_NOT_ZERO);
+                emitJumpToInstr(instr->alt_target, pc);
+                break;
+            case BytecodeOp::INVOKE:
+                emitCallToHandler((void*)handlers.invoke, instr);
+                assem.test(RAX, RAX);
+                emitCondJumpToInstr(instr->target, COND_NOT_ZERO);
+                emitJumpToInstr(instr->alt_target, pc);
+                break;
+            case BytecodeOp::BACKEDGE:
+                emitCallToHandler((void*)handlers.backedge, instr);
+                assem.test(RAX, RAX);
+                assem.jmp_cond(JumpDestination::fromStart(epilogue_offset), COND_NOT_ZERO);
+                emitJumpToInstr(instr->target, pc);
+                break;
+            case BytecodeOp::JUMP:
+                emitJumpToInstr(instr->target, pc);
+                break;
+            case BytecodeOp::RETURN:
+                emitCallToHandler((void*)handlers.ret, instr);
+                assem.jmp(JumpDestination::fromStart(epilogue_offset));
+                break;
+            default:
+                RELEASE_ASSERT(0, "%d", (int)instr->op);
+        }
+    }
+
+public:
+    BaselineEmitter(const Bytecode* bytecode, const BaselineJitHandlers& handlers, Assembler& assem)
+        : bytecode(bytecode), handlers(handlers), assem(assem), buf_start(assem.curInstPointer()),
+          epilogue_offset(-1) {}
+
+    void emit() {
+        // The prologue has to match what writeFramePointerEhFrame() describes:
+        assem.push(RBP);
+        assem.mov(RSP, RBP);
+        assem.sub(Immediate(16), RSP);
+        assem.mov(RDI, Indirect(RBP, INTERPRETER_RBP_OFFSET));
+        // The second argument is the address of the instruction to start at:
+        assem.mov(RSI, R11);
+        assem.jmpq(R11);
+
+        epilogue_offset = curOffset();
+        assem.mov(RBP, RSP);
+        assem.pop(RBP);
+        assem.retq();
+
+        for (int pc = 0; pc < bytecode->instrs.size(); pc++) {
+            instr_offsets.push_back(curOffset());
+            emitInstr(pc);
+        }
+        // Every block ends in a jump, branch or return:
+        assem.trap();
+    }
+
+    void patchJumps(uint8_t* code) {
+        for (const auto& p : instr_jumps) {
+            int jump_end = p.first;
+            int32_t displacement = instr_offsets[p.second] - jump_end;
+            memcpy(code + jump_end - 4, &displacement, 4);
+        }
+    }
+
+    int getInstrOffset(int pc) { return instr_offsets[pc]; }
+};
+}
+
+BaselineCode* compileBaseline(SourceInfo* source, const Bytecode* bytecode, const BaselineJitHandlers& handlers) {
+    Timer _t("for compileBaseline()");
+
+    int num_instrs = bytecode->instrs.size();
+    int buf_size = MAX_PROLOGUE_EPILOGUE_BYTES + num_instrs * MAX_BYTES_PER_INSTR;
+
+    std::vector<uint8_t> buf(buf_size);
+    Assembler assem(&buf[0], buf_size);
+    BaselineEmitter emitter(bytecode, handlers, assem);
+    emitter.emit();
+    RELEASE_ASSERT(!assem.hasFailed(), "ran out of space for the baseline code");
+
+    int code_size = assem.curInstPointer() - &buf[0];
+    uint8_t* code, *eh_frame;
+    EhFrameChunk* eh_frame_chunk;
+    allocateCode(code_size, &code, &eh_frame, &eh_frame_chunk);
+
+    // Only make the pages writable while we copy the code in.  Other functions' code can share the first and last
+    // page, but baseline code only runs with the GIL held, so none of it can run until we're done here.
+    uint8_t* pages_start = (uint8_t*)((uintptr_t)code & ~(uintptr_t)(PAGE_SIZE - 1));
+    size_t pages_size = code + code_size - pages_start;
+    int r = mprotect(pages_start, pages_size, PROT_READ | PROT_WRITE);
+    RELEASE_ASSERT(r == 0, "%d", errno);
+    memcpy(code, &buf[0], code_size);
+    emitter.patchJumps(code);
+    r = mprotect(pages_start, pages_size, PROT_READ | PROT_EXEC);
+    RELEASE_ASSERT(r == 0, "%d", errno);
+
+    int eh_frame_size = writeFramePointerEhFrame(eh_frame, code, code_size);
+    cur_chunk.eh_frame_cur += eh_frame_size;
+    addToEhFrameChunk(eh_frame_chunk, (uint64_t)code, code_size, eh_frame_size);
+
+    BaselineCode* rtn = new BaselineCode((BaselineCode::EntryFunc)code);
+    for (int pc = 0; pc < num_instrs; pc++)
+        rtn->instr_addrs.push_back(code + emitter.getInstrOffset(pc));
+
+    long us = _t.end();
+    static StatCounter us_compiling("us_compiling_baseline");
+    us_compiling.log(us);
+    static StatCounter num_compiles("num_baseline_compiles");
+    num_compiles.log();
+    static StatCounter code_bytes("baseline_code_bytes");
+    code_bytes.log(code_size);
+
+    if (VERBOSITY("irgen") >= 1)
+        printf("Baseline-JIT'd %s: %d bytes of code for %d instructions, in %ldus\n", source->getName().c_str(),
+               code_size, num_instrs, us);
+
+    return rtn;
+}
+}
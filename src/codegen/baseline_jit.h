@@ -0,0 +1,78 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_BASELINEJIT_H
+#define PYSTON_CODEGEN_BASELINEJIT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "codegen/bytecode.h"
+#include "core/common.h"
+
+namespace pyston {
+
+class ASTInterpreter;
+class Box;
+class SourceInfo;
+
+// The baseline JIT sits between the AST interpreter and LLVM: it turns a function's bytecode (see codegen/bytecode.h)
+// straight into x86-64 with the assembler from asm_writing, which takes microseconds instead of the milliseconds
+// that even a MINIMAL LLVM compile takes.  The generated code doesn't have its own frame state; each instruction
+// becomes a call to the interpreter's handler for that kind of instruction, and only the control flow between them
+// is done natively.  That gets rid of the interpreter's dispatch, and means the interpreter can switch to the
+// generated code at any instruction.
+
+// The interpreter's entry points for each kind of instruction.  Each one should set the instruction's statement as
+// the interpreter's current statement before running it.
+struct BaselineJitHandlers {
+    // Indexed by opcode, for the instructions that fall through to the next one (other than PASS, which doesn't need
+    // a handler):
+    void (*fallthrough[(int)BytecodeOp::NUM_OPS])(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+
+    // These return nonzero to go to the instruction's target, and zero to go to its alt_target:
+    uint64_t (*branch)(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+    uint64_t (*invoke)(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+
+    // Returns NULL to take the backedge, or the function's return value if the rest of the function got run some
+    // other way (ie it OSR'd out).
+    Box* (*backedge)(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+    Box* (*ret)(ASTInterpreter* interpreter, const BytecodeInstr* instr);
+};
+
+class BaselineCode {
+private:
+    typedef Box* (*EntryFunc)(ASTInterpreter*, void*);
+
+    EntryFunc entry;
+    // Indexed by instruction:
+    std::vector<void*> instr_addrs;
+
+    BaselineCode(EntryFunc entry) : entry(entry) {}
+
+    friend BaselineCode* compileBaseline(SourceInfo* source, const Bytecode* bytecode,
+                                         const BaselineJitHandlers& handlers);
+
+public:
+    // Runs the rest of the function starting at the given instruction, and returns the function's return value.
+    Box* execute(ASTInterpreter* interpreter, int start_pc) {
+        assert(start_pc >= 0 && start_pc < instr_addrs.size());
+        return entry(interpreter, instr_addrs[start_pc]);
+    }
+};
+
+BaselineCode* compileBaseline(SourceInfo* source, const Bytecode* bytecode, const BaselineJitHandlers& handlers);
+}
+
+#endif
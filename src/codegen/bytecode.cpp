@@ -0,0 +1,265 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/bytecode.h"
+
+#include <unordered_map>
+
+#include "analysis/scoping_analysis.h"
+#include "core/ast.h"
+#include "core/cfg.h"
+#include "core/stats.h"
+#include "core/types.h"
+
+namespace pyston {
+
+int Bytecode::indexOf(AST_stmt* stmt) const {
+    for (int i = 0; i < instrs.size(); i++) {
+        if (instrs[i].stmt == stmt)
+            return i;
+    }
+    return -1;
+}
+
+AST_Name::LookupType resolveName(SourceInfo* source, AST_Name* node) {
+    if (node->lookup_type == AST_Name::UNRESOLVED) {
+        ScopeInfo* scope_info = source->getScopeInfo();
+        if (scope_info->refersToGlobal(node->id))
+            node->lookup_type = AST_Name::GLOBAL;
+        else if (scope_info->refersToClosure(node->id))
+            node->lookup_type = AST_Name::CLOSURE;
+        else if (scope_info->saveInClosure(node->id))
+            node->lookup_type = AST_Name::DEREF;
+        else if (source->ast->type == AST_TYPE::ClassDef)
+            node->lookup_type = AST_Name::NAME;
+        else
+            node->lookup_type = AST_Name::FAST;
+
+        if (node->lookup_type != AST_Name::GLOBAL && node->lookup_type != AST_Name::CLOSURE)
+            node->local_slot = scope_info->getLocalSlot(node->id);
+    }
+    return node->lookup_type;
+}
+
+namespace {
+class BytecodeCompiler {
+private:
+    SourceInfo* source;
+    Bytecode* bytecode;
+
+    void addOperand(BytecodeInstr& instr, AST_expr* expr) {
+        // Classdef locals fall back to globals, so only function locals can be read straight from their slot:
+        int slot = -1;
+        if (expr->type == AST_TYPE::Name && resolveName(source, ast_cast<AST_Name>(expr)) == AST_Name::FAST)
+            slot = ast_cast<AST_Name>(expr)->local_slot;
+
+        if (instr.num_operands == 0)
+            instr.first_operand = bytecode->operands.size();
+        assert(instr.first_operand + instr.num_operands == bytecode->operands.size());
+        bytecode->operands.emplace_back(slot, expr);
+        instr.num_operands++;
+    }
+
+    // Tries to turn the expression into a register instruction; returns false, without touching instr, if it's not
+    // one of the kinds that get lowered.
+    bool lowerExpr(BytecodeInstr& instr, AST_expr* value) {
+        switch (value->type) {
+            case AST_TYPE::Name:
+            case AST_TYPE::Num:
+            case AST_TYPE::Str:
+                instr.op = BytecodeOp::LOAD;
+                addOperand(instr, value);
+                return true;
+            case AST_TYPE::BinOp: {
+                AST_BinOp* binop = ast_cast<AST_BinOp>(value);
+                instr.op = BytecodeOp::BINOP;
+                instr.arg = binop->op_type;
+                addOperand(instr, binop->left);
+                addOperand(instr, binop->right);
+                return true;
+            }
+            case AST_TYPE::AugBinOp: {
+                AST_AugBinOp* binop = ast_cast<AST_AugBinOp>(value);
+                instr.op = BytecodeOp::AUGBINOP;
+                instr.arg = binop->op_type;
+                addOperand(instr, binop->left);
+                addOperand(instr, binop->right);
+                return true;
+            }
+            case AST_TYPE::Compare: {
+                AST_Compare* compare = ast_cast<AST_Compare>(value);
+                if (compare->comparators.size() != 1)
+                    return false;
+                instr.op = BytecodeOp::COMPARE;
+                instr.arg = compare->ops[0];
+                addOperand(instr, compare->left);
+                addOperand(instr, compare->comparators[0]);
+                return true;
+            }
+            case AST_TYPE::Attribute: {
+                AST_Attribute* attr = ast_cast<AST_Attribute>(value);
+                instr.op = BytecodeOp::GETATTR;
+                instr.attr = attr->getInternedAttr();
+                addOperand(instr, attr->value);
+                return true;
+            }
+            case AST_TYPE::ClsAttribute: {
+                AST_ClsAttribute* attr = ast_cast<AST_ClsAttribute>(value);
+                instr.op = BytecodeOp::GETATTR;
+                instr.attr = attr->getInternedAttr();
+                addOperand(instr, attr->value);
+                return true;
+            }
+            case AST_TYPE::Subscript: {
+                AST_Subscript* subscript = ast_cast<AST_Subscript>(value);
+                instr.op = BytecodeOp::GETITEM;
+                addOperand(instr, subscript->value);
+                addOperand(instr, subscript->slice);
+                return true;
+            }
+            case AST_TYPE::Call: {
+                AST_Call* call = ast_cast<AST_Call>(value);
+                if (call->keywords.size() || call->starargs || call->kwargs)
+                    return false;
+
+                if (call->func->type == AST_TYPE::Attribute) {
+                    AST_Attribute* attr = ast_cast<AST_Attribute>(call->func);
+                    instr.op = BytecodeOp::CALLATTR;
+                    instr.attr = attr->getInternedAttr();
+                    addOperand(instr, attr->value);
+                } else if (call->func->type == AST_TYPE::ClsAttribute) {
+                    AST_ClsAttribute* attr = ast_cast<AST_ClsAttribute>(call->func);
+                    instr.op = BytecodeOp::CALLATTR;
+                    instr.attr = attr->getInternedAttr();
+                    instr.arg = 1;
+                    addOperand(instr, attr->value);
+                } else {
+                    instr.op = BytecodeOp::CALL;
+                    addOperand(instr, call->func);
+                }
+                for (AST_expr* e : call->args)
+                    addOperand(instr, e);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    void lowerAssign(BytecodeInstr& instr, AST_Assign* node) {
+        instr.op = BytecodeOp::ASSIGN;
+        if (node->targets.size() != 1 || node->targets[0]->type != AST_TYPE::Name)
+            return;
+
+        instr.op = BytecodeOp::STORE_NAME;
+        AST_Name* target = ast_cast<AST_Name>(node->targets[0]);
+        AST_Name::LookupType lookup_type = resolveName(source, target);
+        // Stores to anything but a plain local have to go through the interpreter's doStore():
+        if (lookup_type != AST_Name::FAST && lookup_type != AST_Name::NAME)
+            return;
+
+        if (lowerExpr(instr, node->value))
+            instr.dst = target->local_slot;
+    }
+
+    BytecodeInstr lowerStmt(AST_stmt* node, CFGBlock* block) {
+        BytecodeInstr instr(BytecodeOp::STMT, node, block);
+        switch (node->type) {
+            case AST_TYPE::Pass:
+                instr.op = BytecodeOp::PASS;
+                break;
+            case AST_TYPE::Assign:
+                lowerAssign(instr, ast_cast<AST_Assign>(node));
+                break;
+            case AST_TYPE::Expr:
+                if (!lowerExpr(instr, ast_cast<AST_Expr>(node)->value))
+                    instr.op = BytecodeOp::EXPR;
+                break;
+            case AST_TYPE::Branch:
+                instr.op = BytecodeOp::BRANCH;
+                addOperand(instr, ast_cast<AST_Branch>(node)->test);
+                break;
+            case AST_TYPE::Jump:
+                if (ast_cast<AST_Jump>(node)->target->idx < block->idx)
+                    instr.op = BytecodeOp::BACKEDGE;
+                else
+                    instr.op = BytecodeOp::JUMP;
+                break;
+            case AST_TYPE::Invoke:
+                instr.op = BytecodeOp::INVOKE;
+                break;
+            case AST_TYPE::Return:
+                instr.op = BytecodeOp::RETURN;
+                break;
+            default:
+                break;
+        }
+        return instr;
+    }
+
+public:
+    BytecodeCompiler(SourceInfo* source, Bytecode* bytecode) : source(source), bytecode(bytecode) {}
+
+    void compile() {
+        CFG* cfg = source->cfg;
+        assert(cfg);
+        assert(cfg->getStartingBlock() == cfg->blocks[0]);
+
+        std::vector<BytecodeInstr>& instrs = bytecode->instrs;
+
+        std::unordered_map<CFGBlock*, int> block_starts;
+        for (CFGBlock* block : cfg->blocks) {
+            ASSERT(block->body.size(), "every block should end in a jump, branch or return");
+            block_starts[block] = instrs.size();
+            for (AST_stmt* stmt : block->body)
+                instrs.push_back(lowerStmt(stmt, block));
+        }
+
+        for (BytecodeInstr& instr : instrs) {
+            switch (instr.op) {
+                case BytecodeOp::BRANCH:
+                    instr.target = block_starts[ast_cast<AST_Branch>(instr.stmt)->iftrue];
+                    instr.alt_target = block_starts[ast_cast<AST_Branch>(instr.stmt)->iffalse];
+                    break;
+                case BytecodeOp::JUMP:
+                case BytecodeOp::BACKEDGE:
+                    instr.target = block_starts[ast_cast<AST_Jump>(instr.stmt)->target];
+                    break;
+                case BytecodeOp::INVOKE:
+                    instr.target = block_starts[ast_cast<AST_Invoke>(instr.stmt)->normal_dest];
+                    instr.alt_target = block_starts[ast_cast<AST_Invoke>(instr.stmt)->exc_dest];
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+};
+}
+
+Bytecode* compileBytecode(SourceInfo* source) {
+    Bytecode* bytecode = new Bytecode();
+    BytecodeCompiler(source, bytecode).compile();
+
+    static StatCounter num_instrs("num_bytecode_instrs");
+    num_instrs.log(bytecode->instrs.size());
+    static StatCounter num_register_instrs("num_bytecode_register_instrs");
+    for (const BytecodeInstr& instr : bytecode->instrs) {
+        if (instr.op >= BytecodeOp::LOAD && instr.op <= BytecodeOp::CALLATTR)
+            num_register_instrs.log();
+    }
+
+    return bytecode;
+}
+}
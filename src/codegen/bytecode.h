@@ -0,0 +1,117 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_BYTECODE_H
+#define PYSTON_CODEGEN_BYTECODE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "core/ast.h"
+#include "core/common.h"
+
+namespace pyston {
+
+class CFGBlock;
+class SourceInfo;
+
+// The interpreter doesn't walk the CFG itself; it runs a flattened version of it, where the blocks are laid out one
+// after another starting with the entry block, and every control-flow target has been resolved to an instruction
+// index.  Each statement becomes one instruction, whose opcode says what kind of statement it is, so that the
+// interpreter can dispatch straight to the code for it.  The baseline JIT generates its code from the same
+// instructions.
+//
+// After CFG lowering, most statements are a single operation on temporaries, like "#t = a + b" or "#t = f(a, b)".
+// Those become register instructions: the operation's operands are read straight out of the frame's local slots,
+// and the result is stored straight into one, so running them doesn't involve the AST at all.  Everything else is
+// still evaluated from the AST.
+enum class BytecodeOp : uint8_t {
+    PASS,
+    ASSIGN,     // any other AST_Assign
+    STORE_NAME, // any other AST_Assign with a single AST_Name target
+    EXPR,       // any other AST_Expr
+    STMT,       // any other statement that falls through to the next one
+
+    // The register instructions.  These store their result in the local slot dst, or drop it if dst is -1:
+    LOAD,     // operand 0
+    BINOP,    // operand 0 <arg> operand 1, where arg is the operator's AST_TYPE
+    AUGBINOP, // the same, but in-place
+    COMPARE,  // the same, but a comparison
+    GETATTR,  // operand 0 . attr
+    GETITEM,  // operand 0 [operand 1]
+    CALL,     // operand 0 (operands 1...), with only positional arguments
+    CALLATTR, // operand 0 . attr (operands 1...), with only positional arguments; arg is nonzero if the attribute
+              // should only be looked up on the class
+
+    BRANCH,   // branches on operand 0; target is iftrue, alt_target is iffalse
+    JUMP,     // a forward jump to target
+    BACKEDGE, // a jump to target, which is in an earlier block
+    INVOKE,   // target is the normal destination, alt_target the exception destination
+    RETURN,
+
+    NUM_OPS,
+};
+
+// Where an operand comes from: a local that lives in the frame gets read from its slot (see
+// ScopeInfo::getLocalSlot), and anything else (globals, closure variables, constants) gets evaluated from the AST.
+struct BytecodeOperand {
+    // -1 if the operand has to be evaluated:
+    int slot;
+    // If slot is set, this is the AST_Name, for the error message if the local isn't defined:
+    AST_expr* expr;
+
+    BytecodeOperand(int slot, AST_expr* expr) : slot(slot), expr(expr) {}
+};
+
+struct BytecodeInstr {
+    BytecodeOp op;
+    AST_stmt* stmt;
+    // The block that the statement came from:
+    CFGBlock* block;
+    int target, alt_target;
+
+    // For the register instructions:
+    int dst, arg;
+    InternedString attr;
+    // Operands are stored in Bytecode::operands:
+    int first_operand, num_operands;
+
+    BytecodeInstr(BytecodeOp op, AST_stmt* stmt, CFGBlock* block)
+        : op(op), stmt(stmt), block(block), target(-1), alt_target(-1), dst(-1), arg(0), first_operand(0),
+          num_operands(0) {}
+};
+
+class Bytecode {
+public:
+    std::vector<BytecodeInstr> instrs;
+    std::vector<BytecodeOperand> operands;
+
+    const BytecodeOperand& getOperand(const BytecodeInstr* instr, int i) const {
+        assert(i < instr->num_operands);
+        return operands[instr->first_operand + i];
+    }
+
+    // Returns the index of the instruction for the given statement, or -1 if there isn't one.  This does a linear
+    // search, since it's only needed for deoptimization.
+    int indexOf(AST_stmt* stmt) const;
+};
+
+// Lowers source->cfg into bytecode.
+Bytecode* compileBytecode(SourceInfo* source);
+
+// Fills in the name's lookup_type and local_slot, if that hasn't been done yet, and returns the lookup_type.
+AST_Name::LookupType resolveName(SourceInfo* source, AST_Name* node);
+}
+
+#endif
@@ -16,6 +16,7 @@
 
 #include <cxxabi.h>
 #include <dlfcn.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -33,8 +34,80 @@ namespace pyston {
 
 DS_DEFINE_RWLOCK(codegen_rwlock);
 
+static pthread_mutex_t llvm_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+LLVMLockRegion::LLVMLockRegion() {
+    if (pthread_mutex_trylock(&llvm_lock) == 0)
+        return;
+
+    // Whoever has the lock might need the GIL before they can give it up:
+    threading::GLAllowThreadsReadRegion _allow;
+    pthread_mutex_lock(&llvm_lock);
+}
+
+LLVMLockRegion::~LLVMLockRegion() {
+    pthread_mutex_unlock(&llvm_lock);
+}
+
+static __thread bool is_background_compiler_thread = false;
+
+void markBackgroundCompilerThread() {
+    is_background_compiler_thread = true;
+}
+
+bool isBackgroundCompilerThread() {
+    return is_background_compiler_thread;
+}
+
+// Whether this thread is in an LLVMOnlyRegion that released the GIL (and not in a RuntimeAccessRegion inside it):
+static __thread bool gil_released_for_llvm = false;
+// How many times this thread took the GIL back in RuntimeAccessRegions:
+static __thread int64_t runtime_access_acquisitions = 0;
+
+LLVMOnlyRegion::LLVMOnlyRegion() : released(is_background_compiler_thread), gil_acquisitions(0) {
+    if (!released)
+        return;
+
+    assert(!gil_released_for_llvm);
+    gil_acquisitions = threading::numGLWriteAcquisitions() - runtime_access_acquisitions;
+    threading::beginAllowThreads();
+    gil_released_for_llvm = true;
+}
+
+LLVMOnlyRegion::~LLVMOnlyRegion() {
+    if (!released)
+        return;
+
+    gil_released_for_llvm = false;
+    threading::endAllowThreads();
+
+    // Not counting the times we took it back ourselves, this is how many times other threads got to run in the
+    // meantime:
+    static StatCounter sc_handoffs("background_compile_gil_handoffs");
+    sc_handoffs.log(threading::numGLWriteAcquisitions() - runtime_access_acquisitions - gil_acquisitions - 1);
+}
+
+RuntimeAccessRegion::RuntimeAccessRegion() : reacquired(gil_released_for_llvm) {
+    if (!reacquired)
+        return;
+
+    // This thread holds the llvm lock, but that's ok: threads that wait for that give up the GIL while they do.
+    gil_released_for_llvm = false;
+    threading::endAllowThreads();
+    runtime_access_acquisitions++;
+}
+
+RuntimeAccessRegion::~RuntimeAccessRegion() {
+    if (!reacquired)
+        return;
+
+    threading::beginAllowThreads();
+    gil_released_for_llvm = true;
+}
+
 SourceInfo::SourceInfo(BoxedModule* m, ScopingAnalysis* scoping, AST* ast, const std::vector<AST_stmt*>& body)
-    : parent_module(m), scoping(scoping), ast(ast), cfg(NULL), liveness(NULL), phis(NULL), arg_names(ast), body(body) {
+    : parent_module(m), scoping(scoping), ast(ast), cfg(NULL), liveness(NULL), phis(NULL), bytecode(NULL),
+      baseline_code(NULL), arg_names(ast), body(body) {
     switch (ast->type) {
         case AST_TYPE::ClassDef:
         case AST_TYPE::Lambda:
@@ -88,6 +88,47 @@ extern GlobalState g;
 void initGlobalFuncs(GlobalState& g);
 
 DS_DECLARE_RWLOCK(codegen_rwlock);
+
+// The LLVM state (g.context, the JIT engine, the module being compiled, and the JIT listeners' registries) is
+// protected by the GIL, except that the background compiler thread (see BackgroundCompiler in irgen/hooks.cpp)
+// releases the GIL for the parts of its compiles that only touch LLVM state.  So every compile to machine code
+// also holds the llvm lock, through an LLVMLockRegion.
+// To avoid deadlocks, the llvm lock always has to be acquired before the GIL: a thread that has the GIL and
+// can't get the lock right away releases the GIL while it waits.  The lock is recursive.
+class LLVMLockRegion {
+public:
+    LLVMLockRegion();
+    ~LLVMLockRegion();
+};
+
+// Wraps the parts of a compile that mostly only touch the LLVM state (ie, the optimization passes and the code
+// generation; the exceptions use a RuntimeAccessRegion).  On the background compiler thread, the GIL gets
+// released for the duration.
+class LLVMOnlyRegion {
+private:
+    bool released;
+    int64_t gil_acquisitions;
+
+public:
+    LLVMOnlyRegion();
+    ~LLVMOnlyRegion();
+};
+
+// For the parts of an LLVMOnlyRegion that do look at runtime state, such as the Pyston-specific passes that read
+// class objects or the function address registry: takes the GIL back for the duration, if the enclosing
+// LLVMOnlyRegion gave it up.
+class RuntimeAccessRegion {
+private:
+    bool reacquired;
+
+public:
+    RuntimeAccessRegion();
+    ~RuntimeAccessRegion();
+};
+
+// Called by the background compiler thread when it starts up.
+void markBackgroundCompilerThread();
+bool isBackgroundCompilerThread();
 }
 
 #endif
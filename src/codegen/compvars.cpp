@@ -167,7 +167,12 @@ public:
 
     Box* deserializeFromFrame(const FrameVals& vals) override {
         assert(vals.size() == numFrameArgs());
-        abort();
+
+        int num_obj_args = obj_type->numFrameArgs();
+        FrameVals obj_vals(vals.begin(), vals.begin() + num_obj_args);
+        FrameVals func_vals(vals.begin() + num_obj_args, vals.end());
+        return boxInstanceMethod(obj_type->deserializeFromFrame(obj_vals),
+                                 function_type->deserializeFromFrame(func_vals));
     }
 
     int numFrameArgs() override { return obj_type->numFrameArgs() + function_type->numFrameArgs(); }
@@ -1606,7 +1611,7 @@ public:
 
     Box* deserializeFromFrame(const FrameVals& vals) override {
         assert(vals.size() == 1);
-        abort();
+        return reinterpret_cast<Box*>(vals[0]);
     }
 } _CLOSURE;
 ConcreteCompilerType* CLOSURE = &_CLOSURE;
@@ -1628,7 +1633,7 @@ public:
 
     Box* deserializeFromFrame(const FrameVals& vals) override {
         assert(vals.size() == numFrameArgs());
-        abort();
+        return reinterpret_cast<Box*>(vals[0]);
     }
 } _GENERATOR;
 ConcreteCompilerType* GENERATOR = &_GENERATOR;
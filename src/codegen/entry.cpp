@@ -23,7 +23,6 @@
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
-#include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/CommandLine.h"
@@ -37,9 +36,12 @@
 
 #include "codegen/codegen.h"
 #include "codegen/memmgr.h"
+#include "codegen/object_cache.h"
 #include "codegen/profiling/profiling.h"
 #include "codegen/stackmaps.h"
+#include "codegen/tiering.h"
 #include "core/options.h"
+#include "core/stats.h"
 #include "core/types.h"
 #include "core/util.h"
 #include "runtime/types.h"
@@ -117,56 +119,6 @@ static llvm::Module* loadStdlib() {
     return m;
 }
 
-class MyObjectCache : public llvm::ObjectCache {
-private:
-    bool loaded;
-
-public:
-    MyObjectCache() : loaded(false) {}
-
-#if LLVMREV < 216002
-    virtual void notifyObjectCompiled(const llvm::Module* M, const llvm::MemoryBuffer* Obj) {}
-#else
-    virtual void notifyObjectCompiled(const llvm::Module* M, llvm::MemoryBufferRef Obj) {}
-#endif
-
-#if LLVMREV < 215566
-    virtual llvm::MemoryBuffer* getObject(const llvm::Module* M){
-#else
-    virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* M) {
-#endif
-        assert(!loaded);
-    loaded = true;
-    g.engine->setObjectCache(NULL);
-    std::unique_ptr<MyObjectCache> del_at_end(this);
-
-#if 0
-            if (!USE_STRIPPED_STDLIB) {
-                stajt = STDLIB_CACHE_START;
-                size = (intptr_t)&STDLIB_CACHE_SIZE;
-            } else {
-                start = STRIPPED_STDLIB_CACHE_START;
-                size = (intptr_t)&STRIPPED_STDLIB_CACHE_SIZE;
-            }
-#else
-        RELEASE_ASSERT(0, "");
-        char* start = NULL;
-        intptr_t size = 0;
-#endif
-
-    // Make sure the stdlib got linked in correctly; check the magic number at the beginning:
-    assert(start[0] == 0x7f);
-    assert(start[1] == 'E');
-    assert(start[2] == 'L');
-    assert(start[3] == 'F');
-
-    assert(size > 0 && size < 1 << 30); // make sure the size is being loaded correctly
-
-    llvm::StringRef data(start, size);
-    return llvm::MemoryBuffer::getMemBufferCopy(data, "");
-}
-};
-
 static void handle_sigfpe(int signum) {
     assert(signum == SIGFPE);
     fprintf(stderr, "SIGFPE!\n");
@@ -181,12 +133,14 @@ static void handle_sigint(int signum) {
     abort();
 }
 
-void initCodegen() {
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
-    llvm::InitializeNativeTargetAsmParser();
+// Creating the MCJIT engine (and the target machine and JIT event listeners that go with it) is a noticeable part
+// of our startup time, and short-running programs often never get out of the interpreter, so this is done on demand
+// the first time that we compile a function.
+void initJITEngine() {
+    if (g.engine)
+        return;
 
-    g.stdlib_module = loadStdlib();
+    Timer _t("to create the JIT engine");
 
 #if LLVMREV < 215967
     llvm::EngineBuilder eb(new llvm::Module("empty_initial_module", g.context));
@@ -222,15 +176,7 @@ void initCodegen() {
     g.engine = eb.create(g.tm);
     assert(g.engine && "engine creation failed?");
 
-    // g.engine->setObjectCache(new MyObjectCache());
-
-    g.i1 = llvm::Type::getInt1Ty(g.context);
-    g.i8 = llvm::Type::getInt8Ty(g.context);
-    g.i8_ptr = g.i8->getPointerTo();
-    g.i32 = llvm::Type::getInt32Ty(g.context);
-    g.i64 = llvm::Type::getInt64Ty(g.context);
-    g.void_ = llvm::Type::getVoidTy(g.context);
-    g.double_ = llvm::Type::getDoubleTy(g.context);
+    initObjectCache();
 
     std::vector<llvm::JITEventListener*> listeners = makeJITEventListeners();
     for (int i = 0; i < listeners.size(); i++) {
@@ -267,10 +213,41 @@ void initCodegen() {
 #endif
     }
 
+    static StatCounter us_engine("us_jit_engine_init");
+    us_engine.log(_t.end());
+}
+
+void initCodegen() {
+    Timer _t;
+
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    g.stdlib_module = loadStdlib();
+
+    g.i1 = llvm::Type::getInt1Ty(g.context);
+    g.i8 = llvm::Type::getInt8Ty(g.context);
+    g.i8_ptr = g.i8->getPointerTo();
+    g.i32 = llvm::Type::getInt32Ty(g.context);
+    g.i64 = llvm::Type::getInt64Ty(g.context);
+    g.void_ = llvm::Type::getVoidTy(g.context);
+    g.double_ = llvm::Type::getDoubleTy(g.context);
+
+    static StatCounter us_load_stdlib("us_startup_load_stdlib");
+    us_load_stdlib.log(_t.split("to set up the runtime functions"));
+
     initGlobalFuncs(g);
 
+    static StatCounter us_global_funcs("us_startup_global_funcs");
+    us_global_funcs.log(_t.split("to set up the runtime"));
+
+    initTieringPolicy();
     setupRuntime();
 
+    static StatCounter us_setup_runtime("us_startup_setup_runtime");
+    us_setup_runtime.log(_t.end());
+
     // signal(SIGFPE, &handle_sigfpe);
     signal(SIGINT, &handle_sigint);
 
@@ -21,6 +21,8 @@ class AST_Module;
 class BoxedModule;
 
 void initCodegen();
+// Called before the first function gets JIT-compiled:
+void initJITEngine();
 void teardownCodegen();
 void printAllIR();
 int joinRuntime();
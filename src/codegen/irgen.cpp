@@ -44,6 +44,7 @@
 #include "codegen/osrentry.h"
 #include "codegen/patchpoints.h"
 #include "codegen/stackmaps.h"
+#include "codegen/tiering.h"
 #include "core/ast.h"
 #include "core/cfg.h"
 #include "core/options.h"
@@ -602,13 +603,6 @@ static void emitBBs(IRGenState* irstate, const char* bb_type, GuardList& out_gua
             // pass
         } else if (block == source->cfg->getStartingBlock()) {
             assert(entry_descriptor == NULL);
-            // number of times a function needs to be called to be reoptimized:
-            static const int REOPT_THRESHOLDS[] = {
-                10,    // INTERPRETED->MINIMAL
-                250,   // MINIMAL->MODERATE
-                10000, // MODERATE->MAXIMAL
-            };
-
             assert(strcmp("opt", bb_type) == 0);
 
             if (ENABLE_REOPT && effort < EffortLevel::MAXIMAL && source->ast != NULL
@@ -624,8 +618,10 @@ static void emitBBs(IRGenState* irstate, const char* bb_type, GuardList& out_gua
                 llvm::Value* new_call_count
                     = emitter->getBuilder()->CreateAdd(cur_call_count, getConstantInt(1, g.i64));
                 emitter->getBuilder()->CreateStore(new_call_count, call_count_ptr);
-                llvm::Value* reopt_test = emitter->getBuilder()->CreateICmpSGT(
-                    new_call_count, getConstantInt(REOPT_THRESHOLDS[effort], g.i64));
+                // Load the threshold rather than embedding it, so that the tiering policy can change it later:
+                llvm::Value* reopt_threshold = emitter->getBuilder()->CreateLoad(
+                    embedConstantPtr(getReoptThresholdPtr(effort), g.i64->getPointerTo()));
+                llvm::Value* reopt_test = emitter->getBuilder()->CreateICmpSGT(new_call_count, reopt_threshold);
 
                 llvm::Metadata* md_vals[] = { llvm::MDString::get(g.context, "branch_weights"),
                                               llvm::ConstantAsMetadata::get(getConstantInt(1)),
@@ -1232,8 +1228,10 @@ CompiledFunction* doCompile(SourceInfo* source, const OSREntryDescriptor* entry_
     static StatCounter us_irgen("us_compiling_irgen");
     us_irgen.log(irgen_us);
 
-    if (ENABLE_LLVMOPTS)
+    if (ENABLE_LLVMOPTS) {
+        LLVMOnlyRegion _llvm_only;
         optimizeIR(f, effort);
+    }
 
     g.cur_module = NULL;
 
@@ -14,6 +14,10 @@
 
 #include "codegen/irgen/hooks.h"
 
+#include <algorithm>
+#include <deque>
+#include <pthread.h>
+
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -23,17 +27,23 @@
 #include "codegen/ast_interpreter.h"
 #include "codegen/codegen.h"
 #include "codegen/compvars.h"
+#include "codegen/entry.h"
 #include "codegen/irgen.h"
 #include "codegen/irgen/future.h"
 #include "codegen/irgen/util.h"
+#include "codegen/object_cache.h"
 #include "codegen/osrentry.h"
 #include "codegen/patchpoints.h"
 #include "codegen/stackmaps.h"
+#include "codegen/tiering.h"
+#include "codegen/type_recording.h"
+#include "codegen/unwinding.h"
 #include "core/ast.h"
 #include "core/cfg.h"
 #include "core/common.h"
 #include "core/options.h"
 #include "core/stats.h"
+#include "core/threading.h"
 #include "core/types.h"
 #include "core/util.h"
 #include "runtime/objmodel.h"
@@ -110,6 +120,14 @@ static void compileIR(CompiledFunction* cf, EffortLevel::EffortLevel effort) {
     cf->code = NULL;
     if (effort > EffortLevel::INTERPRETED) {
         Timer _t("to jit the IR");
+        prepareForObjectCache(cf);
+
+        // The background compiler generates the machine code itself, without the GIL; all that's left for MCJIT
+        // is to load it.
+        if (isBackgroundCompilerThread()) {
+            LLVMOnlyRegion _llvm_only;
+            emitObject(cf);
+        }
 #if LLVMREV < 215967
         g.engine->addModule(cf->func->getParent());
 #else
@@ -119,6 +137,7 @@ static void compileIR(CompiledFunction* cf, EffortLevel::EffortLevel effort) {
         g.cur_cf = cf;
         void* compiled = (void*)g.engine->getFunctionAddress(cf->func->getName());
         g.cur_cf = NULL;
+        finishObjectCache();
         assert(compiled);
         ASSERT(compiled == cf->code, "cf->code should have gotten filled in");
 
@@ -202,6 +221,8 @@ CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, E
     if (effort == EffortLevel::INTERPRETED) {
         cf = new CompiledFunction(0, spec, true, NULL, NULL, effort, 0);
     } else {
+        LLVMLockRegion _llvm_lock;
+        initJITEngine();
         cf = doCompile(source, entry, effort, spec, name);
         compileIR(cf, effort);
     }
@@ -212,6 +233,7 @@ CompiledFunction* compileFunction(CLFunction* f, FunctionSpecialization* spec, E
     long us = _t.end();
     static StatCounter us_compiling("us_compiling");
     us_compiling.log(us);
+    noteCompileTime(us);
     if (VERBOSITY() >= 1 && us > 100000) {
         printf("Took %ldms to compile %s::%s!\n", us / 1000, source->parent_module->fn.c_str(), name.c_str());
     }
@@ -282,7 +304,8 @@ void compileAndRunModule(AST_Module* m, BoxedModule* bm) {
 
 /// Reoptimizes the given function version at the new effort level.
 /// The cf must be an active version in its parents CLFunction; the given
-/// version will be replaced by the new version, which will be returned.
+/// version will be replaced by the new version (in the same place in the
+/// version list), which will be returned.
 static CompiledFunction* _doReopt(CompiledFunction* cf, EffortLevel::EffortLevel new_effort) {
     LOCK_REGION(codegen_rwlock.asWrite());
 
@@ -295,21 +318,22 @@ static CompiledFunction* _doReopt(CompiledFunction* cf, EffortLevel::EffortLevel
     CLFunction* clfunc = cf->clfunc;
     assert(clfunc);
 
-    assert(new_effort > cf->effort);
+    assert(new_effort >= cf->effort);
 
     FunctionList& versions = clfunc->versions;
-    for (int i = 0; i < versions.size(); i++) {
-        if (versions[i] == cf) {
-            versions.erase(versions.begin() + i);
+    if (std::find(versions.begin(), versions.end(), cf) != versions.end()) {
+        CompiledFunction* new_cf
+            = compileFunction(clfunc, cf->spec, new_effort,
+                              NULL); // this pushes the new CompiledVersion to the back of the version list
 
-            CompiledFunction* new_cf
-                = compileFunction(clfunc, cf->spec, new_effort,
-                                  NULL); // this pushes the new CompiledVersion to the back of the version list
+        // Only swap out the old version once the new one is ready, since with background compilation
+        // the old one keeps getting called in the meantime.  The compile can let other threads run, so
+        // the version list might have changed since we looked at it.
+        clfunc->replaceVersion(cf, new_cf);
 
-            cf->dependent_callsites.invalidateAll();
+        cf->dependent_callsites.invalidateAll();
 
-            return new_cf;
-        }
+        return new_cf;
     }
 
     printf("Couldn't find a version; %ld exist:\n", versions.size());
@@ -326,7 +350,7 @@ CompiledFunction* compilePartialFuncInternal(OSRExit* exit) {
 
     assert(exit);
     assert(exit->parent_cf);
-    assert(exit->parent_cf->effort < EffortLevel::MAXIMAL);
+    // parent_cf can be a fully-optimized version if this is a frame that got deoptimized into the interpreter.
     stat_osrexits.log();
 
     // if (VERBOSITY("irgen") >= 1) printf("In compilePartialFunc, handling %p\n", exit);
@@ -353,13 +377,94 @@ void* compilePartialFunc(OSRExit* exit) {
 
 
 static StatCounter stat_reopt("reopts");
+
+// With ENABLE_BACKGROUND_COMPILATION, tier-up compiles get handed off to a separate compiler thread, so that
+// the thread that triggered them doesn't have to wait for them: it keeps running the version it has until
+// the new one gets published into the CLFunction's version list.
+// Irgen looks at runtime objects, so it still happens with the GIL held, as does installing the new version.
+// But the optimization passes and the code generation, which are most of the time of a compile, mostly only
+// touch the LLVM state (which the llvm lock protects), so the compiler thread releases the GIL for them and the
+// other threads keep running in the meantime; see LLVMOnlyRegion.  The passes that do look at runtime state
+// (the inliner and const_classes) take the GIL back while they run; see RuntimeAccessRegion.
+class BackgroundCompiler {
+private:
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+    std::deque<CompiledFunction*> queue;
+    bool started = false;
+
+    CompiledFunction* waitForWork() {
+        // Don't hold the GIL while we have nothing to do:
+        threading::GLAllowThreadsReadRegion _allow;
+
+        pthread_mutex_lock(&lock);
+        while (queue.empty())
+            pthread_cond_wait(&cond, &lock);
+        CompiledFunction* cf = queue.front();
+        queue.pop_front();
+        pthread_mutex_unlock(&lock);
+        return cf;
+    }
+
+    static void* threadMain(Box* arg1, Box* arg2, Box* arg3);
+
+public:
+    // Must be called with the GIL held.
+    void enqueue(CompiledFunction* cf) {
+        assert(!cf->reopt_queued);
+        cf->reopt_queued = true;
+
+        if (!started) {
+            started = true;
+            threading::start_thread(&BackgroundCompiler::threadMain, NULL, NULL, NULL);
+        }
+
+        pthread_mutex_lock(&lock);
+        queue.push_back(cf);
+        pthread_cond_signal(&cond);
+        pthread_mutex_unlock(&lock);
+    }
+};
+static BackgroundCompiler background_compiler;
+
+void* BackgroundCompiler::threadMain(Box* arg1, Box* arg2, Box* arg3) {
+    static StatCounter stat_background_reopt("reopts_background");
+
+    markBackgroundCompilerThread();
+
+    // This runs with the GIL held, except while waiting for work and inside LLVMOnlyRegions.
+    while (true) {
+        CompiledFunction* cf = background_compiler.waitForWork();
+        assert(cf->reopt_queued);
+
+        if (VERBOSITY("irgen") >= 1)
+            printf("Background-compiling %p at effort level %d\n", cf, cf->effort + 1);
+        stat_reopt.log();
+        stat_background_reopt.log();
+
+        CompiledFunction* new_cf = _doReopt(cf, (EffortLevel::EffortLevel(cf->effort + 1)));
+        assert(!new_cf->is_interpreted);
+    }
+    return NULL;
+}
+
 extern "C" CompiledFunction* reoptCompiledFuncInternal(CompiledFunction* cf) {
     if (VERBOSITY("irgen") >= 1)
         printf("In reoptCompiledFunc, %p, %ld\n", cf, cf->times_called);
-    stat_reopt.log();
 
     assert(cf->effort < EffortLevel::MAXIMAL);
     assert(cf->clfunc->versions.size());
+
+    if (ENABLE_BACKGROUND_COMPILATION) {
+        // Keep using this version for now.  Resetting the call count means that the caller can just call
+        // it again without ending up back here.
+        cf->times_called = 0;
+        if (!cf->reopt_queued)
+            background_compiler.enqueue(cf);
+        return cf;
+    }
+
+    stat_reopt.log();
     CompiledFunction* new_cf = _doReopt(cf, (EffortLevel::EffortLevel(cf->effort + 1)));
     assert(!new_cf->is_interpreted);
     return new_cf;
@@ -370,6 +475,39 @@ extern "C" char* reoptCompiledFunc(CompiledFunction* cf) {
     return (char*)reoptCompiledFuncInternal(cf)->code;
 }
 
+static StatCounter stat_deopt("num_deopt");
+static StatCounter stat_deopt_recompiles("num_deopt_recompiles");
+static StatCounter stat_deopt_osr_evictions("num_deopt_osr_evictions");
+extern "C" Box* deopt(AST_expr* expr, Box* value) {
+    stat_deopt.log();
+
+    FrameStackState frame_state = getFrameStackState();
+    CompiledFunction* cf = frame_state.cf;
+
+    // Once the type feedback gives up on this site, replace this version with one that doesn't speculate
+    // on it, instead of deoptimizing it over and over.  If it has already been replaced, it won't be in the
+    // version list anymore:
+    if (getTypeRecorderForNode(expr)->recordSpeculationFailure() && !cf->reopt_queued) {
+        if (cf->entry_descriptor) {
+            // OSR versions don't get reoptimized; just forget about this one, so that the next OSR from
+            // that loop compiles a new version, which won't speculate on this site anymore.
+            auto it = cf->clfunc->osr_versions.find(cf->entry_descriptor);
+            if (it != cf->clfunc->osr_versions.end() && it->second == cf) {
+                stat_deopt_osr_evictions.log();
+                cf->clfunc->osr_versions.erase(it);
+            }
+        } else {
+            FunctionList& versions = cf->clfunc->versions;
+            if (std::find(versions.begin(), versions.end(), cf) != versions.end()) {
+                stat_deopt_recompiles.log();
+                _doReopt(cf, cf->effort);
+            }
+        }
+    }
+
+    return astInterpretFrom(frame_state, value);
+}
+
 CLFunction* createRTFunction(int num_args, int num_defaults, bool takes_varargs, bool takes_kwargs) {
     return new CLFunction(num_args, num_defaults, takes_varargs, takes_kwargs, NULL);
 }
@@ -27,6 +27,10 @@ CompiledFunction* compilePartialFuncInternal(OSRExit* exit);
 void* compilePartialFunc(OSRExit*);
 extern "C" CompiledFunction* reoptCompiledFuncInternal(CompiledFunction*);
 extern "C" char* reoptCompiledFunc(CompiledFunction*);
+class AST_expr;
+class Box;
+// Called by JIT'd code when the value of expr doesn't match what it speculated on; see astInterpretFrom().
+extern "C" Box* deopt(AST_expr* expr, Box* value);
 
 class AST_Module;
 class BoxedModule;
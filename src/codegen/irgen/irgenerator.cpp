@@ -26,6 +26,7 @@
 #include "codegen/irgen/util.h"
 #include "codegen/osrentry.h"
 #include "codegen/patchpoints.h"
+#include "codegen/tiering.h"
 #include "codegen/type_recording.h"
 #include "core/ast.h"
 #include "core/cfg.h"
@@ -158,11 +159,11 @@ private:
             assert(ic_stackmap_args.size() == 0);
 
         PatchpointInfo* info = PatchpointInfo::create(currentFunction(), pp, ic_stackmap_args.size());
-        int64_t pp_id = reinterpret_cast<int64_t>(info);
+        int64_t pp_id = info->getId();
         int pp_size = pp ? pp->totalSize() : CALL_ONLY_SIZE;
 
         std::vector<llvm::Value*> pp_args;
-        pp_args.push_back(getConstantInt(pp_id, g.i64)); // pp_id: will fill this in later
+        pp_args.push_back(getConstantInt(pp_id, g.i64));
         pp_args.push_back(getConstantInt(pp_size, g.i32));
         pp_args.push_back(func);
         pp_args.push_back(getConstantInt(args.size(), g.i32));
@@ -346,13 +347,17 @@ private:
 
     OpInfo getEmptyOpInfo(UnwindInfo unw_info) { return OpInfo(irstate->getEffortLevel(), NULL, unw_info); }
 
-    void createExprTypeGuard(llvm::Value* check_val, AST_expr* node, CompilerVariable* node_value) {
-        assert(check_val->getType() == g.i1);
-
+    static llvm::MDNode* guardBranchWeights() {
         llvm::Metadata* md_vals[]
             = { llvm::MDString::get(g.context, "branch_weights"), llvm::ConstantAsMetadata::get(getConstantInt(1000)),
                 llvm::ConstantAsMetadata::get(getConstantInt(1)) };
-        llvm::MDNode* branch_weights = llvm::MDNode::get(g.context, llvm::ArrayRef<llvm::Metadata*>(md_vals));
+        return llvm::MDNode::get(g.context, llvm::ArrayRef<llvm::Metadata*>(md_vals));
+    }
+
+    void createExprTypeGuard(llvm::Value* check_val, AST_expr* node, CompilerVariable* node_value) {
+        assert(check_val->getType() == g.i1);
+
+        llvm::MDNode* branch_weights = guardBranchWeights();
 
         // For some reason there doesn't seem to be the ability to place the new BB
         // right after the current bb (can only place it *before* something else),
@@ -374,6 +379,62 @@ private:
         out_guards.addExprTypeGuard(myblock, guard, node, node_value, symbol_table);
     }
 
+    // Whether a failed speculation on node can be handled by handing the frame off to the interpreter,
+    // rather than by jumping into a copy of the function that doesn't speculate.
+    // The interpreter can only pick up from right after the statement's expression got evaluated, and
+    // getting the frame's state relies on the frame introspection stackmaps.
+    bool canDeoptToInterpreter(AST_expr* node, AST_stmt* stmt) {
+        if (!ENABLE_DEOPT || !ENABLE_FRAME_INTROSPECTION)
+            return false;
+        if (irstate->getReturnType() != UNKNOWN)
+            return false;
+
+        if (stmt && stmt->type == AST_TYPE::Invoke)
+            stmt = ast_cast<AST_Invoke>(stmt)->stmt;
+        if (!stmt)
+            return false;
+
+        if (stmt->type == AST_TYPE::Assign)
+            return ast_cast<AST_Assign>(stmt)->value == node;
+        if (stmt->type == AST_TYPE::Expr)
+            return ast_cast<AST_Expr>(stmt)->value == node;
+        return false;
+    }
+
+    // Emits code at the current insert point that records that the speculation on node failed; the
+    // type feedback stops predicting node's class if that keeps happening.
+    void emitSpeculationFailure(AST_expr* node) {
+        llvm::Value* failures_ptr = embedConstantPtr(getTypeRecorderForNode(node)->getSpeculationFailuresPtr(),
+                                                     g.i64->getPointerTo());
+        llvm::Value* failures = emitter.getBuilder()->CreateLoad(failures_ptr);
+        emitter.getBuilder()->CreateStore(emitter.getBuilder()->CreateAdd(failures, getConstantInt(1, g.i64)),
+                                          failures_ptr);
+    }
+
+    void createDeoptGuard(llvm::Value* check_val, AST_expr* node, ConcreteCompilerVariable* node_value,
+                          UnwindInfo unw_info) {
+        assert(check_val->getType() == g.i1);
+        assert(node_value->getType() == UNKNOWN);
+
+        llvm::BasicBlock* success_bb
+            = llvm::BasicBlock::Create(g.context, "check_succeeded", irstate->getLLVMFunction());
+        success_bb->moveAfter(curblock);
+        llvm::BasicBlock* deopt_bb = llvm::BasicBlock::Create(g.context, "deopt", irstate->getLLVMFunction());
+
+        emitter.getBuilder()->CreateCondBr(check_val, success_bb, deopt_bb, guardBranchWeights());
+
+        // The frame state gets recorded in the stackmap of this call, which is how deopt() reconstructs it.
+        // Exceptions from the rest of the function get handled by the interpreter, so this shouldn't be an invoke.
+        curblock = deopt_bb;
+        emitter.getBuilder()->SetInsertPoint(curblock);
+        llvm::Value* rtn = emitter.createCall2(UnwindInfo(unw_info.current_stmt, NULL), g.funcs.deopt,
+                                               embedConstantPtr(node, g.i8_ptr), node_value->getValue());
+        emitter.getBuilder()->CreateRet(rtn);
+
+        curblock = success_bb;
+        emitter.getBuilder()->SetInsertPoint(curblock);
+    }
+
     CompilerVariable* evalAttribute(AST_Attribute* node, UnwindInfo unw_info) {
         assert(state != PARTIAL);
 
@@ -869,7 +930,7 @@ private:
 
             std::vector<llvm::Value*> llvm_args;
             llvm_args.push_back(embedConstantPtr(irstate->getSourceInfo()->parent_module, g.llvm_module_type_ptr));
-            llvm_args.push_back(embedConstantPtr(&node->id, g.llvm_str_type_ptr));
+            llvm_args.push_back(embedConstantPtr(node->getInternedId().getPtr(), g.llvm_str_type_ptr));
 
             llvm::Value* uncasted = emitter.createIC(pp, (void*)pyston::getGlobal, llvm_args, unw_info);
             llvm::Value* r = emitter.getBuilder()->CreateIntToPtr(uncasted, g.llvm_value_type_ptr);
@@ -878,7 +939,7 @@ private:
             llvm::Value* r
                 = emitter.createCall2(unw_info, g.funcs.getGlobal,
                                       embedConstantPtr(irstate->getSourceInfo()->parent_module, g.llvm_module_type_ptr),
-                                      embedConstantPtr(&node->id, g.llvm_str_type_ptr));
+                                      embedConstantPtr(node->getInternedId().getPtr(), g.llvm_str_type_ptr));
             return new ConcreteCompilerVariable(UNKNOWN, r, true);
         }
     }
@@ -1244,7 +1305,10 @@ private:
 
                 llvm::Value* guard_check = old_rtn->makeClassCheck(emitter, speculated_class);
                 assert(guard_check->getType() == g.i1);
-                createExprTypeGuard(guard_check, node, old_rtn);
+                if (canDeoptToInterpreter(node, unw_info.current_stmt))
+                    createDeoptGuard(guard_check, node, old_rtn, unw_info);
+                else
+                    createExprTypeGuard(guard_check, node, old_rtn);
 
                 rtn = unboxVar(speculated_type, old_rtn->getValue(), true);
             }
@@ -1262,6 +1326,8 @@ private:
 
             if (state == PARTIAL) {
                 guard->branch->setSuccessor(1, curblock);
+
+                emitSpeculationFailure(node);
                 symbol_table = SymbolTable(guard->st);
                 assert(guard->val);
                 state = RUNNING;
@@ -1276,6 +1342,10 @@ private:
                     = llvm::BasicBlock::Create(g.context, "deopt_ramp", irstate->getLLVMFunction());
                 llvm::BasicBlock* join_block
                     = llvm::BasicBlock::Create(g.context, "deopt_join", irstate->getLLVMFunction());
+
+                emitter.getBuilder()->SetInsertPoint(ramp_block);
+                emitSpeculationFailure(node);
+
                 SymbolTable joined_st;
                 for (const auto& p : guard->st) {
                     // if (VERBOSITY("irgen") >= 1) printf("merging %s\n", p.first.c_str());
@@ -1918,10 +1988,9 @@ private:
         llvm::Value* newcount = emitter.getBuilder()->CreateAdd(curcount, getConstantInt(1, g.i64));
         emitter.getBuilder()->CreateStore(newcount, edgecount_ptr);
 
-        int OSR_THRESHOLD = 10000;
-        if (irstate->getEffortLevel() == EffortLevel::INTERPRETED)
-            OSR_THRESHOLD = 100;
-        llvm::Value* osr_test = emitter.getBuilder()->CreateICmpSGT(newcount, getConstantInt(OSR_THRESHOLD));
+        llvm::Value* osr_threshold = emitter.getBuilder()->CreateLoad(
+            embedConstantPtr(getOSRThresholdPtr(irstate->getEffortLevel()), g.i64->getPointerTo()));
+        llvm::Value* osr_test = emitter.getBuilder()->CreateICmpSGT(newcount, osr_threshold);
 
         llvm::Metadata* md_vals[]
             = { llvm::MDString::get(g.context, "branch_weights"), llvm::ConstantAsMetadata::get(getConstantInt(1)),
@@ -2298,8 +2367,8 @@ public:
 
         stackmap_args.push_back(irstate->getFrameInfoVar());
 
-        assert(INT->llvmType() == g.i64);
-        stackmap_args.push_back(getConstantInt((uint64_t)current_stmt, g.i64));
+        // This gets emitted as a pointer constant (rather than an i64) so that the object cache can relocate it:
+        stackmap_args.push_back(embedConstantPtr(current_stmt, g.i8_ptr));
         pp->addFrameVar("!current_stmt", INT);
 
         if (ENABLE_FRAME_INTROSPECTION) {
@@ -20,6 +20,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Memory.h"
 
+#include "codegen/object_cache.h"
 #include "core/common.h"
 #include "core/stats.h"
 #include "core/util.h"
@@ -206,6 +207,10 @@ void PystonMemoryManager::invalidateInstructionCache() {
 }
 
 uint64_t PystonMemoryManager::getSymbolAddress(const std::string& name) {
+    uint64_t reloc = getObjectCacheRelocation(name);
+    if (reloc)
+        return reloc;
+
     uint64_t base = RTDyldMemoryManager::getSymbolAddress(name);
     if (base)
         return base;
@@ -0,0 +1,403 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/object_cache.h"
+
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+#include "llvm/PassManager.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "codegen/codegen.h"
+#include "codegen/compvars.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/types.h"
+#include "core/util.h"
+
+namespace pyston {
+
+static const char RELOC_PREFIX[] = "__pyston_reloc_";
+
+// The module that's currently being compiled, and the key that its object file should be stored under
+// (empty if it can't be cached):
+static llvm::Module* cur_module = NULL;
+static std::string cur_key;
+// The values of the __pyston_reloc_<n> symbols for cur_module:
+static std::vector<uint64_t> cur_relocations;
+// The object file for cur_module, if emitObject() already generated it:
+static std::unique_ptr<llvm::MemoryBuffer> emitted_object;
+
+class PystonObjectCache : public llvm::ObjectCache {
+private:
+    std::string dir;
+
+    std::string filenameFor(const std::string& key) { return dir + "/" + key + ".o"; }
+
+public:
+    PystonObjectCache(const std::string& dir) : dir(dir) {}
+
+    bool hasObject(const std::string& key) { return access(filenameFor(key).c_str(), R_OK) == 0; }
+
+    void storeObject(const std::string& key, const char* start, size_t size) {
+        // Write to a temporary file and then rename it, so that a concurrently-running process never sees
+        // a partially-written object:
+        std::string fn = filenameFor(key);
+        std::string tmp_fn = fn + ".tmp" + std::to_string(getpid());
+        FILE* f = fopen(tmp_fn.c_str(), "w");
+        if (!f)
+            return;
+        bool ok = fwrite(start, 1, size, f) == size;
+        ok = (fclose(f) == 0) && ok;
+        if (!ok || rename(tmp_fn.c_str(), fn.c_str()) != 0) {
+            unlink(tmp_fn.c_str());
+            return;
+        }
+
+        static StatCounter num_stores("jit_objcache_stores");
+        num_stores.log();
+    }
+
+#if LLVMREV < 216002
+    virtual void notifyObjectCompiled(const llvm::Module* M, const llvm::MemoryBuffer* Obj) {
+        const char* start = Obj->getBufferStart();
+        size_t size = Obj->getBufferSize();
+#else
+    virtual void notifyObjectCompiled(const llvm::Module* M, llvm::MemoryBufferRef Obj) {
+        const char* start = Obj.getBufferStart();
+        size_t size = Obj.getBufferSize();
+#endif
+        if (M != cur_module || cur_key.empty())
+            return;
+
+        storeObject(cur_key, start, size);
+    }
+
+#if LLVMREV < 215566
+    virtual llvm::MemoryBuffer* getObject(const llvm::Module* M) {
+#else
+    virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* M) {
+#endif
+        if (M == cur_module && emitted_object) {
+#if LLVMREV < 215566
+            return emitted_object.release();
+#else
+            return std::move(emitted_object);
+#endif
+        }
+
+        if (M != cur_module || cur_key.empty())
+            return NULL;
+
+        static StatCounter num_hits("jit_objcache_hits");
+        static StatCounter num_misses("jit_objcache_misses");
+
+        auto buffer_or = llvm::MemoryBuffer::getFile(filenameFor(cur_key));
+        if (!buffer_or) {
+            num_misses.log();
+            return NULL;
+        }
+
+        num_hits.log();
+#if LLVMREV < 215566
+        return buffer_or.get().release();
+#else
+        return std::move(buffer_or.get());
+#endif
+    }
+};
+
+static PystonObjectCache* object_cache = NULL;
+
+void initObjectCache() {
+    assert(!object_cache);
+
+    if (JIT_OBJECT_CACHE_DIR) {
+        std::error_code ec = llvm::sys::fs::create_directories(JIT_OBJECT_CACHE_DIR);
+        RELEASE_ASSERT(!ec, "couldn't create the object cache directory '%s': %s", JIT_OBJECT_CACHE_DIR,
+                       ec.message().c_str());
+    }
+
+    // Even without a cache directory, the object cache is how MCJIT picks up the objects from emitObject():
+    object_cache = new PystonObjectCache(JIT_OBJECT_CACHE_DIR ? JIT_OBJECT_CACHE_DIR : "");
+    g.engine->setObjectCache(object_cache);
+}
+
+// The patchpoint's call target stays embedded in the code (it has to be an immediate), and is always the
+// address of a runtime function.  This means it's part of the hashed IR, and since the identity of the
+// binary is part of the key as well, a cached object is only used when those targets are still valid.
+static bool isPatchpointTarget(llvm::Instruction* inst, unsigned operand_idx) {
+    if (operand_idx != 2)
+        return false;
+
+    llvm::CallSite cs(inst);
+    if (!cs)
+        return false;
+    llvm::Function* callee = cs.getCalledFunction();
+    if (!callee)
+        return false;
+
+    llvm::Intrinsic::ID id = (llvm::Intrinsic::ID)callee->getIntrinsicID();
+    return id == llvm::Intrinsic::experimental_patchpoint_i64 || id == llvm::Intrinsic::experimental_patchpoint_void
+           || id == llvm::Intrinsic::experimental_patchpoint_double;
+}
+
+static bool isEmbeddedPtr(llvm::ConstantExpr* ce) {
+    if (ce->getOpcode() != llvm::Instruction::IntToPtr)
+        return false;
+    llvm::ConstantInt* addr = llvm::dyn_cast<llvm::ConstantInt>(ce->getOperand(0));
+    return addr && !addr->isZero();
+}
+
+class ConstantRelocator {
+private:
+    llvm::Module* module;
+    std::unordered_map<uint64_t, llvm::GlobalVariable*> globals;
+
+    llvm::GlobalVariable* getRelocationGlobal(uint64_t addr) {
+        auto it = globals.find(addr);
+        if (it != globals.end())
+            return it->second;
+
+        std::string name = RELOC_PREFIX + std::to_string(cur_relocations.size());
+        llvm::GlobalVariable* gv
+            = new llvm::GlobalVariable(*module, g.i8, true, llvm::GlobalValue::ExternalLinkage, NULL, name);
+        cur_relocations.push_back(addr);
+        globals[addr] = gv;
+        return gv;
+    }
+
+public:
+    ConstantRelocator(llvm::Module* module) : module(module) {}
+
+    llvm::Constant* relocate(llvm::Constant* c) {
+        llvm::ConstantExpr* ce = llvm::dyn_cast<llvm::ConstantExpr>(c);
+        if (!ce)
+            return c;
+
+        if (isEmbeddedPtr(ce)) {
+            uint64_t addr = llvm::cast<llvm::ConstantInt>(ce->getOperand(0))->getZExtValue();
+            return llvm::ConstantExpr::getBitCast(getRelocationGlobal(addr), ce->getType());
+        }
+
+        bool changed = false;
+        std::vector<llvm::Constant*> new_operands;
+        for (unsigned i = 0; i < ce->getNumOperands(); i++) {
+            llvm::Constant* op = llvm::cast<llvm::Constant>(ce->getOperand(i));
+            llvm::Constant* new_op = relocate(op);
+            changed |= (new_op != op);
+            new_operands.push_back(new_op);
+        }
+        if (!changed)
+            return c;
+        return ce->getWithOperands(new_operands);
+    }
+};
+
+// Returns whether there are any embedded pointers left in the constant, ie ones that the relocator didn't handle.
+static bool containsEmbeddedPtr(llvm::Constant* c) {
+    if (llvm::isa<llvm::GlobalValue>(c))
+        return false;
+    if (llvm::ConstantExpr* ce = llvm::dyn_cast<llvm::ConstantExpr>(c)) {
+        if (isEmbeddedPtr(ce))
+            return true;
+    }
+    for (unsigned i = 0; i < c->getNumOperands(); i++) {
+        if (containsEmbeddedPtr(llvm::cast<llvm::Constant>(c->getOperand(i))))
+            return true;
+    }
+    return false;
+}
+
+// Replaces the embedded pointers in the function with relocations; returns whether the result is cacheable.
+static bool relocateConstants(llvm::Function* f) {
+    llvm::Module* m = f->getParent();
+    ConstantRelocator relocator(m);
+    bool cacheable = true;
+
+    for (llvm::BasicBlock& bb : *f) {
+        for (llvm::Instruction& inst : bb) {
+            for (unsigned i = 0; i < inst.getNumOperands(); i++) {
+                llvm::Constant* op = llvm::dyn_cast<llvm::Constant>(inst.getOperand(i));
+                if (!op || llvm::isa<llvm::GlobalValue>(op) || isPatchpointTarget(&inst, i))
+                    continue;
+
+                llvm::Constant* new_op = relocator.relocate(op);
+                if (new_op != op)
+                    inst.setOperand(i, new_op);
+                if (containsEmbeddedPtr(new_op))
+                    cacheable = false;
+            }
+        }
+    }
+
+    for (auto it = m->global_begin(), end = m->global_end(); it != end; ++it) {
+        if (it->hasInitializer() && containsEmbeddedPtr(it->getInitializer()))
+            cacheable = false;
+    }
+
+    return cacheable;
+}
+
+// Something that changes whenever the pyston binary does, since cached objects hardcode the addresses
+// of runtime functions:
+static const std::string& binaryIdentity() {
+    static std::string rtn;
+    if (rtn.empty()) {
+        struct stat st;
+        int r = stat("/proc/self/exe", &st);
+        RELEASE_ASSERT(r == 0, "");
+        // The address of one of our functions, in case the binary got loaded at a different address:
+        rtn = std::to_string(st.st_ino) + ":" + std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime) + ":"
+              + std::to_string((uint64_t)&initObjectCache);
+    }
+    return rtn;
+}
+
+static std::string computeHash(CompiledFunction* cf, const std::string& old_name) {
+    // The function (and module) names include a per-process counter, which also gets baked into the debug info,
+    // so hash the IR with those names blanked out:
+    std::string ir;
+    llvm::raw_string_ostream os(ir);
+    cf->func->getParent()->print(os, NULL);
+    os.flush();
+    for (size_t pos = ir.find(old_name); pos != std::string::npos; pos = ir.find(old_name, pos))
+        ir.replace(pos, old_name.size(), "<name>");
+
+    llvm::MD5 hash;
+    hash.update(binaryIdentity());
+    hash.update(";effort=" + std::to_string(cf->effort));
+    hash.update(cf->entry_descriptor ? ";osr" : ";noosr");
+    hash.update(";rtn=" + cf->spec->rtn_type->debugName());
+    for (ConcreteCompilerType* t : cf->spec->arg_types)
+        hash.update(";arg=" + t->debugName());
+    hash.update(";");
+    hash.update(ir);
+
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    llvm::SmallString<32> str;
+    llvm::MD5::stringifyResult(result, str);
+    return std::string(str.begin(), str.end());
+}
+
+void prepareForObjectCache(CompiledFunction* cf) {
+    assert(!cur_module);
+    cur_module = cf->func->getParent();
+    cur_key.clear();
+    cur_relocations.clear();
+
+    if (!JIT_OBJECT_CACHE_DIR)
+        return;
+
+    Timer _t("preparing for the object cache");
+
+    if (!relocateConstants(cf->func)) {
+        static StatCounter num_uncacheable("jit_objcache_uncacheable");
+        num_uncacheable.log();
+        return;
+    }
+
+    std::string old_name = cf->func->getName().str();
+    std::string hash = computeHash(cf, old_name);
+
+    // The symbol that we look the function up by has to be the same in every process that uses the object,
+    // so derive it from the contents rather than from the counter.  A process could compile the same IR twice,
+    // so disambiguate those deterministically:
+    static std::unordered_set<std::string> used_names;
+    std::string stem = old_name.substr(0, old_name.rfind('_'));
+    std::string suffix;
+    for (int i = 1; used_names.count(stem + "_" + hash.substr(0, 16) + suffix); i++)
+        suffix = "_" + std::to_string(i);
+    std::string name = stem + "_" + hash.substr(0, 16) + suffix;
+    used_names.insert(name);
+
+    cf->func->setName(name);
+    cur_module->setModuleIdentifier(name);
+    cur_key = hash + suffix;
+
+    static StatCounter us_preparing("us_compiling_objcache_prepare");
+    us_preparing.log(_t.end());
+}
+
+void emitObject(CompiledFunction* cf) {
+    llvm::Module* m = cf->func->getParent();
+    assert(m == cur_module);
+    assert(!emitted_object);
+
+    // Loading it from the disk cache is cheaper:
+    if (!cur_key.empty() && object_cache->hasObject(cur_key))
+        return;
+
+    Timer _t("emitting the object file");
+
+    // This is what MCJIT does when it compiles a module itself:
+    llvm::PassManager pm;
+#if LLVMREV < 217548
+    pm.add(new llvm::DataLayoutPass(*g.tm->getDataLayout()));
+#else
+    pm.add(new llvm::DataLayoutPass());
+#endif
+
+    llvm::SmallVector<char, 4096> buf;
+    llvm::raw_svector_ostream os(buf);
+    llvm::MCContext* ctx;
+    bool failed = g.tm->addPassesToEmitMC(pm, ctx, os, /* DisableVerify */ true);
+    RELEASE_ASSERT(!failed, "target doesn't support MC emission");
+    pm.run(*m);
+    os.flush();
+
+    llvm::StringRef obj(buf.data(), buf.size());
+    if (!cur_key.empty())
+        object_cache->storeObject(cur_key, obj.data(), obj.size());
+    emitted_object
+        = std::unique_ptr<llvm::MemoryBuffer>(llvm::MemoryBuffer::getMemBufferCopy(obj, m->getModuleIdentifier()));
+
+    static StatCounter us_emitting("us_compiling_emit_object");
+    us_emitting.log(_t.end());
+}
+
+void finishObjectCache() {
+    cur_module = NULL;
+    cur_key.clear();
+    cur_relocations.clear();
+    emitted_object.reset();
+}
+
+uint64_t getObjectCacheRelocation(const std::string& name) {
+    if (!startswith(name, RELOC_PREFIX))
+        return 0;
+
+    int idx = std::stoi(name.substr(sizeof(RELOC_PREFIX) - 1));
+    RELEASE_ASSERT(idx >= 0 && idx < cur_relocations.size(), "%s", name.c_str());
+    return cur_relocations[idx];
+}
+}
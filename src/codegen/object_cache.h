@@ -0,0 +1,56 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_OBJECTCACHE_H
+#define PYSTON_CODEGEN_OBJECTCACHE_H
+
+#include <cstdint>
+#include <string>
+
+namespace pyston {
+
+struct CompiledFunction;
+
+// An on-disk cache of the object files that MCJIT produces, so that a new process doesn't have to
+// recompile the functions that a previous one already did.  Enabled by setting JIT_OBJECT_CACHE_DIR (-C).
+// The same ObjectCache hook also lets the background compiler generate the object file itself (see
+// emitObject()), so it's always installed.
+//
+// The generated code is full of pointers to runtime objects (classes, strings, the CompiledFunction
+// itself, ...) that will be at different addresses in a new process.  So before a function gets
+// compiled, every embedded pointer constant gets replaced by a reference to an external symbol
+// "__pyston_reloc_<n>", where n is the order in which it first appears in the function; MCJIT resolves
+// those symbols through the memory manager, and so the same object file can be reused for any
+// function whose IR is the same modulo those constants.  The cache key is a hash of that rewritten IR,
+// the effort level, the FunctionSpecialization and the identity of the pyston binary.
+
+void initObjectCache();
+
+// Called right before the function's module gets handed off to MCJIT.  If the function can be cached,
+// this rewrites its constants into relocations, gives it a name that's derived from its contents, and
+// tells the object cache what key to use for it.
+void prepareForObjectCache(CompiledFunction* cf);
+// Generates the object file for the function's module now, for MCJIT to load instead of compiling the module
+// itself.  This only touches the module and the target machine, so the background compiler can do it without
+// the GIL.  Has to be called in between prepareForObjectCache() and handing the module to MCJIT.
+void emitObject(CompiledFunction* cf);
+// Called once MCJIT is done with the module.
+void finishObjectCache();
+
+// For the memory manager: returns the value of a "__pyston_reloc_<n>" symbol for the module that's
+// currently being compiled, or 0 if the name isn't one of those.
+uint64_t getObjectCacheRelocation(const std::string& name);
+}
+
+#endif
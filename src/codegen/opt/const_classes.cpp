@@ -158,6 +158,9 @@ public:
     virtual void getAnalysisUsage(AnalysisUsage& info) const { info.setPreservesCFG(); }
 
     virtual bool runOnFunction(Function& F) {
+        // This reads the classes themselves, so it can't run without the GIL:
+        RuntimeAccessRegion _runtime_access;
+
         // F.dump();
         bool changed = false;
         for (inst_iterator inst_it = inst_begin(F), _inst_end = inst_end(F); inst_it != _inst_end; ++inst_it) {
@@ -315,6 +315,9 @@ public:
     }
 
     virtual bool runOnFunction(llvm::Function& f) {
+        // The function address registry is runtime state, so this can't run without the GIL:
+        RuntimeAccessRegion _runtime_access;
+
         Timer _t("inlining");
 
         bool rtn = _runOnFunction(f);
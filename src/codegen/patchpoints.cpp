@@ -165,8 +165,9 @@ void processStackmap(CompiledFunction* cf, StackMap* stackmap) {
         const StackMap::StackSizeRecord& stack_size_record = stackmap->stack_size_records[0];
         int stack_size = stack_size_record.stack_size;
 
-        PatchpointInfo* pp = reinterpret_cast<PatchpointInfo*>(r->id);
-        assert(pp);
+        RELEASE_ASSERT(r->id < new_patchpoints.size(), "%ld", (int64_t)r->id);
+        PatchpointInfo* pp = new_patchpoints[r->id];
+        assert(pp->getId() == r->id);
 
         if (VERBOSITY()) {
             printf("Processing pp %ld; [%d, %d)\n", reinterpret_cast<int64_t>(pp), r->offset,
@@ -271,7 +272,7 @@ PatchpointInfo* PatchpointInfo::create(CompiledFunction* parent_cf, const ICSetu
     if (icinfo == NULL)
         assert(num_ic_stackmap_args == 0);
 
-    auto* r = new PatchpointInfo(parent_cf, icinfo, num_ic_stackmap_args);
+    auto* r = new PatchpointInfo(parent_cf, new_patchpoints.size(), icinfo, num_ic_stackmap_args);
     new_patchpoints.push_back(r);
     return r;
 }
@@ -48,17 +48,21 @@ public:
 
 private:
     CompiledFunction* const parent_cf;
+    // The stackmap id of the patchpoint.  This is its index among the patchpoints created for the function
+    // being compiled, rather than anything process-specific, so that the object cache can reuse the code.
+    const int64_t id;
     const ICSetupInfo* icinfo;
     int num_ic_stackmap_args;
     int num_frame_stackmap_args;
 
     std::vector<FrameVarInfo> frame_vars;
 
-    PatchpointInfo(CompiledFunction* parent_cf, const ICSetupInfo* icinfo, int num_ic_stackmap_args)
-        : parent_cf(parent_cf), icinfo(icinfo), num_ic_stackmap_args(num_ic_stackmap_args),
+    PatchpointInfo(CompiledFunction* parent_cf, int64_t id, const ICSetupInfo* icinfo, int num_ic_stackmap_args)
+        : parent_cf(parent_cf), id(id), icinfo(icinfo), num_ic_stackmap_args(num_ic_stackmap_args),
           num_frame_stackmap_args(-1) {}
 
 public:
+    int64_t getId() { return id; }
     const ICSetupInfo* getICInfo() { return icinfo; }
 
     int patchpointSize();
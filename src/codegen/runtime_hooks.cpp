@@ -243,6 +243,7 @@ void initGlobalFuncs(GlobalState& g) {
 
     g.funcs.reoptCompiledFunc = addFunc((void*)reoptCompiledFunc, g.i8_ptr, g.i8_ptr);
     g.funcs.compilePartialFunc = addFunc((void*)compilePartialFunc, g.i8_ptr, g.i8_ptr);
+    g.funcs.deopt = addFunc((void*)deopt, g.llvm_value_type_ptr, g.i8_ptr, g.llvm_value_type_ptr);
 
     GET(__cxa_begin_catch);
     g.funcs.__cxa_end_catch = addFunc((void*)__cxa_end_catch, g.void_);
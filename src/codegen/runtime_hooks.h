@@ -44,7 +44,7 @@ struct GlobalFuncs {
     llvm::Value* printFloat, *listAppendInternal, *getSysStdout;
     llvm::Value* runtimeCall0, *runtimeCall1, *runtimeCall2, *runtimeCall3, *runtimeCall, *runtimeCallN;
     llvm::Value* callattr0, *callattr1, *callattr2, *callattr3, *callattr, *callattrN;
-    llvm::Value* reoptCompiledFunc, *compilePartialFunc;
+    llvm::Value* reoptCompiledFunc, *compilePartialFunc, *deopt;
 
     llvm::Value* __cxa_begin_catch, *__cxa_end_catch;
     llvm::Value* raise0, *raise3;
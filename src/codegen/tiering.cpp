@@ -0,0 +1,163 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codegen/tiering.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/time.h>
+
+#include "codegen/codegen.h"
+#include "core/common.h"
+#include "core/options.h"
+#include "core/stats.h"
+
+namespace pyston {
+
+// Compiling doesn't get held to its budget until it has taken this long in total; otherwise short
+// programs, which spend most of their time compiling, would never make it out of the interpreter.
+static const long MIN_COMPILE_US_FOR_BUDGET = 500000;
+static const int64_t MAX_BACKOFF = 64;
+
+static int64_t reopt_thresholds[EffortLevel::MAXIMAL];
+static int64_t osr_thresholds[EffortLevel::MAXIMAL];
+static int64_t backoff = 1;
+
+static timeval start_time;
+static long total_compile_us = 0;
+
+static void updateThresholds() {
+    reopt_thresholds[EffortLevel::INTERPRETED] = REOPT_THRESHOLD_INTERPRETED * backoff;
+    reopt_thresholds[EffortLevel::MINIMAL] = REOPT_THRESHOLD_MINIMAL * backoff;
+    reopt_thresholds[EffortLevel::MODERATE] = REOPT_THRESHOLD_MODERATE * backoff;
+
+    osr_thresholds[EffortLevel::INTERPRETED] = OSR_THRESHOLD_INTERPRETED * backoff;
+    osr_thresholds[EffortLevel::MINIMAL] = OSR_THRESHOLD_COMPILED * backoff;
+    osr_thresholds[EffortLevel::MODERATE] = OSR_THRESHOLD_COMPILED * backoff;
+}
+
+void initTieringPolicy() {
+    gettimeofday(&start_time, NULL);
+    updateThresholds();
+}
+
+int64_t* getReoptThresholdPtr(EffortLevel::EffortLevel effort) {
+    assert(effort < EffortLevel::MAXIMAL);
+    return &reopt_thresholds[effort];
+}
+
+int64_t* getOSRThresholdPtr(EffortLevel::EffortLevel effort) {
+    assert(effort < EffortLevel::MAXIMAL);
+    return &osr_thresholds[effort];
+}
+
+void noteCompileTime(long us) {
+    // Compiles on the background thread (-a) don't hold up the program, and their time overlaps with the
+    // run time we measure below, so only the ones the program had to wait for count against the budget:
+    if (isBackgroundCompilerThread())
+        return;
+
+    total_compile_us += us;
+    if (COMPILE_BUDGET_PERCENT == 0 || total_compile_us < MIN_COMPILE_US_FOR_BUDGET)
+        return;
+
+    timeval now;
+    gettimeofday(&now, NULL);
+    long elapsed_us = (now.tv_sec - start_time.tv_sec) * 1000000L + (now.tv_usec - start_time.tv_usec);
+    long run_us = std::max(1L, elapsed_us - total_compile_us);
+
+    // Back off while we're over budget, and come back down once we're comfortably under it again:
+    int64_t new_backoff = backoff;
+    if (total_compile_us * 100 > run_us * COMPILE_BUDGET_PERCENT)
+        new_backoff = std::min(backoff * 2, MAX_BACKOFF);
+    else if (total_compile_us * 200 < run_us * COMPILE_BUDGET_PERCENT)
+        new_backoff = std::max(backoff / 2, (int64_t)1);
+
+    if (new_backoff == backoff)
+        return;
+
+    static StatCounter sc_backoff_changes("tiering_backoff_changes");
+    sc_backoff_changes.log();
+    if (VERBOSITY("irgen") >= 1)
+        printf("Spent %ldus compiling and %ldus running; scaling the tiering thresholds by %ld\n", total_compile_us,
+               run_us, new_backoff);
+
+    backoff = new_backoff;
+    updateThresholds();
+}
+
+bool parseTieringOptions(const char* spec) {
+    struct Setting {
+        const char* name;
+        int64_t* value;
+        int64_t min;
+    };
+    static const Setting settings[] = {
+        { "reopt_interpreted", &REOPT_THRESHOLD_INTERPRETED, 1 },
+        { "reopt_minimal", &REOPT_THRESHOLD_MINIMAL, 1 },
+        { "reopt_moderate", &REOPT_THRESHOLD_MODERATE, 1 },
+        { "osr_interpreted", &OSR_THRESHOLD_INTERPRETED, 1 },
+        { "osr_compiled", &OSR_THRESHOLD_COMPILED, 1 },
+        { "compile_budget", &COMPILE_BUDGET_PERCENT, 0 },
+        { "baseline", &BASELINE_JIT_THRESHOLD, 0 },
+    };
+
+    std::string s(spec);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos)
+            end = s.size();
+        std::string item = s.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (item.empty())
+            continue;
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            fprintf(stderr, "tiering option '%s' should look like name=value\n", item.c_str());
+            return false;
+        }
+
+        std::string name = item.substr(0, eq);
+        const Setting* setting = NULL;
+        for (const Setting& candidate : settings) {
+            if (name == candidate.name)
+                setting = &candidate;
+        }
+        if (!setting) {
+            fprintf(stderr, "unknown tiering option '%s'; valid options are:", name.c_str());
+            for (const Setting& candidate : settings)
+                fprintf(stderr, " %s", candidate.name);
+            fprintf(stderr, "\n");
+            return false;
+        }
+
+        const char* value_str = item.c_str() + eq + 1;
+        char* value_end;
+        long long value = strtoll(value_str, &value_end, 10);
+        if (*value_str == '\0' || *value_end != '\0' || value < setting->min) {
+            fprintf(stderr, "tiering option '%s' needs to be an integer that's at least %ld\n", setting->name,
+                    setting->min);
+            return false;
+        }
+
+        *setting->value = value;
+    }
+    return true;
+}
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CODEGEN_TIERING_H
+#define PYSTON_CODEGEN_TIERING_H
+
+#include <cstdint>
+
+#include "core/types.h"
+
+namespace pyston {
+
+// The tiering policy decides when a function moves up to the next effort level: either after it has
+// been called enough times (reopt), or after one of its loops has gone around enough times (OSR).
+//
+// The thresholds start out at the values in core/options.h, which can be set with -J or the
+// PYSTON_TIERING environment variable.  The policy also keeps track of how much time goes to compiling
+// versus running; if compiling takes more than COMPILE_BUDGET_PERCENT of the run time, it backs off by
+// scaling all of the thresholds up, and scales them back down once compiling is back under budget.
+//
+// The current thresholds live at fixed addresses, so that JIT'd code can load them directly and pick up
+// any changes without being recompiled.
+
+void initTieringPolicy();
+
+// Number of calls after which a version at the given effort level gets reoptimized.
+int64_t* getReoptThresholdPtr(EffortLevel::EffortLevel effort);
+inline int64_t getReoptThreshold(EffortLevel::EffortLevel effort) {
+    return *getReoptThresholdPtr(effort);
+}
+
+// Number of loop iterations after which a version at the given effort level OSRs into a more optimized one.
+int64_t* getOSRThresholdPtr(EffortLevel::EffortLevel effort);
+inline int64_t getOSRThreshold(EffortLevel::EffortLevel effort) {
+    return *getOSRThresholdPtr(effort);
+}
+
+// Called after every compile, with how long it took.  Only compiles that the program had to wait for (ie
+// not the ones done by the background compiler thread) count toward the compile budget.
+void noteCompileTime(long us);
+
+// Parses a comma-separated list of settings such as "reopt_minimal=500,compile_budget=25" into the
+// options that the policy starts from.  Returns false, after printing an error, if it's malformed.
+bool parseTieringOptions(const char* spec);
+}
+
+#endif
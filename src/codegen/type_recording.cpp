@@ -14,9 +14,11 @@
 
 #include "codegen/type_recording.h"
 
+#include <algorithm>
 #include <unordered_map>
 
 #include "core/options.h"
+#include "core/stats.h"
 #include "core/types.h"
 
 namespace pyston {
@@ -29,20 +31,57 @@ TypeRecorder* getTypeRecorderForNode(AST* node) {
     return r;
 }
 
+// Halve the counts once there have been this many samples:
+static const int64_t DECAY_INTERVAL = 1024;
+// The fraction of samples the most common class needs for us to speculate on it:
+static const int SPECULATION_THRESHOLD_PERCENT = 95;
+// Don't speculate until there have been this many samples:
+static const int64_t MIN_SAMPLES = 100;
+// Stop speculating at a site once its speculations have failed this many times:
+static const int64_t MAX_SPECULATION_FAILURES = 3;
+
 Box* recordType(TypeRecorder* self, Box* obj) {
     BoxedClass* cls = obj->cls;
-    if (cls != self->last_seen) {
-        self->last_seen = cls;
-        self->last_count = 1;
+
+    // Fast path for monomorphic sites:
+    if (likely(cls == self->classes[0])) {
+        self->counts[0]++;
     } else {
-        self->last_count++;
+        int i = 1;
+        while (i < TypeRecorder::NUM_CLASSES && self->classes[i] != cls && self->classes[i] != NULL)
+            i++;
+
+        // If the table is full, replace the least common class.  Letting the new class inherit that class's
+        // count is the "space-saving" trick: it overestimates the new class, but means that a class that's
+        // actually common can't get stuck out of the table.
+        if (i == TypeRecorder::NUM_CLASSES)
+            i = TypeRecorder::NUM_CLASSES - 1;
+        self->classes[i] = cls;
+        self->counts[i]++;
+
+        // Keep the table ordered by count, so that the common case stays at the front:
+        while (i > 0 && self->counts[i] > self->counts[i - 1]) {
+            std::swap(self->classes[i], self->classes[i - 1]);
+            std::swap(self->counts[i], self->counts[i - 1]);
+            i--;
+        }
     }
 
-    // printf("Seen %s %ld times\n", getNameOfClass(cls)->c_str(), self->last_count);
+    self->total++;
+    if (unlikely(self->total >= DECAY_INTERVAL))
+        self->decay();
 
     return obj;
 }
 
+void TypeRecorder::decay() {
+    total = 0;
+    for (int i = 0; i < NUM_CLASSES; i++) {
+        counts[i] /= 2;
+        total += counts[i];
+    }
+}
+
 BoxedClass* predictClassFor(AST* node) {
     auto it = type_recorders.find(node);
     if (it == type_recorders.end())
@@ -56,9 +95,25 @@ BoxedClass* TypeRecorder::predict() {
     if (!ENABLE_TYPE_FEEDBACK)
         return NULL;
 
-    if (last_count > 100)
-        return last_seen;
+    if (speculation_failures >= MAX_SPECULATION_FAILURES) {
+        static StatCounter sc_failed("typefeedback_not_speculated_failures");
+        sc_failed.log();
+        return NULL;
+    }
+
+    if (total < MIN_SAMPLES)
+        return NULL;
+
+    if (counts[0] * 100 < total * SPECULATION_THRESHOLD_PERCENT) {
+        static StatCounter sc_polymorphic("typefeedback_not_speculated_polymorphic");
+        sc_polymorphic.log();
+        return NULL;
+    }
+
+    return classes[0];
+}
 
-    return NULL;
+bool TypeRecorder::recordSpeculationFailure() {
+    return ++speculation_failures >= MAX_SPECULATION_FAILURES;
 }
 }
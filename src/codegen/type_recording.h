@@ -32,15 +32,35 @@ class TypeRecorder;
 // specified.)
 extern "C" Box* recordType(TypeRecorder* recorder, Box* obj);
 class TypeRecorder {
+public:
+    static const int NUM_CLASSES = 4;
+
 private:
-    BoxedClass* last_seen;
-    int64_t last_count;
+    // A small histogram of the classes seen at this site, ordered (roughly) from most to least common.
+    // Once it's full, a new class replaces the least common one.  The counts get halved every so often,
+    // so that they reflect what the site has been doing recently.
+    BoxedClass* classes[NUM_CLASSES];
+    int64_t counts[NUM_CLASSES];
+    int64_t total;
+
+    // How many times speculating on the predicted class has failed; updated directly by the JIT'd code.
+    int64_t speculation_failures;
+
+    void decay();
 
 public:
-    constexpr TypeRecorder() : last_seen(nullptr), last_count(0) {}
+    constexpr TypeRecorder() : classes(), counts(), total(0), speculation_failures(0) {}
 
+    // Returns the class that this site almost always sees, if there is one and speculating on it hasn't
+    // failed too many times already.
     BoxedClass* predict();
 
+    int64_t* getSpeculationFailuresPtr() { return &speculation_failures; }
+    // For when the failure gets handled by the runtime rather than the JIT'd code.  Returns true if the site
+    // has now failed often enough that predict() gives up on it.  The JIT'd code bumps the same counter, so
+    // this can be true for several failures in a row; callers have to check whether they already acted on it.
+    bool recordSpeculationFailure();
+
     friend Box* recordType(TypeRecorder*, Box*);
 };
 
@@ -14,9 +14,11 @@
 
 #include "codegen/unwinding.h"
 
+#include <cstring>
 #include <dlfcn.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <unordered_set>
 
 #include "llvm/DebugInfo/DIContext.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
@@ -26,7 +28,9 @@
 #include "codegen/ast_interpreter.h"
 #include "codegen/codegen.h"
 #include "codegen/compvars.h"
+#include "codegen/irgen.h"
 #include "codegen/irgen/hooks.h"
+#include "codegen/memmgr.h"
 #include "codegen/stackmaps.h"
 #include "runtime/types.h"
 
@@ -179,26 +183,127 @@ public:
         assert(found_text);
         assert(found_eh_frame);
 
-        unw_dyn_info_t* dyn_info = new unw_dyn_info_t();
-        dyn_info->start_ip = text_addr;
-        dyn_info->end_ip = text_addr + text_size;
-        dyn_info->format = UNW_INFO_FORMAT_REMOTE_TABLE;
+        registerDynamicEhFrame(text_addr, text_size, eh_frame_addr, eh_frame_size);
+    }
+};
+
+void registerDynamicEhFrame(uint64_t code_addr, size_t code_size, uint64_t eh_frame_addr, size_t eh_frame_size) {
+    unw_dyn_info_t* dyn_info = new unw_dyn_info_t();
+    dyn_info->start_ip = code_addr;
+    dyn_info->end_ip = code_addr + code_size;
+    dyn_info->format = UNW_INFO_FORMAT_REMOTE_TABLE;
+
+    dyn_info->u.rti.name_ptr = 0;
+    dyn_info->u.rti.segbase = eh_frame_addr;
+    parseEhFrame(eh_frame_addr, eh_frame_size, &dyn_info->u.rti.table_data, &dyn_info->u.rti.table_len);
 
-        dyn_info->u.rti.name_ptr = 0;
-        dyn_info->u.rti.segbase = eh_frame_addr;
-        parseEhFrame(eh_frame_addr, eh_frame_size, &dyn_info->u.rti.table_data, &dyn_info->u.rti.table_len);
+    if (VERBOSITY())
+        printf("dyn_info = %p, table_data = %p\n", dyn_info, (void*)dyn_info->u.rti.table_data);
+    _U_dyn_register(dyn_info);
 
-        if (VERBOSITY())
-            printf("dyn_info = %p, table_data = %p\n", dyn_info, (void*)dyn_info->u.rti.table_data);
-        _U_dyn_register(dyn_info);
+    // TODO: it looks like libunwind does a linear search over anything dynamically registered,
+    // as opposed to the binary search it can do within a dyn_info.
+    // If we're registering a lot of dyn_info's, it might make sense to coalesce them into a single
+    // dyn_info that contains a binary search table.  EhFrameChunk does that for code that we generate ourselves.
+}
 
-        // TODO: it looks like libunwind does a linear search over anything dynamically registered,
-        // as opposed to the binary search it can do within a dyn_info.
-        // If we're registering a lot of dyn_info's, it might make sense to coalesce them into a single
-        // dyn_info that contains a binary search table.
+class EhFrameChunk {
+public:
+    const uint64_t chunk_start;
+    const uint64_t eh_frame_start;
+    // The end of the last function's eh_frame, which is where the next one goes:
+    uint64_t eh_frame_end;
+
+    // The table's offsets are relative to chunk_start, which is the dyn_info's segbase.
+    std::vector<uw_table_entry> table;
+    unw_dyn_info_t dyn_info;
+
+    EhFrameChunk(uint64_t chunk_start, uint64_t eh_frame_start)
+        : chunk_start(chunk_start), eh_frame_start(eh_frame_start), eh_frame_end(eh_frame_start) {
+        memset(&dyn_info, 0, sizeof(dyn_info));
+        dyn_info.format = UNW_INFO_FORMAT_REMOTE_TABLE;
+        dyn_info.u.rti.segbase = chunk_start;
     }
 };
 
+EhFrameChunk* createEhFrameChunk(uint64_t chunk_start, uint64_t eh_frame_start) {
+    assert(eh_frame_start >= chunk_start);
+    return new EhFrameChunk(chunk_start, eh_frame_start);
+}
+
+void addToEhFrameChunk(EhFrameChunk* chunk, uint64_t code_addr, size_t code_size, size_t eh_frame_size) {
+    uint64_t eh_frame_addr = chunk->eh_frame_end;
+    int cie_length = *(uint32_t*)eh_frame_addr;
+    assert(*(uint32_t*)(eh_frame_addr + 4) == 0); // CIE ID
+    assert(4 + cie_length < eh_frame_size);
+
+    assert(code_addr >= chunk->chunk_start);
+    assert(chunk->table.empty() || code_addr >= chunk->dyn_info.end_ip);
+    assert(code_addr + code_size - chunk->chunk_start < (1L << 31));
+    assert(eh_frame_addr + eh_frame_size - chunk->chunk_start < (1L << 31));
+
+    bool registered = !chunk->table.empty();
+    if (registered) {
+        _U_dyn_cancel(&chunk->dyn_info);
+        deregisterEHFrames((uint8_t*)chunk->eh_frame_start, chunk->eh_frame_start,
+                           chunk->eh_frame_end - chunk->eh_frame_start);
+    }
+
+    uw_table_entry entry;
+    entry.start_ip_offset = code_addr - chunk->chunk_start;
+    entry.fde_offset = eh_frame_addr + 4 + cie_length - chunk->chunk_start;
+    chunk->table.push_back(entry);
+    chunk->eh_frame_end = eh_frame_addr + eh_frame_size;
+    // libgcc finds the end of the section by its terminator:
+    assert(*(uint32_t*)chunk->eh_frame_end == 0);
+
+    if (!registered)
+        chunk->dyn_info.start_ip = code_addr;
+    chunk->dyn_info.end_ip = code_addr + code_size;
+    chunk->dyn_info.u.rti.table_data = (uintptr_t)&chunk->table[0];
+    chunk->dyn_info.u.rti.table_len = chunk->table.size();
+
+    _U_dyn_register(&chunk->dyn_info);
+    registerEHFrames((uint8_t*)chunk->eh_frame_start, chunk->eh_frame_start,
+                     chunk->eh_frame_end - chunk->eh_frame_start);
+}
+
+static uint64_t readFrameLocation(unw_cursor_t* cursor, CompiledFunction* cf,
+                                  const StackMap::Record::Location& loc) {
+    auto getReg = [cursor](int dwarf_num) {
+        assert(0 <= dwarf_num && dwarf_num < 16);
+
+        // for x86_64, at least, libunwind seems to use the dwarf numbering
+
+        unw_word_t rtn;
+        int code = unw_get_reg(cursor, dwarf_num, &rtn);
+        assert(code == 0);
+        return rtn;
+    };
+
+    if (loc.type == StackMap::Record::Location::LocationType::Register) {
+        // TODO: need to make sure we deal with patchpoints appropriately
+        return getReg(loc.regnum);
+    } else if (loc.type == StackMap::Record::Location::LocationType::Direct) {
+        uint64_t reg_val = getReg(loc.regnum);
+        return reg_val + loc.offset;
+    } else if (loc.type == StackMap::Record::Location::LocationType::Indirect) {
+        uint64_t reg_val = getReg(loc.regnum);
+        uint64_t addr = reg_val + loc.offset;
+        return *reinterpret_cast<uint64_t*>(addr);
+    } else if (loc.type == StackMap::Record::Location::LocationType::Constant) {
+        return loc.offset;
+    } else if (loc.type == StackMap::Record::Location::LocationType::ConstIndex) {
+        int const_idx = loc.offset;
+        assert(const_idx >= 0);
+        assert(const_idx < cf->location_map->constants.size());
+        return cf->location_map->constants[const_idx];
+    } else {
+        printf("%d %d %d %d\n", loc.type, loc.flags, loc.regnum, loc.offset);
+        abort();
+    }
+}
+
 struct PythonFrameId {
     enum FrameType {
         COMPILED,
@@ -234,29 +339,7 @@ public:
         return cf;
     }
 
-    uint64_t readLocation(const StackMap::Record::Location& loc) {
-        if (loc.type == StackMap::Record::Location::LocationType::Register) {
-            // TODO: need to make sure we deal with patchpoints appropriately
-            return getReg(loc.regnum);
-        } else if (loc.type == StackMap::Record::Location::LocationType::Direct) {
-            uint64_t reg_val = getReg(loc.regnum);
-            return reg_val + loc.offset;
-        } else if (loc.type == StackMap::Record::Location::LocationType::Indirect) {
-            uint64_t reg_val = getReg(loc.regnum);
-            uint64_t addr = reg_val + loc.offset;
-            return *reinterpret_cast<uint64_t*>(addr);
-        } else if (loc.type == StackMap::Record::Location::LocationType::Constant) {
-            return loc.offset;
-        } else if (loc.type == StackMap::Record::Location::LocationType::ConstIndex) {
-            int const_idx = loc.offset;
-            assert(const_idx >= 0);
-            assert(const_idx < cf->location_map->constants.size());
-            return getCF()->location_map->constants[const_idx];
-        } else {
-            printf("%d %d %d %d\n", loc.type, loc.flags, loc.regnum, loc.offset);
-            abort();
-        }
-    }
+    uint64_t readLocation(const StackMap::Record::Location& loc) { return readFrameLocation(&cursor, getCF(), loc); }
 
     AST_stmt* getCurrentStatement() {
         if (id.type == PythonFrameId::COMPILED) {
@@ -371,7 +454,9 @@ public:
                 this->id.bp = bp;
                 cf = getCFForInterpretedFrame((void*)bp);
 
-                cur_is_osr = (bool)cf->entry_descriptor;
+                // An interpreter that's running a compiled version is continuing a frame of that version
+                // that got deoptimized, which is the next frame up; skip it just like an OSR'd frame:
+                cur_is_osr = (bool)cf->entry_descriptor || !cf->is_interpreted;
                 if (was_osr) {
                     // Skip the frame we just found if the previous one was its OSR
                     // TODO this will break if we start collapsing the OSR frames
@@ -514,42 +599,61 @@ BoxedModule* getCurrentModule() {
     return compiledFunction->clfunc->source->parent_module;
 }
 
-BoxedDict* getLocals(bool only_user_visible) {
-    for (PythonFrameIterator& frame_info : unwindPythonFrames()) {
-        if (frame_info.getId().type == PythonFrameId::COMPILED) {
-            BoxedDict* d = new BoxedDict();
+// Returns the variables of a compiled frame.  Variables that might not be defined at this point have an
+// "!is_defined_" flag saying whether they are; the ones that aren't get left out, as do the flags themselves.
+static BoxedDict* localsForCompiledFrame(PythonFrameIterator& frame_it, bool only_user_visible) {
+    CompiledFunction* cf = frame_it.getCF();
+    uint64_t ip = frame_it.getId().ip;
 
-            CompiledFunction* cf = frame_info.getCF();
-            uint64_t ip = frame_info.getId().ip;
-
-            assert(ip > cf->code_start);
-            unsigned offset = ip - cf->code_start;
+    assert(ip > cf->code_start);
+    unsigned offset = ip - cf->code_start;
 
-            assert(cf->location_map);
-            for (const auto& p : cf->location_map->names) {
-                if (only_user_visible && (p.first[0] == '#' || p.first[0] == '!'))
-                    continue;
+    auto read_value = [&frame_it](const LocationMap::LocationTable::LocationEntry& e) {
+        llvm::SmallVector<uint64_t, 1> vals;
+        for (auto& loc : e.locations) {
+            vals.push_back(frame_it.readLocation(loc));
+        }
+        return e.type->deserializeFromFrame(vals);
+    };
 
-                for (const LocationMap::LocationTable::LocationEntry& e : p.second.locations) {
-                    if (e.offset < offset && offset <= e.offset + e.length) {
-                        const auto& locs = e.locations;
+    assert(cf->location_map);
+    std::unordered_set<std::string> undefined;
+    const std::string is_defined_prefix = getIsDefinedName("");
+    for (const auto& p : cf->location_map->names) {
+        if (!isIsDefinedName(p.first))
+            continue;
 
-                        llvm::SmallVector<uint64_t, 1> vals;
-                        // printf("%s: %s\n", p.first.c_str(), e.type->debugName().c_str());
+        for (const LocationMap::LocationTable::LocationEntry& e : p.second.locations) {
+            if (e.offset < offset && offset <= e.offset + e.length && read_value(e) == False)
+                undefined.insert(p.first.substr(is_defined_prefix.size()));
+        }
+    }
 
-                        for (auto& loc : locs) {
-                            vals.push_back(frame_info.readLocation(loc));
-                        }
+    BoxedDict* d = new BoxedDict();
+    for (const auto& p : cf->location_map->names) {
+        if (only_user_visible && (p.first[0] == '#' || p.first[0] == '!'))
+            continue;
+        if (isIsDefinedName(p.first) || undefined.count(p.first))
+            continue;
 
-                        Box* v = e.type->deserializeFromFrame(vals);
-                        // printf("%s: (pp id %ld) %p\n", p.first.c_str(), e._debug_pp_id, v);
-                        assert(gc::isValidGCObject(v));
-                        d->d[boxString(p.first)] = v;
-                    }
-                }
+        for (const LocationMap::LocationTable::LocationEntry& e : p.second.locations) {
+            if (e.offset < offset && offset <= e.offset + e.length) {
+                // printf("%s: %s\n", p.first.c_str(), e.type->debugName().c_str());
+                Box* v = read_value(e);
+                // printf("%s: (pp id %ld) %p\n", p.first.c_str(), e._debug_pp_id, v);
+                assert(gc::isValidGCObject(v));
+                d->d[boxString(p.first)] = v;
             }
+        }
+    }
+
+    return d;
+}
 
-            return d;
+BoxedDict* getLocals(bool only_user_visible) {
+    for (PythonFrameIterator& frame_info : unwindPythonFrames()) {
+        if (frame_info.getId().type == PythonFrameId::COMPILED) {
+            return localsForCompiledFrame(frame_info, only_user_visible);
         } else if (frame_info.getId().type == PythonFrameId::INTERPRETED) {
             return localsForInterpretedFrame((void*)frame_info.getId().bp, only_user_visible);
         } else {
@@ -559,6 +663,13 @@ BoxedDict* getLocals(bool only_user_visible) {
     RELEASE_ASSERT(0, "Internal error: unable to find any python frames");
 }
 
+FrameStackState getFrameStackState() {
+    std::unique_ptr<PythonFrameIterator> frame = getTopPythonFrame();
+    RELEASE_ASSERT(frame->getId().type == PythonFrameId::COMPILED, "can only deoptimize compiled frames");
+
+    return FrameStackState(frame->getCF(), frame->getCurrentStatement(), localsForCompiledFrame(*frame, false),
+                           frame->getFrameInfo());
+}
 
 llvm::JITEventListener* makeTracebacksListener() {
     return new TracebacksEventListener();
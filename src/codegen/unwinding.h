@@ -21,6 +21,21 @@
 
 namespace pyston {
 
+// Tells libunwind about the unwind info for some code that we generated ourselves.  The .eh_frame section has to
+// contain exactly one FDE, with no terminator after it.
+void registerDynamicEhFrame(uint64_t code_addr, size_t code_size, uint64_t eh_frame_addr, size_t eh_frame_size);
+
+// The unwind info for a chunk of memory that we put lots of small generated functions into, one after another.
+// Both libunwind and libgcc do a linear search over everything that's registered with them, so rather than
+// registering each function separately, the whole chunk takes up one registration with each.
+// The functions have to be added in increasing address order, with their eh_frames (one CIE and one FDE each)
+// laid out one after another starting at eh_frame_start.  Each eh_frame has to be followed by a zero terminator,
+// which the next one can overwrite.  Everything has to be within 2GB above chunk_start.
+class EhFrameChunk;
+EhFrameChunk* createEhFrameChunk(uint64_t chunk_start, uint64_t eh_frame_start);
+// The function's eh_frame has to already be written, at the end of the chunk's previous eh_frames.
+void addToEhFrameChunk(EhFrameChunk* chunk, uint64_t code_addr, size_t code_size, size_t eh_frame_size);
+
 std::vector<const LineInfo*> getTracebackEntries();
 const LineInfo* getMostRecentLineInfo();
 class BoxedModule;
@@ -29,6 +44,22 @@ BoxedModule* getCurrentModule();
 class BoxedDict;
 BoxedDict* getLocals(bool only_user_visible);
 
+struct FrameInfo;
+// The state of a compiled frame, which is what it takes to continue running it in the interpreter.
+struct FrameStackState {
+    CompiledFunction* cf;
+    AST_stmt* current_stmt;
+    // All of the frame's variables, including the internal ones (temporaries, closures, the generator).
+    BoxedDict* locals;
+    FrameInfo* frame_info;
+
+    FrameStackState(CompiledFunction* cf, AST_stmt* current_stmt, BoxedDict* locals, FrameInfo* frame_info)
+        : cf(cf), current_stmt(current_stmt), locals(locals), frame_info(frame_info) {}
+};
+
+// Reads out the state of the topmost python frame, which has to be a compiled one.
+FrameStackState getFrameStackState();
+
 // Fetches a writeable pointer to the frame-local excinfo object,
 // calculating it if necessary (from previous frames).
 ExcInfo* getFrameExcInfo();
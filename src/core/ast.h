@@ -24,6 +24,7 @@
 #include "llvm/ADT/StringRef.h"
 
 #include "core/common.h"
+#include "core/stringpool.h"
 
 namespace pyston {
 
@@ -259,6 +260,9 @@ public:
 };
 
 class AST_Attribute : public AST_expr {
+private:
+    InternedString interned_attr;
+
 public:
     AST_expr* value;
     AST_TYPE::AST_TYPE ctx_type;
@@ -267,6 +271,13 @@ public:
     virtual void accept(ASTVisitor* v);
     virtual void* accept_expr(ExprVisitor* v);
 
+    // attr gets interned the first time it's needed, and then stays that way:
+    InternedString getInternedAttr() {
+        if (interned_attr == InternedString())
+            interned_attr = InternedString::get(attr);
+        return interned_attr;
+    }
+
     AST_Attribute() : AST_expr(AST_TYPE::Attribute) {}
 
     AST_Attribute(AST_expr* value, AST_TYPE::AST_TYPE ctx_type, const std::string& attr)
@@ -654,15 +665,41 @@ public:
 };
 
 class AST_Name : public AST_expr {
+private:
+    InternedString interned_id;
+
 public:
     AST_TYPE::AST_TYPE ctx_type;
     std::string id;
 
+    // See AST_Attribute::getInternedAttr():
+    InternedString getInternedId() {
+        if (interned_id == InternedString())
+            interned_id = InternedString::get(id);
+        return interned_id;
+    }
+
+    // Where the name lives, from the point of view of the scope that it appears in.  This gets filled in (see
+    // resolveName()) when the function is lowered to bytecode, or the first time that the interpreter evaluates the
+    // name, so that it doesn't have to ask the ScopeInfo every time.
+    enum LookupType : uint8_t {
+        UNRESOLVED,
+        FAST,    // a local
+        DEREF,   // a local that nested scopes refer to, so it has to be stored in the closure as well
+        CLOSURE, // comes from an enclosing scope's closure
+        GLOBAL,
+        NAME, // a classdef local, which falls back to being a global if it isn't set
+    } lookup_type;
+    // For the kinds of names that are stored in the frame, the index of the name's slot (see
+    // ScopeInfo::getLocalSlot), and -1 otherwise.
+    int local_slot;
+
     virtual void accept(ASTVisitor* v);
     virtual void* accept_expr(ExprVisitor* v);
 
     AST_Name(const std::string& id, AST_TYPE::AST_TYPE ctx_type, int lineno, int col_offset = 0)
-        : AST_expr(AST_TYPE::Name, lineno, col_offset), ctx_type(ctx_type), id(id) {}
+        : AST_expr(AST_TYPE::Name, lineno, col_offset), ctx_type(ctx_type), id(id), lookup_type(UNRESOLVED),
+          local_slot(-1) {}
 
     static const AST_TYPE::AST_TYPE TYPE = AST_TYPE::Name;
 };
@@ -937,6 +974,9 @@ public:
 };
 
 class AST_ClsAttribute : public AST_expr {
+private:
+    InternedString interned_attr;
+
 public:
     AST_expr* value;
     std::string attr;
@@ -944,6 +984,13 @@ public:
     virtual void accept(ASTVisitor* v);
     virtual void* accept_expr(ExprVisitor* v);
 
+    // See AST_Attribute::getInternedAttr():
+    InternedString getInternedAttr() {
+        if (interned_attr == InternedString())
+            interned_attr = InternedString::get(attr);
+        return interned_attr;
+    }
+
     AST_ClsAttribute() : AST_expr(AST_TYPE::ClsAttribute) {}
 
     static const AST_TYPE::AST_TYPE TYPE = AST_TYPE::ClsAttribute;
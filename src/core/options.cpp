@@ -14,6 +14,8 @@
 
 #include "core/options.h"
 
+#include <cstddef>
+
 namespace pyston {
 
 int GLOBAL_VERBOSITY = 0;
@@ -28,6 +30,27 @@ int PYTHON_VERSION_MICRO = DEFAULT_PYTHON_MICRO_VERSION;
 int PYTHON_VERSION_HEX = version_hex(PYTHON_VERSION_MAJOR, PYTHON_VERSION_MINOR, PYTHON_VERSION_MICRO);
 
 int MAX_OPT_ITERATIONS = 1;
+int MAX_FUNCTION_VERSIONS = 8;
+
+int64_t REOPT_THRESHOLD_INTERPRETED = 10;
+int64_t REOPT_THRESHOLD_MINIMAL = 250;
+int64_t REOPT_THRESHOLD_MODERATE = 10000;
+int64_t OSR_THRESHOLD_INTERPRETED = 100;
+int64_t OSR_THRESHOLD_COMPILED = 10000;
+int64_t COMPILE_BUDGET_PERCENT = 100;
+int64_t BASELINE_JIT_THRESHOLD = 0;
+
+int IC_MEGAMORPHIC_EVICTIONS = 32;
+
+int GC_MARK_THREADS = 1;
+
+int GC_HEAP_GROWTH_PERCENT = 100;
+int GC_PAUSE_TARGET_MS = 0;
+int64_t GC_MIN_ALLOC_BYTES = 8 * 1024 * 1024;
+int64_t GC_MAX_ALLOC_BYTES = 1024 * 1024 * 1024;
+int64_t GC_RETAINED_FREE_BYTES = 16 * 1024 * 1024;
+int64_t GC_HEAP_PROFILE_SAMPLE_BYTES = 0;
+const char* JIT_OBJECT_CACHE_DIR = NULL;
 
 bool FORCE_OPTIMIZE = false;
 bool SHOW_DISASM = false;
@@ -38,6 +61,8 @@ bool USE_STRIPPED_STDLIB = true; // always true
 bool ENABLE_INTERPRETER = true;
 bool ENABLE_PYPA_PARSER = false;
 bool USE_REGALLOC_BASIC = true;
+bool ENABLE_GENERATIONAL_GC = false;
+bool ENABLE_BACKGROUND_COMPILATION = false;
 
 static bool _GLOBAL_ENABLE = 1;
 bool ENABLE_ICS = 1 && _GLOBAL_ENABLE;
@@ -54,12 +79,15 @@ bool ENABLE_ICBINEXPS = 1 && ENABLE_ICS;
 bool ENABLE_ICNONZEROS = 1 && ENABLE_ICS;
 bool ENABLE_SPECULATION = 1 && _GLOBAL_ENABLE;
 bool ENABLE_OSR = 1 && _GLOBAL_ENABLE;
+bool ENABLE_DEOPT = 1 && _GLOBAL_ENABLE;
+bool ENABLE_BASELINE_JIT = 1 && _GLOBAL_ENABLE;
 bool ENABLE_LLVMOPTS = 1 && _GLOBAL_ENABLE;
 bool ENABLE_INLINING = 1 && _GLOBAL_ENABLE;
 bool ENABLE_REOPT = 1 && _GLOBAL_ENABLE;
 bool ENABLE_PYSTON_PASSES = 1 && _GLOBAL_ENABLE;
 bool ENABLE_TYPE_FEEDBACK = 1 && _GLOBAL_ENABLE;
 bool ENABLE_RUNTIME_ICS = 1 && _GLOBAL_ENABLE;
+bool ENABLE_LAZY_SWEEPING = 1 && _GLOBAL_ENABLE;
 
 bool ENABLE_FRAME_INTROSPECTION = 1;
 bool BOOLS_AS_I64 = ENABLE_FRAME_INTROSPECTION;
@@ -15,6 +15,8 @@
 #ifndef PYSTON_CORE_OPTIONS_H
 #define PYSTON_CORE_OPTIONS_H
 
+#include <stdint.h>
+
 namespace pyston {
 
 extern "C" {
@@ -31,13 +33,59 @@ inline int version_hex(int major, int minor, int micro, int level = 0, int seria
 
 extern int MAX_OPT_ITERATIONS;
 
+// How many type-specialized versions pickVersion() will compile for a function before it falls back to
+// a single generic version that takes all of its arguments as UNKNOWN:
+extern int MAX_FUNCTION_VERSIONS;
+
+// The tiering policy's starting thresholds (see codegen/tiering.h): how many calls it takes for a version at
+// each effort level to get reoptimized, and how many loop iterations it takes to OSR out of the interpreter
+// or out of compiled code.  Compiling gets backed off once it takes more than COMPILE_BUDGET_PERCENT of the
+// time spent running (0 to disable).
+extern int64_t REOPT_THRESHOLD_INTERPRETED, REOPT_THRESHOLD_MINIMAL, REOPT_THRESHOLD_MODERATE;
+extern int64_t OSR_THRESHOLD_INTERPRETED, OSR_THRESHOLD_COMPILED;
+extern int64_t COMPILE_BUDGET_PERCENT;
+
+// Once an interpreted function has been called or gone around a loop this many times, the interpreter switches
+// to running it with baseline-JIT'd code (see codegen/baseline_jit.h).  0 means never: the baseline JIT still
+// tree-walks each statement's expressions and has no ICs of its own, so it's off unless asked for.
+extern int64_t BASELINE_JIT_THRESHOLD;
+
+// An IC that has had to evict one of its slots more than this many times in quick succession (see
+// ICInfo::num_evictions) is considered megamorphic, and stops getting rewritten:
+extern int IC_MEGAMORPHIC_EVICTIONS;
+
+// Number of threads (including the collecting thread) to use for the GC's mark phase:
+extern int GC_MARK_THREADS;
+
+// GC trigger policy (see runCollection() in gc/collector.cpp): the next collection happens once the
+// heap has grown by GC_HEAP_GROWTH_PERCENT over what was live after the last one, but always within
+// [GC_MIN_ALLOC_BYTES, GC_MAX_ALLOC_BYTES] bytes of allocation.  If GC_PAUSE_TARGET_MS is nonzero, a
+// generational collector that misses it does less work per pause, by putting off full collections and
+// shrinking the minor ones.
+extern int GC_HEAP_GROWTH_PERCENT, GC_PAUSE_TARGET_MS;
+extern int64_t GC_MIN_ALLOC_BYTES, GC_MAX_ALLOC_BYTES;
+
+// How much empty-but-committed memory the GC can hold onto for reuse; past that, freed memory gets
+// given back to the OS (see Heap::releaseFreeMemory()):
+extern int64_t GC_RETAINED_FREE_BYTES;
+
+// If nonzero, the heap profiler records the Python stack for one allocation every this many bytes;
+// see gc/heap_profiler.h.
+extern int64_t GC_HEAP_PROFILE_SAMPLE_BYTES;
+
+// If set, JIT'd object files get cached in this directory and reused by later runs; see codegen/object_cache.h.
+extern const char* JIT_OBJECT_CACHE_DIR;
+
 extern bool SHOW_DISASM, FORCE_OPTIMIZE, PROFILE, DUMPJIT, TRAP, USE_STRIPPED_STDLIB, ENABLE_INTERPRETER,
-    ENABLE_PYPA_PARSER, USE_REGALLOC_BASIC;
+    ENABLE_PYPA_PARSER, USE_REGALLOC_BASIC, ENABLE_GENERATIONAL_GC, ENABLE_BACKGROUND_COMPILATION;
 
 extern bool ENABLE_ICS, ENABLE_ICGENERICS, ENABLE_ICGETITEMS, ENABLE_ICSETITEMS, ENABLE_ICDELITEMS, ENABLE_ICBINEXPS,
     ENABLE_ICNONZEROS, ENABLE_ICCALLSITES, ENABLE_ICSETATTRS, ENABLE_ICGETATTRS, ENALBE_ICDELATTRS, ENABLE_ICGETGLOBALS,
-    ENABLE_SPECULATION, ENABLE_OSR, ENABLE_LLVMOPTS, ENABLE_INLINING, ENABLE_REOPT, ENABLE_PYSTON_PASSES,
-    ENABLE_TYPE_FEEDBACK, ENABLE_FRAME_INTROSPECTION, ENABLE_RUNTIME_ICS;
+    ENABLE_SPECULATION, ENABLE_OSR, ENABLE_DEOPT, ENABLE_BASELINE_JIT, ENABLE_LLVMOPTS, ENABLE_INLINING, ENABLE_REOPT,
+    ENABLE_PYSTON_PASSES, ENABLE_TYPE_FEEDBACK, ENABLE_FRAME_INTROSPECTION, ENABLE_RUNTIME_ICS, ENABLE_LAZY_SWEEPING;
+
+// ENABLE_LAZY_SWEEPING is forced off by -G (ENABLE_GENERATIONAL_GC), since the deferred sweep would dirty the
+// pages the write tracker watches.
 
 // Due to a temporary LLVM limitation, represent bools as i64's instead of i1's.
 extern bool BOOLS_AS_I64;
@@ -32,11 +32,20 @@ StatPerThreadCounter::StatPerThreadCounter(const std::string& name) {
     id = Stats::getStatId(buf);
 }
 
+// The background compiler thread logs stats without holding the GIL, so registering a new stat must not
+// move the existing counters:
+#define MAX_STATS 16384
+
 int Stats::getStatId(const std::string& name) {
+    static threading::PthreadFastMutex lock;
+    LOCK_REGION(&lock);
+
     // hacky but easy way of getting around static constructor ordering issues for now:
     static std::unordered_map<int, std::string> names;
     Stats::names = &names;
     static std::vector<long> counts;
+    if (counts.capacity() < MAX_STATS)
+        counts.reserve(MAX_STATS);
     Stats::counts = &counts;
     static std::unordered_map<std::string, int> made;
 
@@ -44,6 +53,7 @@ int Stats::getStatId(const std::string& name) {
         return made[name];
 
     int rtn = names.size();
+    RELEASE_ASSERT(rtn < MAX_STATS, "too many stats");
     names[rtn] = name;
     made[name] = rtn;
     counts.push_back(0);
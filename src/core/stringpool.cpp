@@ -0,0 +1,54 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/stringpool.h"
+
+#include <unordered_set>
+
+#include "core/stats.h"
+#include "core/threading.h"
+
+namespace pyston {
+
+static_assert(THREADING_USE_GIL, "have to make the intern table thread safe!");
+
+static std::unordered_set<std::string>& getPool() {
+    // Allocated on first use (and never freed) so that static initializers can intern strings too.  The elements
+    // of an unordered_set don't move when it rehashes, so it's safe to hand out pointers to them.
+    static std::unordered_set<std::string>* pool = new std::unordered_set<std::string>();
+    return *pool;
+}
+
+InternedString InternedString::lookup(const std::string& str) {
+    auto& pool = getPool();
+    auto it = pool.find(str);
+    if (it != pool.end())
+        return InternedString(&*it);
+
+    static StatCounter num_uninterned("num_uninterned_lookups");
+    num_uninterned.log();
+
+    static_assert(alignof(std::string) > 1, "need the low bit of the pointer");
+    return InternedString((const std::string*)((uintptr_t)&str | 1));
+}
+
+InternedString InternedString::get(const std::string& str) {
+    auto r = getPool().insert(str);
+    if (r.second) {
+        static StatCounter num_interned("num_interned_strings");
+        num_interned.log();
+    }
+    return InternedString(&*r.first);
+}
+}
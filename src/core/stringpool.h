@@ -0,0 +1,85 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_CORE_STRINGPOOL_H
+#define PYSTON_CORE_STRINGPOOL_H
+
+#include <functional>
+#include <string>
+
+#include "core/common.h"
+
+namespace pyston {
+
+// A string that lives in the global intern table.  There's only ever one copy of each interned string, so two
+// InternedStrings are equal iff they point to the same std::string, and they can be hashed and compared as pointers.
+// Attribute names get interned once on their way into the object model, so that everything below that (the hidden
+// classes, the class-hierarchy walks) doesn't have to look at the characters again.
+//
+// Interned strings are never freed, so code that only looks names up should use lookup() rather than get(): the names
+// that get looked up can come from anywhere (getattr(o, s) with some computed string, say), but all the names that are
+// actually stored somewhere got interned on their way in.
+class InternedString {
+private:
+    // For the InternedStrings that lookup() returns for names that aren't in the table, this is the caller's string
+    // with the low bit set, so that it doesn't compare equal to any interned string.
+    const std::string* _str;
+
+    explicit InternedString(const std::string* str) : _str(str) {}
+
+public:
+    InternedString() : _str(NULL) {}
+
+    static InternedString get(const std::string& str);
+    static InternedString get(const char* str) { return get(std::string(str)); }
+
+    // Returns the interned copy of str if there is one, without adding it to the table otherwise.  In that case the
+    // result just refers to str, and is only good for as long as str is; it doesn't compare equal to any interned
+    // string (nothing can be stored under that name yet), and must not be stored anywhere that outlives the lookup.
+    static InternedString lookup(const std::string& str);
+
+    // For code that is handed the address of an interned string (see getPtr()), like the JIT entry points that get
+    // a name that was interned when the code was generated:
+    static InternedString fromInternedPtr(const std::string* str) {
+        assert(get(*str).getPtr() == str);
+        return InternedString(str);
+    }
+
+    bool isInterned() const { return !((uintptr_t)_str & 1); }
+
+    const std::string& str() const {
+        assert(_str);
+        return *(const std::string*)((uintptr_t)_str & ~(uintptr_t)1);
+    }
+    const char* c_str() const { return str().c_str(); }
+    // The address of the interned copy, which is stable, for passing into code that takes a const std::string*:
+    const std::string* getPtr() const {
+        assert(isInterned());
+        return _str;
+    }
+
+    bool operator==(InternedString rhs) const { return _str == rhs._str; }
+    bool operator!=(InternedString rhs) const { return _str != rhs._str; }
+
+    friend struct std::hash<InternedString>;
+};
+}
+
+namespace std {
+template <> struct hash<pyston::InternedString> {
+    size_t operator()(const pyston::InternedString s) const { return hash<const std::string*>()(s._str); }
+};
+}
+
+#endif
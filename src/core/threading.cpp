@@ -482,15 +482,22 @@ static pthread_mutex_t gil = PTHREAD_MUTEX_INITIALIZER;
 
 static std::atomic<int> threads_waiting_on_gil(0);
 static pthread_cond_t gil_acquired = PTHREAD_COND_INITIALIZER;
+// Protected by the gil:
+static int64_t gil_acquisitions = 0;
 
 void acquireGLWrite() {
     threads_waiting_on_gil++;
     pthread_mutex_lock(&gil);
     threads_waiting_on_gil--;
+    gil_acquisitions++;
 
     pthread_cond_signal(&gil_acquired);
 }
 
+int64_t numGLWriteAcquisitions() {
+    return gil_acquisitions;
+}
+
 void releaseGLWrite() {
     pthread_mutex_unlock(&gil);
 }
@@ -523,6 +530,7 @@ void allowGLReadPreemption() {
         threads_waiting_on_gil++;
         pthread_cond_wait(&gil_acquired, &gil);
         threads_waiting_on_gil--;
+        gil_acquisitions++;
         pthread_cond_signal(&gil_acquired);
     }
 }
@@ -537,6 +545,8 @@ enum class GRWLHeldState {
 static __thread GRWLHeldState grwl_state = GRWLHeldState::N;
 
 static std::atomic<int> writers_waiting(0);
+// Protected by the grwl (in write mode):
+static int64_t grwl_write_acquisitions = 0;
 
 void acquireGLRead() {
     assert(grwl_state == GRWLHeldState::N);
@@ -556,10 +566,15 @@ void acquireGLWrite() {
     writers_waiting++;
     pthread_rwlock_wrlock(&grwl);
     writers_waiting--;
+    grwl_write_acquisitions++;
 
     grwl_state = GRWLHeldState::W;
 }
 
+int64_t numGLWriteAcquisitions() {
+    return grwl_write_acquisitions;
+}
+
 void releaseGLWrite() {
     assert(grwl_state == GRWLHeldState::W);
     pthread_rwlock_unlock(&grwl);
@@ -82,6 +82,9 @@ void releaseGLRead();
 void acquireGLWrite();
 void releaseGLWrite();
 void allowGLReadPreemption();
+// How many times the GL has been acquired for writing (which, with the GIL, is every time it's acquired).
+// Only meaningful to the thread that holds it.
+int64_t numGLWriteAcquisitions();
 // Note: promoteGL is free to drop the lock and then reacquire
 void promoteGL();
 void demoteGL();
@@ -139,6 +142,9 @@ inline void demoteGL() {
 }
 inline void allowGLReadPreemption() {
 }
+inline int64_t numGLWriteAcquisitions() {
+    return 0;
+}
 #endif
 
 
@@ -19,8 +19,10 @@
 // over having them spread randomly in different files, this should probably be split again
 // but in a way that makes more sense.
 
+#include <algorithm>
 #include <memory>
 #include <stddef.h>
+#include <unordered_map>
 #include <vector>
 
 #include "llvm/ADT/iterator_range.h"
@@ -28,6 +30,7 @@
 
 #include "core/common.h"
 #include "core/stats.h"
+#include "core/stringpool.h"
 
 namespace llvm {
 class Function;
@@ -132,6 +135,8 @@ class AST_stmt;
 
 class PhiAnalysis;
 class LivenessAnalysis;
+class Bytecode;
+class BaselineCode;
 class ScopingAnalysis;
 
 class CLFunction;
@@ -193,6 +198,8 @@ public:
     EffortLevel::EffortLevel effort;
 
     int64_t times_called;
+    // Whether a tier-up of this version is waiting for the background compiler thread:
+    bool reopt_queued;
     ICInvalidator dependent_callsites;
 
     LocationMap* location_map; // only meaningful if this is a compiled frame
@@ -203,7 +210,8 @@ public:
                      llvm::Value* llvm_code, EffortLevel::EffortLevel effort,
                      const OSREntryDescriptor* entry_descriptor)
         : clfunc(NULL), func(func), spec(spec), entry_descriptor(entry_descriptor), is_interpreted(is_interpreted),
-          code(code), llvm_code(llvm_code), effort(effort), times_called(0), location_map(nullptr) {}
+          code(code), llvm_code(llvm_code), effort(effort), times_called(0), reopt_queued(false),
+          location_map(nullptr) {}
 
     // TODO this will need to be implemented eventually; things to delete:
     // - line_table if it exists
@@ -222,6 +230,8 @@ public:
     CFG* cfg;
     LivenessAnalysis* liveness;
     PhiAnalysis* phis;
+    Bytecode* bytecode;
+    BaselineCode* baseline_code;
     bool is_generator;
 
     ScopeInfo* getScopeInfo();
@@ -263,6 +273,21 @@ public:
         versions; // any compiled versions along with their type parameters; in order from most preferred to least
     std::unordered_map<const OSREntryDescriptor*, CompiledFunction*> osr_versions;
 
+    // pickVersion()'s memo of which version to use for a given list of argument classes.  It has to be
+    // cleared whenever the version list changes, so use addVersion() and replaceVersion() to do that.
+    // It also gets cleared once it has MAX_VERSION_CACHE_ENTRIES entries, so that a function that gets called
+    // with lots of different argument classes doesn't hold onto all of them.
+    static const size_t MAX_VERSION_CACHE_ENTRIES = 64;
+    struct ArgClassesHash {
+        size_t operator()(const std::vector<BoxedClass*>& classes) const {
+            size_t rtn = classes.size();
+            for (BoxedClass* cls : classes)
+                rtn = rtn * 31 + std::hash<BoxedClass*>()(cls);
+            return rtn;
+        }
+    };
+    std::unordered_map<std::vector<BoxedClass*>, CompiledFunction*, ArgClassesHash> version_cache;
+
     // Functions can provide an "internal" version, which will get called instead
     // of the normal dispatch through the functionlist.
     // This can be used to implement functions which know how to rewrite themselves,
@@ -289,11 +314,26 @@ public:
         assert(compiled->is_interpreted == (compiled->code == NULL));
         assert(compiled->is_interpreted == (compiled->llvm_code == NULL));
         compiled->clfunc = this;
-        if (compiled->entry_descriptor == NULL)
+        if (compiled->entry_descriptor == NULL) {
             versions.push_back(compiled);
-        else
+            version_cache.clear();
+        } else
             osr_versions[compiled->entry_descriptor] = compiled;
     }
+
+    // Puts new_version (which has to have been added already) in old_version's place in the version list.
+    // pickVersion() uses the first version that fits, so this keeps the generic version, if there is one,
+    // from shadowing the version that got reoptimized.
+    void replaceVersion(CompiledFunction* old_version, CompiledFunction* new_version) {
+        auto new_it = std::find(versions.begin(), versions.end(), new_version);
+        assert(new_it != versions.end());
+        versions.erase(new_it);
+
+        auto it = std::find(versions.begin(), versions.end(), old_version);
+        assert(it != versions.end());
+        *it = new_version;
+        version_cache.clear();
+    }
 };
 
 CLFunction* createRTFunction(int num_args, int num_defaults, bool takes_varargs, bool takes_kwargs);
@@ -364,7 +404,7 @@ public:
 };
 
 class HiddenClass;
-extern HiddenClass* root_hcls;
+extern HiddenClass* root_hcls, *dict_backed_hcls;
 
 struct SetattrRewriteArgs;
 struct GetattrRewriteArgs;
@@ -401,15 +441,28 @@ public:
     HCAttrs* getHCAttrsPtr();
     BoxedDict* getDict();
 
-    void setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite_args);
+    // The versions that take an InternedString are the real implementations; the std::string ones are for callers
+    // that don't already have the name interned.  Only setattr() adds it to the intern table; the others just look
+    // it up (see InternedString::lookup()).
+    void setattr(InternedString attr, Box* val, SetattrRewriteArgs* rewrite_args);
+    void setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite_args) {
+        setattr(InternedString::get(attr), val, rewrite_args);
+    }
     void giveAttr(const std::string& attr, Box* val) {
         assert(this->getattr(attr) == NULL);
         this->setattr(attr, val, NULL);
     }
 
-    Box* getattr(const std::string& attr, GetattrRewriteArgs* rewrite_args);
-    Box* getattr(const std::string& attr) { return getattr(attr, NULL); }
-    void delattr(const std::string& attr, DelattrRewriteArgs* rewrite_args);
+    Box* getattr(InternedString attr, GetattrRewriteArgs* rewrite_args);
+    Box* getattr(const std::string& attr, GetattrRewriteArgs* rewrite_args) {
+        return getattr(InternedString::lookup(attr), rewrite_args);
+    }
+    Box* getattr(InternedString attr) { return getattr(attr, NULL); }
+    Box* getattr(const std::string& attr) { return getattr(InternedString::lookup(attr), NULL); }
+    void delattr(InternedString attr, DelattrRewriteArgs* rewrite_args);
+    void delattr(const std::string& attr, DelattrRewriteArgs* rewrite_args) {
+        delattr(InternedString::lookup(attr), rewrite_args);
+    }
 
     Box* reprIC();
     BoxedString* reprICAsString();
@@ -14,17 +14,26 @@
 
 #include "gc/collector.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <climits>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
 
 #include "codegen/ast_interpreter.h"
 #include "codegen/codegen.h"
 #include "core/common.h"
+#include "core/options.h"
 #include "core/threading.h"
 #include "core/types.h"
 #include "core/util.h"
 #include "gc/heap.h"
+#include "gc/heap_profiler.h"
 #include "runtime/types.h"
 
 #ifndef NVALGRIND
@@ -41,9 +50,20 @@ class TraceStack {
 private:
     std::vector<void*> v;
 
+    // In a minor collection, old objects are treated as if they were already marked:
+    // the only ones that can point to young objects are the ones that were written to since
+    // the last collection, and those get added with pushRemembered().
+    bool minor;
+
+    // Whether other marker threads might be marking objects at the same time as us.
+    bool parallel;
+
+    // Total size of the objects that we marked, for the collection policy:
+    size_t marked_bytes = 0;
+
 public:
-    TraceStack() {}
-    TraceStack(const std::vector<void*>& rhs) {
+    TraceStack(bool minor, bool parallel) : minor(minor), parallel(parallel) {}
+    TraceStack(const std::vector<void*>& rhs, bool minor) : minor(minor), parallel(false) {
         for (void* p : rhs) {
             assert(!isMarked(GCAllocation::fromUserData(p)));
             push(p);
@@ -53,15 +73,33 @@ public:
     void push(void* p) {
         GCAllocation* al = GCAllocation::fromUserData(p);
 
-        if (!isMarked(al)) {
-            setMark(al);
+        if (minor && isOld(al))
+            return;
 
-            v.push_back(p);
+        if (parallel) {
+            if (testAndSetMark(al))
+                return;
+        } else {
+            if (isMarked(al))
+                return;
+            setMark(al);
         }
+
+        marked_bytes += global_heap.allocationSize(al);
+        v.push_back(p);
+    }
+
+    // Scan an old object without marking it.
+    void pushRemembered(void* p) {
+        assert(minor);
+        assert(isOld(GCAllocation::fromUserData(p)));
+        v.push_back(p);
     }
 
     int size() { return v.size(); }
 
+    size_t markedBytes() { return marked_bytes; }
+
     void reserve(int num) { v.reserve(num + v.size()); }
 
     void* pop() {
@@ -72,6 +110,19 @@ public:
         }
         return NULL;
     }
+
+    // For moving work between marker threads; these objects have already been marked.
+    void moveTo(std::vector<void*>& dest, int n) {
+        assert(n <= v.size());
+        dest.insert(dest.end(), v.end() - n, v.end());
+        v.resize(v.size() - n);
+    }
+
+    void takeFrom(std::vector<void*>& src, int n) {
+        assert(n <= src.size());
+        v.insert(v.end(), src.end() - n, src.end());
+        src.resize(src.size() - n);
+    }
 };
 
 static std::vector<void*> roots;
@@ -170,16 +221,246 @@ void GCVisitor::visitPotentialRange(void* const* start, void* const* end) {
     }
 }
 
-static void markPhase() {
+static void visitByGCKind(void* p, GCVisitor& visitor) {
+    assert(((intptr_t)p) % 8 == 0);
+    GCAllocation* al = GCAllocation::fromUserData(p);
+
+    assert(isMarked(al) || isOld(al));
+
+    // printf("Marking + scanning %p\n", p);
+
+    GCKind kind_id = al->kind_id;
+    if (kind_id == GCKind::UNTRACKED) {
+        return;
+    } else if (kind_id == GCKind::CONSERVATIVE) {
+        uint32_t bytes = al->kind_data;
+        visitor.visitPotentialRange((void**)p, (void**)((char*)p + bytes));
+    } else if (kind_id == GCKind::PYTHON) {
+        Box* b = reinterpret_cast<Box*>(p);
+        BoxedClass* cls = b->cls;
+
+        if (cls) {
+            // The cls can be NULL since we use 'new' to construct them.
+            // An arbitrary amount of stuff can happen between the 'new' and
+            // the call to the constructor (ie the args get evaluated), which
+            // can trigger a collection.
+            ASSERT(cls->gc_visit, "%s", getTypeName(b)->c_str());
+            cls->gc_visit(&visitor, b);
+        }
+    } else {
+        RELEASE_ASSERT(0, "Unhandled kind: %d", (int)kind_id);
+    }
+}
+
+// Parallel marking.
+//
+// The roots get gathered on the collecting thread as usual, and then the transitive closure
+// is computed by GC_MARK_THREADS threads: the collecting thread plus a pool of helpers that
+// sleep in between collections.  Each thread marks off of its own TraceStack; when that
+// grows large and some other thread is out of work, it moves a batch of objects into its
+// public queue, where the idle threads can steal them.
+//
+// The gc_visit functions only read the heap, so the only thing that needs synchronization
+// is setting the mark bits, which is done with an atomic test-and-set.
+#define MARK_BATCH_SIZE 128
+
+class ParallelMarker {
+private:
+    struct WorkQueue {
+        threading::PthreadSpinLock lock;
+        std::vector<void*> items;
+        // Can be checked without taking the lock, to see if there is something to steal:
+        std::atomic<int> size;
+
+        WorkQueue() : size(0) {}
+    };
+
+    const int nthreads;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    pthread_mutex_t start_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+    int generation = 0;
+
+    // State for the current marking round:
+    bool minor = false;
+    std::atomic<int> nidle;
+    std::atomic<int> nhelpers_done;
+    std::atomic<size_t> marked_bytes;
+
+    static void* helperMain(void* arg);
+
+    bool anyQueueNonEmpty() {
+        for (auto& q : queues) {
+            if (q->size.load(std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
+    bool takeWork(int idx, TraceStack& stack) {
+        // Look at our own queue first, then try to steal half of someone else's:
+        for (int i = 0; i < nthreads; i++) {
+            WorkQueue* q = queues[(idx + i) % nthreads].get();
+            if (q->size.load(std::memory_order_relaxed) == 0)
+                continue;
+
+            LOCK_REGION(&q->lock);
+            int n = q->items.size();
+            if (n == 0)
+                continue;
+
+            int ntake = std::min(n, MARK_BATCH_SIZE);
+            if (i != 0)
+                ntake = std::max(ntake, n / 2);
+            stack.takeFrom(q->items, ntake);
+            q->size = q->items.size();
+            return true;
+        }
+        return false;
+    }
+
+    void work(int idx) {
+        TraceStack stack(minor, /* parallel */ true);
+        GCVisitor visitor(&stack);
+        WorkQueue* my_queue = queues[idx].get();
+
+        while (true) {
+            while (void* p = stack.pop()) {
+                visitByGCKind(p, visitor);
+
+                if (stack.size() > 2 * MARK_BATCH_SIZE && nidle.load(std::memory_order_relaxed) > 0) {
+                    LOCK_REGION(&my_queue->lock);
+                    stack.moveTo(my_queue->items, MARK_BATCH_SIZE);
+                    my_queue->size = my_queue->items.size();
+                }
+            }
+
+            if (takeWork(idx, stack))
+                continue;
+
+            // We're out of work.  A thread only goes idle once its own queue is empty, and only
+            // non-idle threads add to their queues, so once every thread is idle we are done.
+            nidle++;
+            while (true) {
+                if (nidle.load() == nthreads) {
+                    marked_bytes += stack.markedBytes();
+                    return;
+                }
+                if (anyQueueNonEmpty()) {
+                    nidle--;
+                    break;
+                }
+                sched_yield();
+            }
+        }
+    }
+
+public:
+    ParallelMarker(int nthreads) : nthreads(nthreads), nidle(0), nhelpers_done(0), marked_bytes(0) {
+        for (int i = 0; i < nthreads; i++)
+            queues.emplace_back(new WorkQueue());
+
+        for (int i = 1; i < nthreads; i++) {
+            pthread_t thread_id;
+            int code = pthread_create(&thread_id, NULL, helperMain, new std::pair<ParallelMarker*, int>(this, i));
+            RELEASE_ASSERT(code == 0, "%d", code);
+        }
+    }
+
+    void helperLoop(int idx) {
+        int seen_generation = 0;
+        while (true) {
+            pthread_mutex_lock(&start_mutex);
+            while (generation == seen_generation)
+                pthread_cond_wait(&start_cond, &start_mutex);
+            seen_generation = generation;
+            pthread_mutex_unlock(&start_mutex);
+
+#ifndef NVALGRIND
+            VALGRIND_DISABLE_ERROR_REPORTING;
+#endif
+            work(idx);
+#ifndef NVALGRIND
+            VALGRIND_ENABLE_ERROR_REPORTING;
+#endif
+
+            nhelpers_done++;
+        }
+    }
+
+    // Returns the total size of the objects that the marker threads marked.
+    size_t markFrom(TraceStack& roots, bool minor) {
+        static StatCounter sc_us("gc_parallel_mark_us");
+        Timer _t("parallel marking", /*min_usec=*/10000);
+
+        this->minor = minor;
+        nidle = 0;
+        nhelpers_done = 0;
+        marked_bytes = 0;
+
+        // The other threads will steal the roots from here:
+        roots.moveTo(queues[0]->items, roots.size());
+        queues[0]->size = queues[0]->items.size();
+
+        pthread_mutex_lock(&start_mutex);
+        generation++;
+        pthread_cond_broadcast(&start_cond);
+        pthread_mutex_unlock(&start_mutex);
+
+        work(0);
+
+        // Make sure nobody is still looking at this round's state before we return:
+        while (nhelpers_done.load() < nthreads - 1)
+            sched_yield();
+
+        sc_us.log(_t.end());
+        return marked_bytes.load();
+    }
+};
+
+void* ParallelMarker::helperMain(void* arg) {
+    auto p = static_cast<std::pair<ParallelMarker*, int>*>(arg);
+    ParallelMarker* marker = p->first;
+    int idx = p->second;
+    delete p;
+
+    // Leave signal handling to the Python threads:
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    marker->helperLoop(idx);
+    return NULL;
+}
+
+static ParallelMarker* getParallelMarker() {
+    static ParallelMarker* marker = new ParallelMarker(GC_MARK_THREADS);
+    return marker;
+}
+
+// Returns the total size of the objects that got marked (for a minor collection, the young objects that
+// survived).
+static size_t markPhase(bool minor) {
 #ifndef NVALGRIND
     // Have valgrind close its eyes while we do the conservative stack and data scanning,
     // since we'll be looking at potentially-uninitialized values:
     VALGRIND_DISABLE_ERROR_REPORTING;
 #endif
 
-    TraceStack stack(roots);
+    TraceStack stack(roots, minor);
     GCVisitor visitor(&stack);
 
+    if (minor) {
+        static StatCounter sc_remembered("gc_minor_remembered_objects");
+        int nremembered = 0;
+        global_heap.forEachDirtyOldObject([&stack, &nremembered](GCAllocation* al) {
+            stack.pushRemembered(al->user_data);
+            nremembered++;
+        });
+        sc_remembered.log(nremembered);
+    }
+
     threading::visitAllStacks(&visitor);
     gatherInterpreterRoots(&visitor);
 
@@ -198,67 +479,222 @@ static void markPhase() {
     }
 
     // if (VERBOSITY()) printf("Found %d roots\n", stack.size());
-    while (void* p = stack.pop()) {
-        assert(((intptr_t)p) % 8 == 0);
-        GCAllocation* al = GCAllocation::fromUserData(p);
-
-        assert(isMarked(al));
-
-        // printf("Marking + scanning %p\n", p);
-
-        GCKind kind_id = al->kind_id;
-        if (kind_id == GCKind::UNTRACKED) {
-            continue;
-        } else if (kind_id == GCKind::CONSERVATIVE) {
-            uint32_t bytes = al->kind_data;
-            visitor.visitPotentialRange((void**)p, (void**)((char*)p + bytes));
-        } else if (kind_id == GCKind::PYTHON) {
-            Box* b = reinterpret_cast<Box*>(p);
-            BoxedClass* cls = b->cls;
-
-            if (cls) {
-                // The cls can be NULL since we use 'new' to construct them.
-                // An arbitrary amount of stuff can happen between the 'new' and
-                // the call to the constructor (ie the args get evaluated), which
-                // can trigger a collection.
-                ASSERT(cls->gc_visit, "%s", getTypeName(b)->c_str());
-                cls->gc_visit(&visitor, b);
-            }
-        } else {
-            RELEASE_ASSERT(0, "Unhandled kind: %d", (int)kind_id);
+    size_t marked_bytes = 0;
+    if (GC_MARK_THREADS > 1) {
+        marked_bytes = getParallelMarker()->markFrom(stack, minor);
+    } else {
+        while (void* p = stack.pop()) {
+            visitByGCKind(p, visitor);
         }
     }
+    marked_bytes += stack.markedBytes();
 
 #ifndef NVALGRIND
     VALGRIND_ENABLE_ERROR_REPORTING;
 #endif
+
+    return marked_bytes;
+}
+
+static void sweepPhase(bool minor) {
+    global_heap.freeUnmarked(minor);
 }
 
-static void sweepPhase() {
-    global_heap.freeUnmarked();
+// In generational mode, every COLLECTIONS_PER_FULL'th collection is a full one, to free the
+// garbage that has accumulated in the old generation:
+#define COLLECTIONS_PER_FULL 8
+// ... but no less often than this, even when full collections are missing the pause target:
+#define MAX_COLLECTIONS_PER_FULL 64
+
+static GCStats stats;
+
+// How GC_PAUSE_TARGET_MS is currently being met; see adaptToPauseTarget().
+static int collections_per_full = COLLECTIONS_PER_FULL;
+static int64_t minor_alloc_percent = 100;
+
+const GCStats& getGCStats() {
+    stats.bytes_since_collection = getBytesAllocatedSinceCollection();
+    stats.threshold_bytes = getCollectionThreshold();
+    return stats;
 }
 
-static int ncollections = 0;
+// The only way to meet the pause target is to do less work per collection.  A full collection has to mark
+// the whole live heap however often it runs, so all we can do about slow ones is to put them off in favor
+// of minor collections.  The work of a minor collection is mostly proportional to how much got allocated
+// since the previous one, so when those are too slow we shrink the allocation budget in between them.
+// Without generational collection, there is nothing to adjust.
+static void adaptToPauseTarget(bool minor, int64_t pause_us) {
+    int64_t pause_target_us = GC_PAUSE_TARGET_MS * 1000L;
+    if (!ENABLE_GENERATIONAL_GC || pause_target_us <= 0) {
+        collections_per_full = COLLECTIONS_PER_FULL;
+        minor_alloc_percent = 100;
+        return;
+    }
+
+    if (minor) {
+        if (pause_us > pause_target_us)
+            minor_alloc_percent = std::max<int64_t>(1, minor_alloc_percent * pause_target_us / pause_us);
+        else if (pause_us < pause_target_us / 2)
+            minor_alloc_percent = std::min<int64_t>(100, minor_alloc_percent * 2);
+    } else {
+        if (pause_us > pause_target_us)
+            collections_per_full = std::min(collections_per_full * 2, MAX_COLLECTIONS_PER_FULL);
+        else
+            collections_per_full = COLLECTIONS_PER_FULL;
+    }
+}
+
+void updateCollectionThreshold() {
+    int64_t threshold = stats.live_bytes * GC_HEAP_GROWTH_PERCENT / 100;
+    threshold = threshold * minor_alloc_percent / 100;
+
+    threshold = std::max(threshold, GC_MIN_ALLOC_BYTES);
+    threshold = std::min(threshold, GC_MAX_ALLOC_BYTES);
+    setCollectionThreshold(threshold);
+}
+
+bool parseGCOptions(const char* spec) {
+    struct Setting {
+        const char* name;
+        int64_t value;
+        int64_t min, max;
+    };
+    Setting settings[] = {
+        { "growth_percent", GC_HEAP_GROWTH_PERCENT, 1, INT_MAX },
+        { "min_bytes", GC_MIN_ALLOC_BYTES, 1, INT64_MAX },
+        { "max_bytes", GC_MAX_ALLOC_BYTES, 1, INT64_MAX },
+        { "pause_target_ms", GC_PAUSE_TARGET_MS, 0, INT_MAX },
+    };
+
+    std::string s(spec);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos)
+            end = s.size();
+        std::string item = s.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (item.empty())
+            continue;
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            fprintf(stderr, "gc option '%s' should look like name=value\n", item.c_str());
+            return false;
+        }
+
+        std::string name = item.substr(0, eq);
+        Setting* setting = NULL;
+        for (Setting& candidate : settings) {
+            if (name == candidate.name)
+                setting = &candidate;
+        }
+        if (!setting) {
+            fprintf(stderr, "unknown gc option '%s'; valid options are:", name.c_str());
+            for (const Setting& candidate : settings)
+                fprintf(stderr, " %s", candidate.name);
+            fprintf(stderr, "\n");
+            return false;
+        }
+
+        const char* value_str = item.c_str() + eq + 1;
+        char* value_end;
+        long long value = strtoll(value_str, &value_end, 10);
+        if (*value_str == '\0' || *value_end != '\0' || value < setting->min || value > setting->max) {
+            fprintf(stderr, "gc option '%s' needs to be an integer between %ld and %ld\n", setting->name,
+                    setting->min, setting->max);
+            return false;
+        }
+
+        setting->value = value;
+    }
+
+    if (settings[1].value > settings[2].value) {
+        fprintf(stderr, "gc option min_bytes must not be greater than max_bytes\n");
+        return false;
+    }
+
+    GC_HEAP_GROWTH_PERCENT = settings[0].value;
+    GC_MIN_ALLOC_BYTES = settings[1].value;
+    GC_MAX_ALLOC_BYTES = settings[2].value;
+    GC_PAUSE_TARGET_MS = settings[3].value;
+    updateCollectionThreshold();
+    return true;
+}
+
+static int nminor_since_full = 0;
 void runCollection() {
     static StatCounter sc("gc_collections");
     sc.log();
 
-    ncollections++;
+    stats.ncollections++;
+
+    static StatCounter sc_allocated("gc_bytes_allocated");
+    sc_allocated.log(getBytesAllocatedSinceCollection());
+    resetBytesAllocatedSinceCollection();
+
+    bool minor = ENABLE_GENERATIONAL_GC && global_heap.canCollectMinor()
+                 && nminor_since_full + 1 < collections_per_full;
+    if (minor) {
+        static StatCounter sc_minor("gc_minor_collections");
+        sc_minor.log();
+        stats.nminor_collections++;
+        nminor_since_full++;
+    } else {
+        nminor_since_full = 0;
+    }
 
     if (VERBOSITY("gc") >= 2)
-        printf("Collection #%d\n", ncollections);
+        printf("Collection #%ld (%s)\n", stats.ncollections, minor ? "minor" : "full");
 
     Timer _t("collecting", /*min_usec=*/10000);
 
-    markPhase();
-    sweepPhase();
-    if (VERBOSITY("gc") >= 2)
-        printf("Collection #%d done\n\n", ncollections);
+    // The objects sitting on the threads' free lists look allocated but aren't real objects:
+    global_heap.flushThreadFreeLists();
+    // The blocks that haven't been swept since the last collection still have stale mark bits:
+    global_heap.finishSweeping();
+
+    size_t marked_bytes = markPhase(minor);
+    // The profiler needs to see the mark bits before the sweep clears them:
+    if (GC_HEAP_PROFILE_SAMPLE_BYTES)
+        updateHeapProfile(minor);
+    sweepPhase(minor);
+
+    // Everything that survived is now old; start tracking which old objects get written to.
+    // Sweeping a block writes to its header and to the gc flags of its objects, which is why -G
+    // turns off lazy sweeping: by this point the sweep has already been done.
+    if (ENABLE_GENERATIONAL_GC) {
+        assert(!ENABLE_LAZY_SWEEPING);
+        global_heap.resetWriteTracking();
+    }
 
     long us = _t.end();
     static StatCounter sc_us("gc_collections_us");
     sc_us.log(us);
 
+    // A minor collection only finds out about the young objects that survived; we assume that
+    // none of the old ones died.
+    if (minor)
+        stats.live_bytes += marked_bytes;
+    else
+        stats.live_bytes = marked_bytes;
+    stats.last_pause_us = us;
+    stats.max_pause_us = std::max(stats.max_pause_us, (int64_t)us);
+    stats.total_pause_us += us;
+
+    adaptToPauseTarget(minor, us);
+    updateCollectionThreshold();
+
+    static StatCounter sc_live("gc_live_bytes");
+    sc_live.log(stats.live_bytes);
+    static StatCounter sc_threshold("gc_threshold_bytes");
+    sc_threshold.log(getCollectionThreshold());
+
+    if (VERBOSITY("gc") >= 2)
+        printf("Collection #%ld done: %ld bytes live, next collection in %ld bytes\n\n", stats.ncollections,
+               stats.live_bytes, (int64_t)getCollectionThreshold());
+
     // dumpHeapStatistics();
 }
 
@@ -47,6 +47,24 @@ public:
 
 void runCollection();
 
+struct GCStats {
+    int64_t ncollections = 0, nminor_collections = 0;
+    // Our estimate of how many bytes were live at the end of the last collection:
+    int64_t live_bytes = 0;
+    int64_t last_pause_us = 0, max_pause_us = 0, total_pause_us = 0;
+    // How much has been allocated since the last collection, and how much will trigger the next one:
+    int64_t bytes_since_collection = 0, threshold_bytes = 0;
+};
+const GCStats& getGCStats();
+
+// Recomputes when the next collection should happen; call this after changing any of the
+// GC_* policy options.
+void updateCollectionThreshold();
+
+// Parses a comma-separated list of settings such as "growth_percent=50,max_bytes=100000000" into the
+// GC_* policy options.  Returns false, after printing an error, if it's malformed.
+bool parseGCOptions(const char* spec);
+
 // These are mostly for debugging:
 bool isValidGCObject(void* p);
 bool isNonheapRoot(void* p);
@@ -17,8 +17,10 @@
 
 #include <cstdlib>
 
+#include "core/options.h"
 #include "gc/collector.h"
 #include "gc/heap.h"
+#include "gc/heap_profiler.h"
 
 #ifndef NVALGRIND
 #include "valgrind.h"
@@ -52,6 +54,9 @@ extern "C" inline void* gc_alloc(size_t bytes, GCKind kind_id) {
         alloc->kind_data = bytes;
     }
 
+    if (unlikely(GC_HEAP_PROFILE_SAMPLE_BYTES))
+        profileAllocation(alloc, alloc_bytes);
+
     void* r = alloc->user_data;
 #ifndef NVALGRIND
     if (ENABLE_REDZONES) {
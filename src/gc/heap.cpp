@@ -13,11 +13,18 @@
 // limitations under the License.
 
 #include <cassert>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <pthread.h>
+#include <sched.h>
+#include <set>
 #include <stdint.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include "core/common.h"
 #include "core/util.h"
@@ -34,25 +41,51 @@
 namespace pyston {
 namespace gc {
 
-static unsigned bytesAllocatedSinceCollection;
-static __thread unsigned thread_bytesAllocatedSinceCollection;
-#define ALLOCBYTES_PER_COLLECTION 10000000
+static size_t bytesAllocatedSinceCollection;
+__thread unsigned thread_bytesAllocatedSinceCollection;
+
+__thread GCAllocation* thread_free_lists[NUM_BUCKETS];
+// Set by the collection policy in collector.cpp after every collection:
+static size_t allocbytes_per_collection = GC_MIN_ALLOC_BYTES;
+
+void setCollectionThreshold(size_t bytes) {
+    allocbytes_per_collection = bytes;
+}
+
+size_t getCollectionThreshold() {
+    return allocbytes_per_collection;
+}
+
+size_t getBytesAllocatedSinceCollection() {
+    return bytesAllocatedSinceCollection;
+}
+
+// Updated atomically, since the background sweeper frees objects too:
+static int64_t num_objects_swept = 0;
+
+int64_t getNumObjectsSwept() {
+    return __atomic_load_n(&num_objects_swept, __ATOMIC_ACQUIRE);
+}
+
+void resetBytesAllocatedSinceCollection() {
+    bytesAllocatedSinceCollection = 0;
+}
 
 void _collectIfNeeded(size_t bytes) {
     thread_bytesAllocatedSinceCollection += bytes;
-    if (unlikely(thread_bytesAllocatedSinceCollection > ALLOCBYTES_PER_COLLECTION / 4)) {
+    if (unlikely(thread_bytesAllocatedSinceCollection > allocbytes_per_collection / 4)) {
         bytesAllocatedSinceCollection += thread_bytesAllocatedSinceCollection;
         thread_bytesAllocatedSinceCollection = 0;
 
-        if (bytesAllocatedSinceCollection >= ALLOCBYTES_PER_COLLECTION) {
+        if (bytesAllocatedSinceCollection >= allocbytes_per_collection) {
             // bytesAllocatedSinceCollection = 0;
             // threading::GLPromoteRegion _lock;
             // runCollection();
 
             threading::GLPromoteRegion _lock;
-            if (bytesAllocatedSinceCollection >= ALLOCBYTES_PER_COLLECTION) {
+            if (bytesAllocatedSinceCollection >= allocbytes_per_collection) {
+                // runCollection() resets bytesAllocatedSinceCollection
                 runCollection();
-                bytesAllocatedSinceCollection = 0;
             }
         }
     }
@@ -82,11 +115,126 @@ public:
     }
 
     bool contains(void* addr) { return start <= addr && addr < cur; }
+
+    void* getStart() { return start; }
+    void* getCur() { return cur; }
 };
 
 static Arena small_arena((void*)0x1270000000L);
 static Arena large_arena((void*)0x2270000000L);
 
+// Generational collection support.
+//
+// The collector doesn't move objects, so young and old objects live side by side in the same blocks;
+// an object becomes old once it survives a collection ("sticky mark bits").  A minor collection treats
+// old objects as already marked and only frees young objects, which is only correct if it also scans
+// every old object that could have had a pointer to a young object stored into it since the last
+// collection.
+//
+// Instead of a software write barrier, which would have to cover every store in the runtime, in
+// C extensions, and inside the StlCompatAllocator-backed containers, we use the kernel's soft-dirty
+// page bits as a card table: we clear them at the end of every collection, and at the start of a
+// minor collection read /proc/self/pagemap to see which heap pages were written to in the meantime.
+// Young objects can only live on those pages, and any old object on one of them gets scanned as a root.
+#define PM_SOFT_DIRTY (1ULL << 55)
+static_assert(BLOCK_SIZE % PAGE_SIZE == 0, "");
+
+class WriteTracker {
+private:
+    int pagemap_fd = -1;
+    int clear_refs_fd = -1;
+    bool initialized = false;
+    bool supported = false;
+    bool tracking = false;
+
+    // One entry per page of the small arena; only valid during a minor collection.
+    std::vector<bool> small_dirty;
+
+    bool clearDirtyBits() { return write(clear_refs_fd, "4", 1) == 1; }
+
+    // Reads the soft-dirty bits of the pages in [start, end) and passes them to f one at a time.
+    template <typename F> void readPagemap(void* start, void* end, F f) {
+        uint64_t buf[512];
+        uintptr_t page = (uintptr_t)start / PAGE_SIZE;
+        uintptr_t end_page = ((uintptr_t)end + PAGE_SIZE - 1) / PAGE_SIZE;
+        while (page < end_page) {
+            size_t n = std::min(end_page - page, sizeof(buf) / sizeof(buf[0]));
+            ssize_t r = pread(pagemap_fd, buf, n * sizeof(uint64_t), page * sizeof(uint64_t));
+            RELEASE_ASSERT(r == n * sizeof(uint64_t), "%ld", r);
+            for (int i = 0; i < n; i++) {
+                f((buf[i] & PM_SOFT_DIRTY) != 0);
+            }
+            page += n;
+        }
+    }
+
+    bool probe() {
+        pagemap_fd = open("/proc/self/pagemap", O_RDONLY);
+        clear_refs_fd = open("/proc/self/clear_refs", O_WRONLY);
+        if (pagemap_fd == -1 || clear_refs_fd == -1)
+            return false;
+
+        // Kernels built without CONFIG_MEM_SOFT_DIRTY will accept the clear_refs write but never
+        // set the bit, so check that a write actually shows up:
+        char* page = (char*)mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert((uintptr_t)page != -1);
+        page[0] = 1;
+
+        bool dirty_before = true, dirty_after = false;
+        if (clearDirtyBits()) {
+            readPagemap(page, page + 1, [&](bool d) { dirty_before = d; });
+            page[0] = 2;
+            // Make sure the compiler doesn't sink the store past the check:
+            asm volatile("" ::: "memory");
+            readPagemap(page, page + 1, [&](bool d) { dirty_after = d; });
+        }
+
+        munmap(page, PAGE_SIZE);
+        return !dirty_before && dirty_after;
+    }
+
+public:
+    bool isTracking() { return tracking; }
+
+    void reset() {
+        if (!initialized) {
+            initialized = true;
+            supported = probe();
+            if (!supported && VERBOSITY("gc") >= 1)
+                fprintf(stderr, "Warning: soft-dirty page tracking unavailable, only doing full collections\n");
+        }
+
+        if (supported)
+            tracking = clearDirtyBits();
+    }
+
+    void snapshotSmallArena() {
+        small_dirty.clear();
+        readPagemap(small_arena.getStart(), small_arena.getCur(), [this](bool d) { small_dirty.push_back(d); });
+    }
+
+    bool isDirty(void* start, void* end) {
+        assert(small_arena.contains(start));
+        int first = ((char*)start - (char*)small_arena.getStart()) / PAGE_SIZE;
+        int last = ((char*)end - 1 - (char*)small_arena.getStart()) / PAGE_SIZE;
+        for (int i = first; i <= last; i++) {
+            if (small_dirty[i])
+                return true;
+        }
+        return false;
+    }
+
+    bool isDirty(Block* b) { return isDirty(b, b + 1); }
+
+    // Large objects are spread out over a sparse address range, so just query them individually:
+    bool isLargeDirty(void* start, void* end) {
+        bool dirty = false;
+        readPagemap(start, end, [&dirty](bool d) { dirty |= d; });
+        return dirty;
+    }
+};
+static WriteTracker write_tracker;
+
 struct LargeObj {
     LargeObj* next, **prev;
     size_t obj_size;
@@ -107,6 +255,166 @@ struct LargeObj {
     }
 };
 
+// Maps each page of the large arena to the LargeObj that it is a part of, so that looking up an interior
+// pointer into a large object is constant-time.  It's two-level, so that we only need memory for the
+// parts of the arena that currently have objects in them.
+class LargeObjPageMap {
+private:
+    // Each leaf covers 16MB of the arena, and the whole map covers 1TB.
+    static const int PAGES_PER_LEAF = 4096;
+    static const int NUM_LEAVES = 65536;
+
+    struct Leaf {
+        int num_used;
+        LargeObj* pages[PAGES_PER_LEAF];
+    };
+
+    Leaf* leaves[NUM_LEAVES];
+
+    uintptr_t pageIndex(void* p) { return ((uintptr_t)p - (uintptr_t)large_arena.getStart()) / PAGE_SIZE; }
+
+public:
+    void insert(LargeObj* obj, size_t mmap_size) {
+        uintptr_t first = pageIndex(obj);
+        uintptr_t end = first + mmap_size / PAGE_SIZE;
+        RELEASE_ASSERT(end <= (uintptr_t)NUM_LEAVES * PAGES_PER_LEAF, "ran out of large-object address space");
+
+        for (uintptr_t i = first; i < end; i++) {
+            Leaf*& leaf = leaves[i / PAGES_PER_LEAF];
+            if (!leaf)
+                leaf = (Leaf*)calloc(1, sizeof(Leaf));
+
+            assert(leaf->pages[i % PAGES_PER_LEAF] == NULL);
+            leaf->pages[i % PAGES_PER_LEAF] = obj;
+            leaf->num_used++;
+        }
+    }
+
+    void remove(LargeObj* obj, size_t mmap_size) {
+        uintptr_t first = pageIndex(obj);
+        uintptr_t end = first + mmap_size / PAGE_SIZE;
+
+        for (uintptr_t i = first; i < end; i++) {
+            Leaf*& leaf = leaves[i / PAGES_PER_LEAF];
+            assert(leaf && leaf->pages[i % PAGES_PER_LEAF] == obj);
+            leaf->pages[i % PAGES_PER_LEAF] = NULL;
+
+            if (--leaf->num_used == 0) {
+                ::free(leaf);
+                leaf = NULL;
+            }
+        }
+    }
+
+    LargeObj* lookup(void* ptr) {
+        assert(large_arena.contains(ptr));
+        uintptr_t idx = pageIndex(ptr);
+        Leaf* leaf = leaves[idx / PAGES_PER_LEAF];
+        if (!leaf)
+            return NULL;
+        return leaf->pages[idx % PAGES_PER_LEAF];
+    }
+};
+static LargeObjPageMap large_obj_map;
+
+// Objects up to this size (including the LargeObj header, rounded up to pages) get their pages from the
+// PageRunAllocator; anything bigger gets mmap'd and munmap'd on its own.
+#define MAX_PAGE_RUN_SIZE (1024 * 1024)
+
+// Medium-sized objects (too big for any of the small-object size classes, but under MAX_PAGE_RUN_SIZE)
+// get a run of pages in the large arena.  Freed runs get coalesced with any free neighbors and reused,
+// rather than going back to the kernel every time.
+class PageRunAllocator {
+private:
+    DS_DEFINE_SPINLOCK(lock);
+
+    // Free runs, indexed by start address (for coalescing) and by size (for best-fit allocation):
+    std::map<void*, size_t> free_by_addr;
+    std::set<std::pair<size_t, void*>> free_by_size;
+
+    // Roughly how much of the free runs' memory is still committed; it's an estimate since we don't
+    // track which parts of a coalesced run were decommitted.
+    size_t committed_free_bytes = 0;
+
+    void addFreeRun(void* start, size_t size) {
+        free_by_addr[start] = size;
+        free_by_size.insert(std::make_pair(size, start));
+    }
+
+    void removeFreeRun(std::map<void*, size_t>::iterator it) {
+        free_by_size.erase(std::make_pair(it->second, it->first));
+        free_by_addr.erase(it);
+    }
+
+public:
+    void* alloc(size_t size) {
+        assert(size % PAGE_SIZE == 0);
+        assert(size <= MAX_PAGE_RUN_SIZE);
+
+        LOCK_REGION(lock);
+
+        auto it = free_by_size.lower_bound(std::make_pair(size, (void*)NULL));
+        if (it == free_by_size.end())
+            return large_arena.doMmap(size);
+
+        static StatCounter sc_reused("gc_page_runs_reused");
+        sc_reused.log();
+
+        size_t run_size = it->first;
+        void* start = it->second;
+        removeFreeRun(free_by_addr.find(start));
+        committed_free_bytes -= std::min(committed_free_bytes, size);
+
+        if (run_size > size)
+            addFreeRun((char*)start + size, run_size - size);
+        return start;
+    }
+
+    void free(void* start, size_t size) {
+        assert(size % PAGE_SIZE == 0);
+
+        LOCK_REGION(lock);
+
+        committed_free_bytes += size;
+
+        auto next = free_by_addr.find((char*)start + size);
+        if (next != free_by_addr.end()) {
+            size += next->second;
+            removeFreeRun(next);
+        }
+
+        auto prev = free_by_addr.lower_bound(start);
+        if (prev != free_by_addr.begin()) {
+            --prev;
+            if ((char*)prev->first + prev->second == start) {
+                start = prev->first;
+                size += prev->second;
+                removeFreeRun(prev);
+            }
+        }
+
+        addFreeRun(start, size);
+    }
+
+    // Gives the memory of all the free runs back to the OS if there's more than max_bytes of it.
+    // The runs stay free, and will get faulted back in (as zero pages) when they get reused.
+    void decommitIfNeeded(size_t max_bytes) {
+        LOCK_REGION(lock);
+
+        if (committed_free_bytes <= max_bytes)
+            return;
+
+        static StatCounter sc_decommitted("gc_page_run_bytes_decommitted");
+        for (auto& p : free_by_addr) {
+            int r = madvise(p.first, p.second, MADV_DONTNEED);
+            assert(r == 0);
+            sc_decommitted.log(p.second);
+        }
+        committed_free_bytes = 0;
+    }
+};
+static PageRunAllocator page_runs;
+
 GCAllocation* Heap::allocLarge(size_t size) {
     _collectIfNeeded(size);
 
@@ -114,8 +422,13 @@ GCAllocation* Heap::allocLarge(size_t size) {
 
     size_t total_size = size + sizeof(LargeObj);
     total_size = (total_size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
-    LargeObj* rtn = (LargeObj*)large_arena.doMmap(total_size);
+    LargeObj* rtn;
+    if (total_size <= MAX_PAGE_RUN_SIZE)
+        rtn = (LargeObj*)page_runs.alloc(total_size);
+    else
+        rtn = (LargeObj*)large_arena.doMmap(total_size);
     rtn->obj_size = size;
+    large_obj_map.insert(rtn, total_size);
 
     rtn->next = large_head;
     if (rtn->next)
@@ -126,9 +439,205 @@ GCAllocation* Heap::allocLarge(size_t size) {
     return rtn->data;
 }
 
+// Lazy sweeping.
+//
+// At the end of a collection, instead of sweeping every block while the world is stopped, we just
+// flag them as needing a sweep.  A block then gets swept the first time the allocator wants to
+// allocate from it or free into it, or by the background sweeper thread if that gets there first;
+// whatever is left over gets swept at the beginning of the next collection, before we mark.
+// Lazy sweeping is disabled in generational mode (-G turns it off): the sweep's writes would dirty
+// every block for the write tracker, so there the sweep has to happen inside the collection.
+// The sweep state is updated atomically, since the background sweeper runs without the GIL.
+#define BLOCK_SWEPT 0
+#define BLOCK_NEEDS_SWEEP 1
+#define BLOCK_SWEEPING 2
+
+// Whether the last collection was a minor one; determines what the lazy sweep can free.
+static bool lazy_sweep_minor = false;
+// How many blocks the last collection left for the lazy sweep.  Whoever sweeps the last one sets
+// lazy_sweep_finished, and the next small allocation then releases the blocks that turned out to
+// be empty (that needs the world stopped, which the background sweeper can't do).
+static int64_t blocks_needing_sweep = 0;
+static bool lazy_sweep_finished = false;
+
+static void _doFree(GCAllocation* al, bool check_class = true);
+
+static void sweepBlock(Block* b, bool minor) {
+    int num_objects = b->numObjects();
+    int first_obj = b->minObjIndex();
+    int atoms_per_obj = b->atomsPerObj();
+    int nfreed = 0;
+
+    for (int obj_idx = first_obj; obj_idx < num_objects; obj_idx++) {
+        int atom_idx = obj_idx * atoms_per_obj;
+
+        if (b->isfree.isSet(atom_idx))
+            continue;
+
+        void* p = &b->atoms[atom_idx];
+        GCAllocation* al = reinterpret_cast<GCAllocation*>(p);
+
+        if (isMarked(al)) {
+            clearMark(al);
+            setOld(al);
+        } else if (minor && isOld(al)) {
+            // Old objects don't get marked in a minor collection.
+        } else {
+            // If we're sweeping lazily, the class object might have been freed and its memory reused
+            // by now, so we can't look at it.
+            _doFree(al, /* check_class */ !ENABLE_LAZY_SWEEPING);
+
+            // assert(p != (void*)0x127000d960); // the main module
+            b->isfree.set(atom_idx);
+            nfreed++;
+        }
+    }
+
+    if (nfreed)
+        __atomic_add_fetch(&num_objects_swept, nfreed, __ATOMIC_ACQ_REL);
+}
+
+static void _sweepBlockSlowpath(Block* b) {
+    uint32_t expected = BLOCK_NEEDS_SWEEP;
+    if (__atomic_compare_exchange_n(&b->sweep_state, &expected, BLOCK_SWEEPING, false, __ATOMIC_ACQUIRE,
+                                    __ATOMIC_ACQUIRE)) {
+        sweepBlock(b, lazy_sweep_minor);
+        __atomic_store_n(&b->sweep_state, BLOCK_SWEPT, __ATOMIC_RELEASE);
+        if (__atomic_sub_fetch(&blocks_needing_sweep, 1, __ATOMIC_ACQ_REL) == 0)
+            __atomic_store_n(&lazy_sweep_finished, true, __ATOMIC_RELEASE);
+        return;
+    }
+
+    // Some other thread is sweeping this block; wait for it to finish.
+    while (__atomic_load_n(&b->sweep_state, __ATOMIC_ACQUIRE) != BLOCK_SWEPT)
+        sched_yield();
+}
+
+static inline void sweepIfNeeded(Block* b) {
+    if (likely(__atomic_load_n(&b->sweep_state, __ATOMIC_ACQUIRE) == BLOCK_SWEPT))
+        return;
+    _sweepBlockSlowpath(b);
+}
+
+// Sweeps the blocks of the small arena in the background, in between collections.
+class BackgroundSweeper {
+private:
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+    bool started = false;
+
+    // Protected by the mutex:
+    bool has_work = false;
+    bool running = false;
+    void* arena_end = NULL;
+
+    static void* threadMain(void* arg) {
+        // Leave signal handling to the Python threads:
+        sigset_t mask;
+        sigfillset(&mask);
+        pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+        static_cast<BackgroundSweeper*>(arg)->loop();
+        return NULL;
+    }
+
+    void loop() {
+        while (true) {
+            pthread_mutex_lock(&mutex);
+            while (!has_work)
+                pthread_cond_wait(&cond, &mutex);
+            has_work = false;
+            running = true;
+            void* end = arena_end;
+            pthread_mutex_unlock(&mutex);
+
+            // Blocks that get allocated after the collection start out swept, so we only need to go
+            // up to where the arena ended at that point.
+            for (Block* b = (Block*)small_arena.getStart(); (void*)b < end; b++) {
+                sweepIfNeeded(b);
+            }
+
+            pthread_mutex_lock(&mutex);
+            running = false;
+            pthread_cond_broadcast(&cond);
+            pthread_mutex_unlock(&mutex);
+        }
+    }
+
+public:
+    void startSweeping() {
+        if (!started) {
+            started = true;
+            pthread_t thread_id;
+            int code = pthread_create(&thread_id, NULL, threadMain, this);
+            RELEASE_ASSERT(code == 0, "%d", code);
+        }
+
+        pthread_mutex_lock(&mutex);
+        has_work = true;
+        arena_end = small_arena.getCur();
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&mutex);
+    }
+
+    // Cancels any pending sweep, and waits for the current one (if any) to finish.
+    void waitUntilIdle() {
+        if (!started)
+            return;
+
+        pthread_mutex_lock(&mutex);
+        has_work = false;
+        while (running)
+            pthread_cond_wait(&cond, &mutex);
+        pthread_mutex_unlock(&mutex);
+    }
+};
+static BackgroundSweeper background_sweeper;
+
+// Blocks that became completely empty get taken off their lists and pooled here, to be handed out again
+// (for any size class) before we grow the small arena.  Pooled blocks have a size of 0.  Past
+// GC_RETAINED_FREE_BYTES of them, we decommit them with madvise(MADV_DONTNEED): the small arena keeps
+// the address range, but the memory goes back to the OS until the block gets reused.
+static std::vector<Block*> committed_block_pool;
+static std::vector<Block*> decommitted_block_pool;
+
+static void poolBlock(Block* b) {
+    b->next = NULL;
+    b->prev = NULL;
+    b->size = 0;
+    b->sweep_state = BLOCK_SWEPT;
+    committed_block_pool.push_back(b);
+}
+
+static void decommitPooledBlocks(size_t max_bytes) {
+    static StatCounter sc_decommitted("gc_blocks_decommitted");
+    while (committed_block_pool.size() * BLOCK_SIZE > max_bytes) {
+        Block* b = committed_block_pool.back();
+        committed_block_pool.pop_back();
+
+        // This zeroes the block, which leaves it looking like any other pooled block (size 0, swept).
+        int r = madvise(b, BLOCK_SIZE, MADV_DONTNEED);
+        assert(r == 0);
+        assert(b->size == 0);
+
+        decommitted_block_pool.push_back(b);
+        sc_decommitted.log();
+    }
+}
+
 static Block* alloc_block(uint64_t size, Block** prev) {
-    Block* rtn = (Block*)small_arena.doMmap(sizeof(Block));
+    Block* rtn;
+    if (committed_block_pool.size()) {
+        rtn = committed_block_pool.back();
+        committed_block_pool.pop_back();
+    } else if (decommitted_block_pool.size()) {
+        rtn = decommitted_block_pool.back();
+        decommitted_block_pool.pop_back();
+    } else {
+        rtn = (Block*)small_arena.doMmap(sizeof(Block));
+    }
     assert(rtn);
+    assert(rtn->sweep_state == BLOCK_SWEPT);
     rtn->size = size;
     rtn->prev = prev;
     rtn->next = NULL;
@@ -143,6 +652,7 @@ static Block* alloc_block(uint64_t size, Block** prev) {
     // Don't think I need to do this:
     rtn->isfree.setAllZero();
     rtn->next_to_check.reset();
+    rtn->sweep_state = BLOCK_SWEPT;
 
     int num_objects = rtn->numObjects();
     int num_lost = rtn->minObjIndex();
@@ -181,10 +691,23 @@ static void removeFromLL(Block* b) {
     b->prev = NULL;
 }
 
+static void flushFreeList(GCAllocation** free_list) {
+    while (GCAllocation* al = *free_list) {
+        *free_list = *reinterpret_cast<GCAllocation**>(al);
+
+        Block* b = Block::forPointer(al);
+        int atom_idx = reinterpret_cast<Atoms*>(al) - b->atoms;
+        assert(!b->isfree.isSet(atom_idx));
+        b->isfree.set(atom_idx);
+    }
+}
+
 Heap::ThreadBlockCache::~ThreadBlockCache() {
     LOCK_REGION(heap->lock);
 
     for (int i = 0; i < NUM_BUCKETS; i++) {
+        flushFreeList(&free_lists[i]);
+
         while (Block* b = cache_free_heads[i]) {
             removeFromLL(b);
             insertIntoLL(&heap->heads[i], b);
@@ -197,13 +720,26 @@ Heap::ThreadBlockCache::~ThreadBlockCache() {
     }
 }
 
-static GCAllocation* allocFromBlock(Block* b) {
-    int idx = b->isfree.scanForNext(b->next_to_check);
-    if (idx == -1)
-        return NULL;
+// Marks all of the block's free slots as allocated and strings them together into a free list,
+// in address order.  Returns the number of slots claimed.
+static int claimFreeSlots(Block* b, GCAllocation** free_list) {
+    sweepIfNeeded(b);
+
+    assert(*free_list == NULL);
+    GCAllocation** tail = free_list;
+    int nclaimed = 0;
+
+    b->next_to_check.reset();
+    int idx;
+    while ((idx = b->isfree.scanForNext(b->next_to_check)) != -1) {
+        GCAllocation* al = reinterpret_cast<GCAllocation*>(&b->atoms[idx]);
+        *tail = al;
+        tail = reinterpret_cast<GCAllocation**>(al);
+        nclaimed++;
+    }
+    *tail = NULL;
 
-    void* rtn = &b->atoms[idx];
-    return reinterpret_cast<GCAllocation*>(rtn);
+    return nclaimed;
 }
 
 static Block* claimBlock(size_t rounded_size, Block** free_head) {
@@ -217,35 +753,40 @@ static Block* claimBlock(size_t rounded_size, Block** free_head) {
 }
 
 GCAllocation* Heap::allocSmall(size_t rounded_size, int bucket_idx) {
-    _collectIfNeeded(rounded_size);
+    // This is the slow path of Heap::alloc(), for when this thread's free list for the bucket is empty.
+    if (unlikely(__atomic_load_n(&lazy_sweep_finished, __ATOMIC_ACQUIRE))) {
+        threading::GLPromoteRegion _lock;
+        if (__atomic_exchange_n(&lazy_sweep_finished, false, __ATOMIC_ACQ_REL))
+            releaseFreeMemory();
+    }
 
-    Block** free_head = &heads[bucket_idx];
-    Block** full_head = &full_heads[bucket_idx];
+    _collectIfNeeded(rounded_size);
 
     ThreadBlockCache* cache = thread_caches.get();
+    assert(cache->free_lists == thread_free_lists);
 
+    GCAllocation** free_list = &thread_free_lists[bucket_idx];
     Block** cache_head = &cache->cache_free_heads[bucket_idx];
 
-    // static __thread int gc_allocs = 0;
-    // if (++gc_allocs == 128) {
-    // static StatCounter sc_total("gc_allocs");
-    // sc_total.log(128);
-    // gc_allocs = 0;
-    //}
+    static StatCounter sc_refills("gc_free_list_refills");
 
     while (true) {
         while (Block* cache_block = *cache_head) {
-            GCAllocation* rtn = allocFromBlock(cache_block);
-            if (rtn)
-                return rtn;
-
             removeFromLL(cache_block);
             insertIntoLL(&cache->cache_full_heads[bucket_idx], cache_block);
-        }
 
-        // Not very useful to count the cache misses if we don't count the total attempts:
-        // static StatCounter sc_fallback("gc_allocs_cachemiss");
-        // sc_fallback.log();
+            int nclaimed = claimFreeSlots(cache_block, free_list);
+            if (nclaimed == 0)
+                continue;
+
+            sc_refills.log();
+            // The object we return was accounted for by the _collectIfNeeded() call above; the rest get
+            // counted by alloc() as it hands them out.
+
+            GCAllocation* rtn = *free_list;
+            *free_list = *reinterpret_cast<GCAllocation**>(rtn);
+            return rtn;
+        }
 
         LOCK_REGION(lock);
 
@@ -265,6 +806,7 @@ GCAllocation* Heap::allocSmall(size_t rounded_size, int bucket_idx) {
 
 void _freeFrom(GCAllocation* alloc, Block* b) {
     assert(b == Block::forPointer(alloc));
+    sweepIfNeeded(b);
 
     size_t size = b->size;
     int offset = (char*)alloc - (char*)b;
@@ -284,22 +826,39 @@ static void _freeLargeObj(LargeObj* lobj) {
     if (lobj->next)
         lobj->next->prev = lobj->prev;
 
-    int r = munmap(lobj, lobj->mmap_size());
-    assert(r == 0);
+    size_t mmap_size = lobj->mmap_size();
+    large_obj_map.remove(lobj, mmap_size);
+
+    if (mmap_size <= MAX_PAGE_RUN_SIZE) {
+        page_runs.free(lobj, mmap_size);
+    } else {
+        int r = munmap(lobj, mmap_size);
+        assert(r == 0);
+    }
 }
 
-static void _doFree(GCAllocation* al) {
+static void _doFree(GCAllocation* al, bool check_class) {
     if (VERBOSITY() >= 2)
         printf("Freeing %p\n", al->user_data);
 
-    if (al->kind_id == GCKind::PYTHON) {
+    if (check_class && al->kind_id == GCKind::PYTHON) {
         Box* b = (Box*)al->user_data;
         ASSERT(b->cls->tp_dealloc == NULL, "%s", getTypeName(b)->c_str());
     }
 }
 
+size_t Heap::allocationSize(GCAllocation* al) {
+    if (large_arena.contains(al))
+        return LargeObj::fromAllocation(al)->obj_size;
+
+    assert(small_arena.contains(al));
+    return Block::forPointer(al)->size;
+}
+
 void Heap::free(GCAllocation* al) {
     _doFree(al);
+    if (GC_HEAP_PROFILE_SAMPLE_BYTES)
+        profileFree(al);
 
     if (large_arena.contains(al)) {
         LargeObj* lobj = LargeObj::fromAllocation(al);
@@ -323,6 +882,8 @@ GCAllocation* Heap::realloc(GCAllocation* al, size_t bytes) {
         GCAllocation* rtn = alloc(bytes);
         memcpy(rtn, al, std::min(bytes, lobj->obj_size));
 
+        if (GC_HEAP_PROFILE_SAMPLE_BYTES)
+            profileFree(al);
         _freeLargeObj(lobj);
         return rtn;
     }
@@ -345,18 +906,18 @@ GCAllocation* Heap::realloc(GCAllocation* al, size_t bytes) {
     memcpy(rtn, al, std::min(bytes, size));
 #endif
 
+    if (GC_HEAP_PROFILE_SAMPLE_BYTES)
+        profileFree(al);
     _freeFrom(al, b);
     return rtn;
 }
 
 GCAllocation* Heap::getAllocationFromInteriorPointer(void* ptr) {
     if (large_arena.contains(ptr)) {
-        LargeObj* cur = large_head;
-        while (cur) {
-            if (ptr >= cur && ptr < &cur->data[cur->obj_size])
-                return &cur->data[0];
-            cur = cur->next;
-        }
+        LargeObj* obj = large_obj_map.lookup(ptr);
+        // The pointer could be in the unused space at the end of the last page:
+        if (obj && ptr < &obj->data[obj->obj_size])
+            return &obj->data[0];
         return NULL;
     }
 
@@ -365,6 +926,9 @@ GCAllocation* Heap::getAllocationFromInteriorPointer(void* ptr) {
 
     Block* b = Block::forPointer(ptr);
     size_t size = b->size;
+    // Pooled blocks don't have any objects in them:
+    if (size == 0)
+        return NULL;
     int offset = (char*)ptr - (char*)b;
     int obj_idx = offset / size;
 
@@ -379,38 +943,92 @@ GCAllocation* Heap::getAllocationFromInteriorPointer(void* ptr) {
     return reinterpret_cast<GCAllocation*>(&b->atoms[atom_idx]);
 }
 
-static Block** freeChain(Block** head) {
+static Block** freeChain(Block** head, bool minor) {
     while (Block* b = *head) {
-        int num_objects = b->numObjects();
-        int first_obj = b->minObjIndex();
-        int atoms_per_obj = b->atomsPerObj();
+        // Young objects can only be on pages that were written to since the last collection:
+        if (minor && !write_tracker.isDirty(b)) {
+            head = &b->next;
+            continue;
+        }
 
-        for (int obj_idx = first_obj; obj_idx < num_objects; obj_idx++) {
-            int atom_idx = obj_idx * atoms_per_obj;
+        if (ENABLE_LAZY_SWEEPING) {
+            assert(b->sweep_state == BLOCK_SWEPT);
+            b->sweep_state = BLOCK_NEEDS_SWEEP;
+            blocks_needing_sweep++;
+        } else {
+            sweepBlock(b, minor);
+        }
 
-            if (b->isfree.isSet(atom_idx))
-                continue;
+        head = &b->next;
+    }
+    return head;
+}
 
-            void* p = &b->atoms[atom_idx];
-            GCAllocation* al = reinterpret_cast<GCAllocation*>(p);
+void Heap::flushThreadFreeLists() {
+    thread_caches.forEachValue([](ThreadBlockCache* cache) {
+        for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
+            flushFreeList(&cache->free_lists[bidx]);
+        }
+    });
+}
 
-            if (isMarked(al)) {
-                clearMark(al);
-            } else {
-                _doFree(al);
+void Heap::finishSweeping() {
+    if (!ENABLE_LAZY_SWEEPING)
+        return;
 
-                // assert(p != (void*)0x127000d960); // the main module
-                b->isfree.set(atom_idx);
-            }
-        }
+    static StatCounter sc_us("gc_finish_sweeping_us");
+    Timer _t("finishing lazy sweep", /*min_usec=*/10000);
 
-        head = &b->next;
+    for (Block* b = (Block*)small_arena.getStart(); (void*)b < small_arena.getCur(); b++) {
+        sweepIfNeeded(b);
+    }
+
+    background_sweeper.waitUntilIdle();
+    assert(blocks_needing_sweep == 0);
+
+    // Unless that already happened when the sweep finished:
+    if (__atomic_exchange_n(&lazy_sweep_finished, false, __ATOMIC_ACQ_REL))
+        releaseFreeMemory();
+
+    sc_us.log(_t.end());
+}
+
+static void releaseEmptyBlocks(Block** head) {
+    static StatCounter sc_pooled("gc_blocks_pooled");
+
+    while (Block* b = *head) {
+        assert(b->sweep_state == BLOCK_SWEPT);
+        if (b->isEmpty()) {
+            removeFromLL(b);
+            poolBlock(b);
+            sc_pooled.log();
+        } else {
+            head = &b->next;
+        }
     }
-    return head;
 }
 
-void Heap::freeUnmarked() {
+void Heap::releaseFreeMemory() {
     thread_caches.forEachValue([this](ThreadBlockCache* cache) {
+        for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
+            releaseEmptyBlocks(&cache->cache_free_heads[bidx]);
+            releaseEmptyBlocks(&cache->cache_full_heads[bidx]);
+        }
+    });
+
+    for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
+        releaseEmptyBlocks(&heads[bidx]);
+        releaseEmptyBlocks(&full_heads[bidx]);
+    }
+
+    decommitPooledBlocks(GC_RETAINED_FREE_BYTES);
+    page_runs.decommitIfNeeded(GC_RETAINED_FREE_BYTES);
+}
+
+void Heap::freeUnmarked(bool minor) {
+    lazy_sweep_minor = minor;
+
+    thread_caches.forEachValue([this, minor](ThreadBlockCache* cache) {
         for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
             Block* h = cache->cache_free_heads[bidx];
             // Try to limit the amount of unused memory a thread can hold onto;
@@ -430,8 +1048,8 @@ void Heap::freeUnmarked() {
                 insertIntoLL(&heads[bidx], h);
             }
 
-            Block** chain_end = freeChain(&cache->cache_free_heads[bidx]);
-            freeChain(&cache->cache_full_heads[bidx]);
+            Block** chain_end = freeChain(&cache->cache_free_heads[bidx], minor);
+            freeChain(&cache->cache_full_heads[bidx], minor);
 
             while (Block* b = cache->cache_full_heads[bidx]) {
                 removeFromLL(b);
@@ -441,8 +1059,8 @@ void Heap::freeUnmarked() {
     });
 
     for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
-        Block** chain_end = freeChain(&heads[bidx]);
-        freeChain(&full_heads[bidx]);
+        Block** chain_end = freeChain(&heads[bidx], minor);
+        freeChain(&full_heads[bidx], minor);
 
         while (Block* b = full_heads[bidx]) {
             removeFromLL(b);
@@ -455,8 +1073,12 @@ void Heap::freeUnmarked() {
         GCAllocation* al = cur->data;
         if (isMarked(al)) {
             clearMark(al);
+            setOld(al);
+        } else if (minor && isOld(al)) {
+            // Old objects don't get marked in a minor collection.
         } else {
             _doFree(al);
+            num_objects_swept++;
 
             *cur->prev = cur->next;
             if (cur->next)
@@ -470,6 +1092,67 @@ void Heap::freeUnmarked() {
 
         cur = cur->next;
     }
+
+    // With lazy sweeping, we won't know which blocks are empty until they get swept; in that case
+    // this happens once the last block has been swept (or in finishSweeping(), whichever is first).
+    if (!ENABLE_LAZY_SWEEPING || blocks_needing_sweep == 0)
+        releaseFreeMemory();
+
+    // If we have spare cores, let them get a head start on the sweeping:
+    if (ENABLE_LAZY_SWEEPING && blocks_needing_sweep > 0 && GC_MARK_THREADS > 1)
+        background_sweeper.startSweeping();
+}
+
+bool Heap::canCollectMinor() {
+    return write_tracker.isTracking();
+}
+
+void Heap::resetWriteTracking() {
+    write_tracker.reset();
+}
+
+void Heap::forEachDirtyOldObject(std::function<void(GCAllocation*)> f) {
+    assert(write_tracker.isTracking());
+
+    write_tracker.snapshotSmallArena();
+
+    static StatCounter sc_clean("gc_minor_clean_blocks");
+    static StatCounter sc_dirty("gc_minor_dirty_blocks");
+
+    // Every page of the small arena belongs to a block, so we can walk them directly instead of
+    // going through the various block lists:
+    for (Block* b = (Block*)small_arena.getStart(); (void*)b < small_arena.getCur(); b++) {
+        // Skip pooled blocks:
+        if (b->size == 0)
+            continue;
+
+        if (!write_tracker.isDirty(b)) {
+            sc_clean.log();
+            continue;
+        }
+        sc_dirty.log();
+
+        int num_objects = b->numObjects();
+        int first_obj = b->minObjIndex();
+        int atoms_per_obj = b->atomsPerObj();
+
+        for (int obj_idx = first_obj; obj_idx < num_objects; obj_idx++) {
+            int atom_idx = obj_idx * atoms_per_obj;
+
+            if (b->isfree.isSet(atom_idx))
+                continue;
+
+            GCAllocation* al = reinterpret_cast<GCAllocation*>(&b->atoms[atom_idx]);
+            if (isOld(al) && write_tracker.isDirty(al, (char*)al + b->size))
+                f(al);
+        }
+    }
+
+    for (LargeObj* cur = large_head; cur; cur = cur->next) {
+        GCAllocation* al = cur->data;
+        if (isOld(al) && write_tracker.isLargeDirty(cur, (char*)cur + cur->mmap_size()))
+            f(al);
+    }
 }
 
 void dumpHeapStatistics() {
@@ -518,7 +1201,7 @@ void addStatistic(HeapStatistics* stats, GCAllocation* al, int nbytes) {
 }
 
 // TODO: copy-pasted from freeChain
-void getChainStatistics(HeapStatistics* stats, Block** head) {
+static void visitChainAllocations(Block** head, const std::function<void(GCAllocation*, size_t)>& f) {
     while (Block* b = *head) {
         int num_objects = b->numObjects();
         int first_obj = b->minObjIndex();
@@ -533,40 +1216,42 @@ void getChainStatistics(HeapStatistics* stats, Block** head) {
             void* p = &b->atoms[atom_idx];
             GCAllocation* al = reinterpret_cast<GCAllocation*>(p);
 
-            addStatistic(stats, al, b->size);
+            f(al, b->size);
         }
 
         head = &b->next;
     }
 }
 
-// TODO: copy-pasted from freeUnmarked()
-void Heap::dumpHeapStatistics() {
-    threading::GLPromoteRegion _lock;
-
-    HeapStatistics stats;
-
-    thread_caches.forEachValue([this, &stats](ThreadBlockCache* cache) {
+void Heap::visitAllocations(std::function<void(GCAllocation*, size_t)> f) {
+    thread_caches.forEachValue([this, &f](ThreadBlockCache* cache) {
         for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
-            Block* h = cache->cache_free_heads[bidx];
-
-            getChainStatistics(&stats, &cache->cache_free_heads[bidx]);
-            getChainStatistics(&stats, &cache->cache_full_heads[bidx]);
+            visitChainAllocations(&cache->cache_free_heads[bidx], f);
+            visitChainAllocations(&cache->cache_full_heads[bidx], f);
         }
     });
 
     for (int bidx = 0; bidx < NUM_BUCKETS; bidx++) {
-        getChainStatistics(&stats, &heads[bidx]);
-        getChainStatistics(&stats, &full_heads[bidx]);
+        visitChainAllocations(&heads[bidx], f);
+        visitChainAllocations(&full_heads[bidx], f);
     }
 
     LargeObj* cur = large_head;
     while (cur) {
-        GCAllocation* al = cur->data;
-        addStatistic(&stats, al, cur->capacity());
-
+        f(cur->data, cur->capacity());
         cur = cur->next;
     }
+}
+
+void Heap::dumpHeapStatistics() {
+    threading::GLPromoteRegion _lock;
+
+    flushThreadFreeLists();
+    finishSweeping();
+
+    HeapStatistics stats;
+
+    visitAllocations([&stats](GCAllocation* al, size_t nbytes) { addStatistic(&stats, al, nbytes); });
 
     stats.conservative.print("conservative");
     stats.untracked.print("untracked");
@@ -17,6 +17,7 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 
 #include "core/common.h"
 #include "core/threading.h"
@@ -26,10 +27,11 @@ namespace gc {
 
 typedef uint8_t kindid_t;
 struct GCAllocation {
-    unsigned int gc_flags : 8;
-    GCKind kind_id : 8;
-    unsigned int _reserved1 : 16;
-    unsigned int kind_data : 32;
+    // Not a bitfield, so that the marker threads can update it atomically:
+    uint8_t gc_flags;
+    GCKind kind_id;
+    uint16_t _reserved1;
+    uint32_t kind_data;
 
     char user_data[0];
 
@@ -42,6 +44,8 @@ static_assert(sizeof(GCAllocation) <= sizeof(void*),
               "we should try to make sure the gc header is word-sized or smaller");
 
 #define MARK_BIT 0x1
+// Set on objects that have survived a collection (only meaningful for generational collection):
+#define OLD_BIT 0x2
 
 inline bool isMarked(GCAllocation* header) {
     return (header->gc_flags & MARK_BIT) != 0;
@@ -52,12 +56,27 @@ inline void setMark(GCAllocation* header) {
     header->gc_flags |= MARK_BIT;
 }
 
+// Sets the mark bit, returning whether it was already set.  Safe to call from multiple
+// marker threads at once.
+inline bool testAndSetMark(GCAllocation* header) {
+    return (__atomic_fetch_or(&header->gc_flags, MARK_BIT, __ATOMIC_RELAXED) & MARK_BIT) != 0;
+}
+
 inline void clearMark(GCAllocation* header) {
     assert(isMarked(header));
     header->gc_flags &= ~MARK_BIT;
 }
 
+inline bool isOld(GCAllocation* header) {
+    return (header->gc_flags & OLD_BIT) != 0;
+}
+
+inline void setOld(GCAllocation* header) {
+    header->gc_flags |= OLD_BIT;
+}
+
 #undef MARK_BIT
+#undef OLD_BIT
 
 
 template <int N> class Bitmap {
@@ -86,6 +105,13 @@ public:
 
     void clear(int idx) { data[idx / 64] &= ~(1UL << (idx % 64)); }
 
+    int count() {
+        int rtn = 0;
+        for (int i = 0; i < N / 64; i++)
+            rtn += __builtin_popcountll(data[i]);
+        return rtn;
+    }
+
     int scanForNext(Scanner& sc) {
         uint64_t mask = 0;
 
@@ -137,6 +163,8 @@ struct Block {
             uint64_t size;
             Bitmap<ATOMS_PER_BLOCK> isfree;
             Bitmap<ATOMS_PER_BLOCK>::Scanner next_to_check;
+            // One of the BLOCK_* sweep states in heap.cpp; accessed atomically.
+            uint32_t sweep_state;
             void* _header_end[0];
         };
         Atoms atoms[ATOMS_PER_BLOCK];
@@ -148,6 +176,9 @@ struct Block {
 
     inline int atomsPerObj() { return size / ATOM_SIZE; }
 
+    // Only the first atom of each object slot ever gets its isfree bit set:
+    inline bool isEmpty() { return isfree.count() == numObjects() - minObjIndex(); }
+
     static Block* forPointer(void* ptr) { return (Block*)((uintptr_t)ptr & ~(BLOCK_SIZE - 1)); }
 };
 static_assert(sizeof(Block) == BLOCK_SIZE, "bad size");
@@ -161,6 +192,34 @@ constexpr const size_t sizes[] = {
 };
 #define NUM_BUCKETS (sizeof(sizes) / sizeof(sizes[0]))
 
+// Maps (bytes + ATOM_SIZE - 1) / ATOM_SIZE to the index of the smallest bucket that fits that many bytes,
+// so that picking a size class is a single load:
+constexpr const uint8_t size_classes[] = {
+    0,  0,  1,  2,  3,  4,  5,  6,  7,  8,  8,  9,  9,  10, 10, 11, 11, 12, 12, 12, 12, 13, 13, 13, 13, 14,
+    14, 14, 14, 15, 15, 15, 15, 16, 16, 16, 16, 16, 16, 16, 16, 17, 17, 17, 17, 17, 17, 17, 17, 18, 18, 18,
+    18, 18, 18, 18, 18, 19, 19, 19, 19, 19, 19, 19, 19, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20,
+    20, 20, 20, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 22, 22, 22, 22, 22, 22, 22,
+    22, 22, 22, 22, 22, 22, 22, 22, 22, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23,
+};
+#define NUM_SIZE_CLASSES (sizeof(size_classes) / sizeof(size_classes[0]))
+static_assert(NUM_SIZE_CLASSES == sizes[NUM_BUCKETS - 1] / ATOM_SIZE + 1, "bad size class table");
+
+constexpr bool sizeClassesValid(size_t i) {
+    return i == NUM_SIZE_CLASSES || (sizes[size_classes[i]] >= i * ATOM_SIZE
+                                     && (size_classes[i] == 0 || sizes[size_classes[i] - 1] < i * ATOM_SIZE)
+                                     && sizeClassesValid(i + 1));
+}
+static_assert(sizeClassesValid(0), "size class table doesn't match the bucket sizes");
+
+// Each thread allocates small objects by popping them off of its own per-bucket free lists, which
+// get refilled by claiming all of the free slots of one of the thread's blocks at once.  The objects
+// on these lists are marked as allocated in their blocks, and are linked together through their
+// first word; Heap::flushThreadFreeLists() puts them back before anything looks at the heap.
+extern __thread GCAllocation* thread_free_lists[NUM_BUCKETS];
+// Bytes this thread has allocated that haven't been added to the global count yet.  Allocations off
+// the free lists only get added here; the next slow-path allocation checks whether to collect.
+extern __thread unsigned thread_bytesAllocatedSinceCollection;
+
 struct LargeObj;
 class Heap {
 private:
@@ -178,8 +237,10 @@ private:
         Heap* heap;
         Block* cache_free_heads[NUM_BUCKETS];
         Block* cache_full_heads[NUM_BUCKETS];
+        // This thread's thread_free_lists:
+        GCAllocation** free_lists;
 
-        ThreadBlockCache(Heap* heap) : heap(heap) {
+        ThreadBlockCache(Heap* heap) : heap(heap), free_lists(thread_free_lists) {
             memset(cache_free_heads, 0, sizeof(cache_free_heads));
             memset(cache_full_heads, 0, sizeof(cache_full_heads));
         }
@@ -195,33 +256,62 @@ public:
     GCAllocation* realloc(GCAllocation* alloc, size_t bytes);
 
     GCAllocation* __attribute__((__malloc__)) alloc(size_t bytes) {
-        GCAllocation* rtn;
-        // assert(bytes >= 16);
-        if (bytes <= 16)
-            rtn = allocSmall(16, 0);
-        else if (bytes <= 32)
-            rtn = allocSmall(32, 1);
-        else if (bytes > sizes[NUM_BUCKETS - 1])
-            rtn = allocLarge(bytes);
-        else {
-            rtn = NULL;
-            for (int i = 2; i < NUM_BUCKETS; i++) {
-                if (sizes[i] >= bytes) {
-                    rtn = allocSmall(sizes[i], i);
-                    break;
-                }
-            }
+        if (unlikely(bytes > sizes[NUM_BUCKETS - 1]))
+            return allocLarge(bytes);
+
+        int bucket_idx = size_classes[(bytes + ATOM_SIZE - 1) / ATOM_SIZE];
+        GCAllocation* rtn = thread_free_lists[bucket_idx];
+        if (likely(rtn != NULL)) {
+            thread_free_lists[bucket_idx] = *reinterpret_cast<GCAllocation**>(rtn);
+            thread_bytesAllocatedSinceCollection += sizes[bucket_idx];
+            return rtn;
         }
 
-        return rtn;
+        return allocSmall(sizes[bucket_idx], bucket_idx);
     }
 
     void free(GCAllocation* alloc);
 
+    // The number of bytes reserved for this allocation (including the header), ie its size class:
+    size_t allocationSize(GCAllocation* alloc);
+
     // not thread safe:
     GCAllocation* getAllocationFromInteriorPointer(void* ptr);
     // not thread safe:
-    void freeUnmarked();
+    // In a minor collection, only young (not-yet-old) objects are candidates for freeing.
+    // With lazy sweeping, small-object blocks only get scheduled to be swept here; they are
+    // swept once the allocator (or the background sweeper) gets to them, and the empty ones get
+    // released by the first small allocation after the last of them has been swept.
+    void freeUnmarked(bool minor);
+    // not thread safe:
+    // Returns the objects on every thread's free lists to their blocks.  Needs to happen before
+    // anything walks the heap, since those objects look allocated but have no valid header.
+    void flushThreadFreeLists();
+    // not thread safe:
+    // Sweeps whatever blocks haven't been lazily swept since the last collection.
+    void finishSweeping();
+    // not thread safe:
+    // Moves completely-empty blocks into the block pool, and gives memory back to the OS if we
+    // are holding onto too much of it.  Blocks need to have been swept already.
+    void releaseFreeMemory();
+
+    // Generational collection support; see the comment on WriteTracker in heap.cpp.
+    // Whether we know which pages have been written to since the last collection, ie whether
+    // a minor collection is currently possible:
+    bool canCollectMinor();
+    // Called at the end of every collection (in generational mode) to start tracking writes again.
+    // Nothing else may write to the heap before the mutator resumes, which is why lazy sweeping
+    // is off in generational mode.
+    void resetWriteTracking();
+    // not thread safe:
+    // Calls f on every old object that has been written to since the last collection, since those
+    // are the only old objects that could be pointing to young objects.
+    void forEachDirtyOldObject(std::function<void(GCAllocation*)> f);
+
+    // not thread safe:
+    // Calls f on every allocation in the heap, along with the number of bytes reserved for it.  The thread
+    // free lists need to have been flushed and all of the blocks swept.
+    void visitAllocations(std::function<void(GCAllocation*, size_t)> f);
 
     void dumpHeapStatistics();
 };
@@ -229,6 +319,16 @@ public:
 extern Heap global_heap;
 void dumpHeapStatistics();
 
+// Allocation accounting for the collection policy in collector.cpp: a collection gets triggered
+// once the threshold number of bytes have been allocated since the previous one.
+void setCollectionThreshold(size_t bytes);
+size_t getCollectionThreshold();
+size_t getBytesAllocatedSinceCollection();
+void resetBytesAllocatedSinceCollection();
+// How many objects collections have freed so far (not counting explicit frees).  With lazy sweeping
+// this lags behind until the sweep finishes.
+int64_t getNumObjectsSwept();
+
 } // namespace gc
 } // namespace pyston
 
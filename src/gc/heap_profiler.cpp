@@ -0,0 +1,216 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gc/heap_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "codegen/unwinding.h"
+#include "core/common.h"
+#include "core/options.h"
+#include "core/stats.h"
+#include "core/threading.h"
+#include "core/types.h"
+#include "core/util.h"
+#include "gc/heap.h"
+#include "runtime/types.h"
+
+namespace pyston {
+namespace gc {
+
+namespace {
+struct Sample {
+    size_t bytes;
+    // The Python stack that made the allocation, outermost frame first, as "file:line:function" entries
+    // separated by semicolons:
+    std::string stack;
+    // We don't know the object's class at the time we sample it, so this gets filled in by the first
+    // collection that the object survives:
+    std::string cls_name;
+};
+
+struct LiveStats {
+    int64_t nobjects, nbytes;
+    LiveStats() : nobjects(0), nbytes(0) {}
+
+    void add(int64_t bytes) {
+        nobjects++;
+        nbytes += bytes;
+    }
+};
+}
+
+static DS_DEFINE_MUTEX(profile_lock);
+// Sampled objects that haven't been found to be dead yet:
+static std::unordered_map<GCAllocation*, Sample> live_samples;
+// Live objects and bytes per class, as of the last collection:
+static std::map<std::string, LiveStats> live_by_class;
+static int64_t nprofiled_collections = 0;
+
+static __thread int64_t bytes_until_sample = 0;
+static __thread bool in_profiler = false;
+
+static std::string currentPythonStack() {
+    std::string rtn;
+    for (const LineInfo* line_info : getTracebackEntries()) {
+        if (!rtn.empty())
+            rtn += ';';
+        rtn += line_info->file + ":" + std::to_string(line_info->line) + ":" + line_info->func;
+        delete line_info;
+    }
+
+    if (rtn.empty())
+        return "<no python frames>";
+    return rtn;
+}
+
+void profileAllocation(GCAllocation* al, size_t bytes) {
+    bytes_until_sample -= bytes;
+    if (likely(bytes_until_sample > 0))
+        return;
+    bytes_until_sample = GC_HEAP_PROFILE_SAMPLE_BYTES;
+
+    // Unwinding shouldn't allocate from the GC heap, but make sure we don't recurse if it does:
+    if (in_profiler)
+        return;
+    in_profiler = true;
+
+    static StatCounter sc_samples("gc_heap_profile_samples");
+    sc_samples.log();
+
+    Sample sample;
+    sample.bytes = bytes;
+    sample.stack = currentPythonStack();
+
+    {
+        LOCK_REGION(profile_lock);
+        live_samples[al] = std::move(sample);
+    }
+
+    in_profiler = false;
+}
+
+void profileFree(GCAllocation* al) {
+    LOCK_REGION(profile_lock);
+    live_samples.erase(al);
+}
+
+static std::string describeAllocation(GCAllocation* al) {
+    if (al->kind_id == GCKind::PYTHON) {
+        BoxedClass* cls = reinterpret_cast<Box*>(al->user_data)->cls;
+        // Objects whose constructor hasn't run yet:
+        if (!cls)
+            return "<uninitialized>";
+        return getFullNameOfClass(cls);
+    } else if (al->kind_id == GCKind::CONSERVATIVE) {
+        return "<conservative>";
+    } else if (al->kind_id == GCKind::UNTRACKED) {
+        return "<untracked>";
+    } else {
+        RELEASE_ASSERT(0, "%d", (int)al->kind_id);
+    }
+}
+
+void updateHeapProfile(bool minor) {
+    static StatCounter sc_us("gc_heap_profile_us");
+    Timer _t("updating the heap profile", /*min_usec=*/10000);
+
+    // Old objects don't get marked in a minor collection, so we have to assume they're still alive.
+    auto is_live = [minor](GCAllocation* al) { return isMarked(al) || (minor && isOld(al)); };
+
+    // Group by class pointer first, since getting the name of a class isn't cheap:
+    std::unordered_map<BoxedClass*, LiveStats> by_cls;
+    LiveStats conservative, untracked;
+    global_heap.visitAllocations([&](GCAllocation* al, size_t nbytes) {
+        if (!is_live(al))
+            return;
+
+        if (al->kind_id == GCKind::PYTHON)
+            by_cls[reinterpret_cast<Box*>(al->user_data)->cls].add(nbytes);
+        else if (al->kind_id == GCKind::CONSERVATIVE)
+            conservative.add(nbytes);
+        else
+            untracked.add(nbytes);
+    });
+
+    live_by_class.clear();
+    for (const auto& p : by_cls) {
+        LiveStats& s = live_by_class[p.first ? getFullNameOfClass(p.first) : "<uninitialized>"];
+        s.nobjects += p.second.nobjects;
+        s.nbytes += p.second.nbytes;
+    }
+    if (conservative.nobjects)
+        live_by_class["<conservative>"] = conservative;
+    if (untracked.nobjects)
+        live_by_class["<untracked>"] = untracked;
+
+    {
+        LOCK_REGION(profile_lock);
+        for (auto it = live_samples.begin(); it != live_samples.end();) {
+            if (!is_live(it->first)) {
+                it = live_samples.erase(it);
+                continue;
+            }
+
+            if (it->second.cls_name.empty() || it->second.cls_name == "<uninitialized>")
+                it->second.cls_name = describeAllocation(it->first);
+            ++it;
+        }
+    }
+
+    nprofiled_collections++;
+    sc_us.log(_t.end());
+}
+
+bool writeHeapProfile(const char* filename) {
+    FILE* f = fopen(filename, "w");
+    if (!f)
+        return false;
+
+    fprintf(f, "# pyston heap profile\n");
+    fprintf(f, "sample_bytes %ld\n", GC_HEAP_PROFILE_SAMPLE_BYTES);
+    fprintf(f, "collections %ld\n", nprofiled_collections);
+
+    // class <live bytes> <live objects> <class name>
+    for (const auto& p : live_by_class) {
+        fprintf(f, "class %ld %ld %s\n", p.second.nbytes, p.second.nobjects, p.first.c_str());
+    }
+
+    // Each sample stands for GC_HEAP_PROFILE_SAMPLE_BYTES worth of allocations (or just itself, if it's bigger
+    // than that), which gives an estimate of how many bytes each allocation site is retaining.
+    std::map<std::pair<std::string, std::string>, LiveStats> by_site;
+    {
+        LOCK_REGION(profile_lock);
+        for (const auto& p : live_samples) {
+            const Sample& sample = p.second;
+            const std::string& cls_name = sample.cls_name.empty() ? "<unknown>" : sample.cls_name;
+            by_site[std::make_pair(cls_name, sample.stack)].add(
+                std::max((int64_t)sample.bytes, GC_HEAP_PROFILE_SAMPLE_BYTES));
+        }
+    }
+
+    // site <estimated live bytes> <live samples> <class name> <stack>
+    for (const auto& p : by_site) {
+        fprintf(f, "site %ld %ld %s %s\n", p.second.nbytes, p.second.nobjects, p.first.first.c_str(),
+                p.first.second.c_str());
+    }
+
+    return fclose(f) == 0;
+}
+}
+}
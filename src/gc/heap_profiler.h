@@ -0,0 +1,42 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PYSTON_GC_HEAPPROFILER_H
+#define PYSTON_GC_HEAPPROFILER_H
+
+#include <cstddef>
+
+namespace pyston {
+namespace gc {
+
+struct GCAllocation;
+
+// The heap profiler is enabled by setting GC_HEAP_PROFILE_SAMPLE_BYTES (the -H flag).  It does two things:
+// - it samples one allocation every GC_HEAP_PROFILE_SAMPLE_BYTES bytes, remembering the Python stack that
+//   made it, and keeps track of which of the sampled objects are still alive;
+// - after every collection, it totals up the live bytes of each class.
+// writeHeapProfile() dumps both to a file, and tools/heap_profile_diff.py compares two such snapshots.
+
+// Called by gc_alloc() for every allocation while profiling:
+void profileAllocation(GCAllocation* al, size_t bytes);
+// Called by gc_free():
+void profileFree(GCAllocation* al);
+// Called by the collector in between the mark and sweep phases:
+void updateHeapProfile(bool minor);
+// Writes out a snapshot of the profile as of the last collection.  Returns false if the file couldn't be written.
+bool writeHeapProfile(const char* filename);
+}
+}
+
+#endif
@@ -30,6 +30,7 @@
 #include "codegen/entry.h"
 #include "codegen/irgen/hooks.h"
 #include "codegen/parser.h"
+#include "codegen/tiering.h"
 #include "core/ast.h"
 #include "core/common.h"
 #include "core/options.h"
@@ -37,6 +38,7 @@
 #include "core/threading.h"
 #include "core/types.h"
 #include "core/util.h"
+#include "gc/collector.h"
 #include "runtime/objmodel.h"
 #include "runtime/types.h"
 
@@ -58,7 +60,16 @@ int main(int argc, char** argv) {
     bool force_repl = false;
     bool repl = true;
     bool stats = false;
-    while ((code = getopt(argc, argv, "+Oqcdibpjtrsvnx")) != -1) {
+
+    // Settings from the command line take precedence over the ones from the environment:
+    const char* tiering_env = getenv("PYSTON_TIERING");
+    if (tiering_env && !parseTieringOptions(tiering_env))
+        return 2;
+    const char* gc_env = getenv("PYSTON_GC");
+    if (gc_env && !gc::parseGCOptions(gc_env))
+        return 2;
+
+    while ((code = getopt(argc, argv, "+OqcdibpjtrsvnxGaT:H:C:J:g:")) != -1) {
         if (code == 'O')
             FORCE_OPTIMIZE = true;
         else if (code == 't')
@@ -87,6 +98,33 @@ int main(int argc, char** argv) {
             USE_REGALLOC_BASIC = false;
         } else if (code == 'x') {
             ENABLE_PYPA_PARSER = true;
+        } else if (code == 'G') {
+            ENABLE_GENERATIONAL_GC = true;
+            // Sweeping writes to every block it touches, so a sweep left for later would make the whole heap
+            // look dirty to the next minor collection; see the comment on WriteTracker in gc/heap.cpp.
+            ENABLE_LAZY_SWEEPING = false;
+        } else if (code == 'a') {
+            ENABLE_BACKGROUND_COMPILATION = true;
+        } else if (code == 'T') {
+            GC_MARK_THREADS = atoi(optarg);
+            if (GC_MARK_THREADS < 1) {
+                fprintf(stderr, "-T requires a positive number of threads\n");
+                return 2;
+            }
+        } else if (code == 'H') {
+            GC_HEAP_PROFILE_SAMPLE_BYTES = atol(optarg);
+            if (GC_HEAP_PROFILE_SAMPLE_BYTES < 1) {
+                fprintf(stderr, "-H requires a positive number of bytes\n");
+                return 2;
+            }
+        } else if (code == 'C') {
+            JIT_OBJECT_CACHE_DIR = optarg;
+        } else if (code == 'J') {
+            if (!parseTieringOptions(optarg))
+                return 2;
+        } else if (code == 'g') {
+            if (!gc::parseGCOptions(optarg))
+                return 2;
         } else if (code == '?')
             abort();
     }
@@ -132,7 +170,8 @@ int main(int argc, char** argv) {
 
     // end of argument parsing
 
-    _t.split("to run");
+    static StatCounter us_startup("us_startup_total");
+    us_startup.log(_t.split("to run"));
     BoxedModule* main_module = NULL;
     if (fn != NULL) {
         llvm::SmallString<128> path;
@@ -166,13 +166,20 @@ extern "C" Box* dir(Box* obj) {
         result = new BoxedList();
     }
 
-    for (auto const& kv : obj->cls->attrs.hcls->attr_offsets) {
-        listAppend(result, boxString(kv.first));
+    HiddenClass* cls_hcls = obj->cls->attrs.hcls;
+    for (int i = 0; i < cls_hcls->attributeArraySize(); i++) {
+        listAppend(result, boxString(cls_hcls->getAttrName(i).str()));
     }
     if (obj->cls->instancesHaveHCAttrs()) {
         HCAttrs* attrs = obj->getHCAttrsPtr();
-        for (auto const& kv : attrs->hcls->attr_offsets) {
-            listAppend(result, boxString(kv.first));
+        if (attrs->hcls->getType() == HiddenClass::DICT_BACKED) {
+            for (auto const& kv : getDictBackedAttrs(attrs)->d) {
+                listAppend(result, kv.first);
+            }
+        } else {
+            for (int i = 0; i < attrs->hcls->attributeArraySize(); i++) {
+                listAppend(result, boxString(attrs->hcls->getAttrName(i).str()));
+            }
         }
     }
     if (obj->cls->instancesHaveDictAttrs()) {
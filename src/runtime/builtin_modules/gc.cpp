@@ -0,0 +1,121 @@
+// Copyright (c) 2014-2015 Dropbox, Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "core/options.h"
+#include "core/threading.h"
+#include "core/types.h"
+#include "gc/collector.h"
+#include "gc/heap.h"
+#include "gc/heap_profiler.h"
+#include "runtime/objmodel.h"
+#include "runtime/types.h"
+
+namespace pyston {
+
+BoxedModule* gc_module;
+
+Box* gcCollect() {
+    threading::GLPromoteRegion _lock;
+
+    // Like CPython, return the number of unreachable objects this collection found.  That means we
+    // can't leave the sweep for later, and that what the previous collection left unswept doesn't count:
+    gc::global_heap.finishSweeping();
+    int64_t swept_before = gc::getNumObjectsSwept();
+    gc::runCollection();
+    gc::global_heap.finishSweeping();
+    return boxInt(gc::getNumObjectsSwept() - swept_before);
+}
+
+static i64 thresholdArg(Box* arg, const char* name, i64 min) {
+    if (!isSubclass(arg->cls, int_cls))
+        raiseExcHelper(TypeError, "set_threshold() %s must be an integer, not %s", name, getTypeName(arg)->c_str());
+
+    i64 n = static_cast<BoxedInt*>(arg)->n;
+    if (n < min)
+        raiseExcHelper(ValueError, "set_threshold() %s must be at least %ld", name, min);
+    return n;
+}
+
+// Unlike CPython's, our thresholds are the heap growth percentage, the minimum and maximum number of
+// bytes to allocate in between collections, and the pause time target in milliseconds (0 to disable).
+Box* gcSetThreshold(Box* growth_percent, Box* min_bytes, Box* max_bytes, Box* pause_target_ms) {
+    i64 growth = thresholdArg(growth_percent, "growth_percent", 1);
+    i64 min = min_bytes == None ? GC_MIN_ALLOC_BYTES : thresholdArg(min_bytes, "min_bytes", 1);
+    i64 max = max_bytes == None ? GC_MAX_ALLOC_BYTES : thresholdArg(max_bytes, "max_bytes", 1);
+    i64 pause = pause_target_ms == None ? GC_PAUSE_TARGET_MS : thresholdArg(pause_target_ms, "pause_target_ms", 0);
+
+    if (min > max)
+        raiseExcHelper(ValueError, "set_threshold() min_bytes must not be greater than max_bytes");
+
+    GC_HEAP_GROWTH_PERCENT = growth;
+    GC_MIN_ALLOC_BYTES = min;
+    GC_MAX_ALLOC_BYTES = max;
+    GC_PAUSE_TARGET_MS = pause;
+    gc::updateCollectionThreshold();
+
+    return None;
+}
+
+Box* gcGetThreshold() {
+    return new BoxedTuple({ boxInt(GC_HEAP_GROWTH_PERCENT), boxInt(GC_MIN_ALLOC_BYTES), boxInt(GC_MAX_ALLOC_BYTES),
+                            boxInt(GC_PAUSE_TARGET_MS) });
+}
+
+Box* gcGetStats() {
+    const gc::GCStats& stats = gc::getGCStats();
+
+    BoxedDict* rtn = new BoxedDict();
+    rtn->d[boxStrConstant("collections")] = boxInt(stats.ncollections);
+    rtn->d[boxStrConstant("minor_collections")] = boxInt(stats.nminor_collections);
+    rtn->d[boxStrConstant("live_bytes")] = boxInt(stats.live_bytes);
+    rtn->d[boxStrConstant("last_pause_us")] = boxInt(stats.last_pause_us);
+    rtn->d[boxStrConstant("max_pause_us")] = boxInt(stats.max_pause_us);
+    rtn->d[boxStrConstant("total_pause_us")] = boxInt(stats.total_pause_us);
+    rtn->d[boxStrConstant("bytes_since_collection")] = boxInt(stats.bytes_since_collection);
+    rtn->d[boxStrConstant("threshold_bytes")] = boxInt(stats.threshold_bytes);
+    return rtn;
+}
+
+Box* gcDumpHeapProfile(Box* filename) {
+    if (!GC_HEAP_PROFILE_SAMPLE_BYTES)
+        raiseExcHelper(RuntimeError, "heap profiling is not enabled (run with -H)");
+    if (filename->cls != str_cls)
+        raiseExcHelper(TypeError, "dump_heap_profile() filename must be a string, not %s",
+                       getTypeName(filename)->c_str());
+
+    // Collect first, so that the snapshot reflects what's live right now:
+    {
+        threading::GLPromoteRegion _lock;
+        gc::runCollection();
+    }
+
+    const std::string& fn = static_cast<BoxedString*>(filename)->s;
+    if (!gc::writeHeapProfile(fn.c_str()))
+        raiseExcHelper(IOError, "could not write heap profile to '%s'", fn.c_str());
+    return None;
+}
+
+void setupGC() {
+    gc_module = createModule("gc", "__builtin__");
+
+    gc_module->giveAttr("collect", new BoxedFunction(boxRTFunction((void*)gcCollect, BOXED_INT, 0)));
+    gc_module->giveAttr("set_threshold",
+                        new BoxedFunction(boxRTFunction((void*)gcSetThreshold, NONE, 4, 3, false, false),
+                                          { None, None, None }));
+    gc_module->giveAttr("get_threshold", new BoxedFunction(boxRTFunction((void*)gcGetThreshold, UNKNOWN, 0)));
+    gc_module->giveAttr("get_stats", new BoxedFunction(boxRTFunction((void*)gcGetStats, UNKNOWN, 0)));
+    gc_module->giveAttr("dump_heap_profile",
+                        new BoxedFunction(boxRTFunction((void*)gcDumpHeapProfile, NONE, 1)));
+}
+}
@@ -52,7 +52,6 @@ namespace pyston {
 // readelf -w test
 //
 
-#if RUNTIMEICS_OMIT_FRAME_PTR
 // clang++ test.cpp -o test -O3 -fomit-frame-pointer -c
 // The generated assembly is:
 //
@@ -64,7 +63,7 @@ namespace pyston {
 //
 //  (I believe the push/pop are for stack alignment)
 //
-static const char _eh_frame_template[] =
+static const char _eh_frame_template_omit_fp[] =
     // CIE
     "\x14\x00\x00\x00" // size of the CIE
     "\x00\x00\x00\x00" // specifies this is an CIE
@@ -92,7 +91,7 @@ static const char _eh_frame_template[] =
 
     "\x00\x00\x00\x00" // terminator
     ;
-#else
+
 // clang++ test.cpp -o test -O3 -fno-omit-frame-pointer -c
 // The generated assembly is:
 //
@@ -103,7 +102,7 @@ static const char _eh_frame_template[] =
 //  e:   5d                      pop    %rbp
 //  f:   c3                      retq
 //
-static const char _eh_frame_template[] =
+static const char _eh_frame_template_fp[] =
     // CIE
     "\x14\x00\x00\x00" // size of the CIE
     "\x00\x00\x00\x00" // specifies this is an CIE
@@ -135,11 +134,19 @@ static const char _eh_frame_template[] =
 
     "\x00\x00\x00\x00" // terminator
     ;
+
+#if RUNTIMEICS_OMIT_FRAME_PTR
+#define _eh_frame_template _eh_frame_template_omit_fp
+#else
+#define _eh_frame_template _eh_frame_template_fp
 #endif
 #define EH_FRAME_SIZE sizeof(_eh_frame_template)
 
-static void writeTrivialEhFrame(void* eh_frame_addr, void* func_addr, uint64_t func_size) {
-    memcpy(eh_frame_addr, _eh_frame_template, sizeof(_eh_frame_template));
+static_assert(sizeof(_eh_frame_template_fp) == FRAME_POINTER_EH_FRAME_SIZE, "");
+
+static void writeTrivialEhFrame(const char* eh_frame_template, size_t template_size, void* eh_frame_addr,
+                                void* func_addr, uint64_t func_size) {
+    memcpy(eh_frame_addr, eh_frame_template, template_size);
 
     int32_t* offset_ptr = (int32_t*)((uint8_t*)eh_frame_addr + 0x20);
     int32_t* size_ptr = (int32_t*)((uint8_t*)eh_frame_addr + 0x24);
@@ -152,6 +159,13 @@ static void writeTrivialEhFrame(void* eh_frame_addr, void* func_addr, uint64_t f
     *size_ptr = func_size;
 }
 
+int writeFramePointerEhFrame(void* eh_frame_addr, void* func_addr, uint64_t func_size) {
+    writeTrivialEhFrame(_eh_frame_template_fp, sizeof(_eh_frame_template_fp), eh_frame_addr, func_addr, func_size);
+
+    // The CIE and the FDE, leaving off the terminator and the string's implicit NUL:
+    return sizeof(_eh_frame_template_fp) - 5;
+}
+
 RuntimeIC::RuntimeIC(void* func_addr, int num_slots, int slot_size) {
     static StatCounter sc("runtime_ics_num");
     sc.log();
@@ -224,7 +238,7 @@ RuntimeIC::RuntimeIC(void* func_addr, int num_slots, int slot_size) {
         // TODO: ideally would be more intelligent about allocation strategies.
         // The code sections should be together and the eh sections together
         eh_frame_addr = malloc(EH_FRAME_SIZE);
-        writeTrivialEhFrame(eh_frame_addr, addr, total_size);
+        writeTrivialEhFrame(_eh_frame_template, EH_FRAME_SIZE, eh_frame_addr, addr, total_size);
         registerEHFrames((uint8_t*)eh_frame_addr, (uint64_t)eh_frame_addr, EH_FRAME_SIZE);
 
     } else {
@@ -22,6 +22,13 @@ namespace pyston {
 
 class ICInfo;
 
+// Writes out a minimal .eh_frame section for a function that starts with "push %rbp; mov %rsp, %rbp" and keeps
+// using RBP as its frame pointer after that, which is what it takes for exceptions to unwind through it.
+// eh_frame_addr needs FRAME_POINTER_EH_FRAME_SIZE bytes of space.  Returns the size of the section without the zero
+// terminator at the end, which __register_frame needs but libunwind doesn't want.
+static const int FRAME_POINTER_EH_FRAME_SIZE = 61;
+int writeFramePointerEhFrame(void* eh_frame_addr, void* func_addr, uint64_t func_size);
+
 class RuntimeIC {
 private:
     void* addr;
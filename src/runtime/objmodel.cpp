@@ -341,6 +341,57 @@ extern "C" Box** unpackIntoArray(Box* obj, int64_t expected_size) {
     return &elts[0];
 }
 
+// A cache of typeLookup() results, shared by all the lookups that happen without a rewrite: ICs that failed or went
+// megamorphic (see ICInfo), the interpreter, and the C API.  It's direct-mapped and indexed by the class's version tag
+// and the interned attribute name.  Changing a class's attributes clears its version tag (see BoxedClass::modified()),
+// and the next lookup that wants to use the cache gives it a new one.  Tags are never reused, so an entry can only go
+// stale through one of the class's bases changing.  To catch that, entries also record the sum of the bases' tags:
+// tp_base never changes and every new tag is bigger than all the old ones, so the sum goes up whenever any of the bases
+// gets modified.
+struct TypeLookupCacheEntry {
+    unsigned int version_tag;
+    InternedString attr;
+    uint64_t bases_version;
+    Box* val;
+};
+static const int TYPE_LOOKUP_CACHE_SIZE = 4096;
+static TypeLookupCacheEntry type_lookup_cache[TYPE_LOOKUP_CACHE_SIZE];
+// Tags start at 1, so that the zero-initialized entries never match.  If they ever run out, classes that get modified
+// after that never get a tag again, which means that lookups on them (and their subclasses) don't get cached.
+static unsigned int next_version_tag = 1;
+
+void BoxedClass::modified() {
+    // Classes tend to get modified many times in a row while they're being set up, so don't use up a tag until
+    // somebody actually looks something up:
+    tp_version_tag = 0;
+}
+
+// Returns false if the tags have run out.
+static bool assignVersionTag(BoxedClass* cls) {
+    if (cls->tp_version_tag)
+        return true;
+    if (!next_version_tag)
+        return false;
+    cls->tp_version_tag = next_version_tag++;
+    return true;
+}
+
+static void classModified(BoxedClass* cls) {
+    cls->modified();
+}
+
+// Returns false if one of the bases can't be cached.
+static bool getBasesVersion(BoxedClass* cls, uint64_t* version) {
+    uint64_t rtn = 0;
+    for (BoxedClass* base = cls->tp_base; base; base = base->tp_base) {
+        if (!assignVersionTag(base))
+            return false;
+        rtn += base->tp_version_tag;
+    }
+    *version = rtn;
+    return true;
+}
+
 void BoxedClass::freeze() {
     assert(!is_constant);
     assert(getattr("__name__")); // otherwise debugging will be very hard
@@ -348,6 +399,7 @@ void BoxedClass::freeze() {
     fixup_slot_dispatchers(this);
 
     is_constant = true;
+    modified();
 }
 
 BoxedClass::BoxedClass(BoxedClass* base, gcvisit_func gc_visit, int attrs_offset, int instance_size,
@@ -359,6 +411,8 @@ BoxedClass::BoxedClass(BoxedClass* base, gcvisit_func gc_visit, int attrs_offset
     memset(&tp_name, 0, (char*)(&tp_version_tag + 1) - (char*)(&tp_name));
     tp_basicsize = instance_size;
 
+    modified();
+
     tp_flags |= Py_TPFLAGS_HEAPTYPE;
     tp_flags |= Py_TPFLAGS_CHECKTYPES;
     tp_flags |= Py_TPFLAGS_BASETYPE;
@@ -462,43 +516,98 @@ extern "C" const std::string* getTypeName(Box* o) {
     return getNameOfClass(o->cls);
 }
 
-HiddenClass* HiddenClass::getOrMakeChild(const std::string& attr) {
-    std::unordered_map<std::string, HiddenClass*>::iterator it = children.find(attr);
+HiddenClass::HiddenClass(HiddenClass* parent, InternedString attr)
+    : type(NORMAL), parent(parent), attr(attr), nattrs(parent->nattrs + 1) {
+    assert(parent->type == NORMAL);
+    assert(parent->getOffset(attr) == -1);
+
+    if (parent->nattrs == parent->chain->names.size()) {
+        chain = parent->chain;
+    } else {
+        // Some other child of the parent already extended its chain, so this one has to start a copy of it:
+        static StatCounter num_chain_copies("num_hidden_class_chain_copies");
+        num_chain_copies.log();
+
+        chain = new AttrChain();
+        chain->names.assign(parent->chain->names.begin(), parent->chain->names.begin() + parent->nattrs);
+        for (int i = 0; i < parent->nattrs; i++)
+            chain->offsets[chain->names[i]] = i;
+    }
+
+    assert(chain->names.size() == nattrs - 1);
+    chain->names.push_back(attr);
+    chain->offsets[attr] = nattrs - 1;
+}
+
+HiddenClass* HiddenClass::getOrMakeChild(InternedString attr) {
+    assert(type == NORMAL);
+    assert(attr.isInterned());
+
+    auto it = children.find(attr);
     if (it != children.end())
         return it->second;
 
     static StatCounter num_hclses("num_hidden_classes");
     num_hclses.log();
 
-    HiddenClass* rtn = new HiddenClass(this);
+    HiddenClass* rtn = new HiddenClass(this, attr);
     this->children[attr] = rtn;
-    rtn->attr_offsets[attr] = attr_offsets.size();
     return rtn;
 }
 
 /**
  * del attr from current HiddenClass, pertain the orders of remaining attrs
  */
-HiddenClass* HiddenClass::delAttrToMakeHC(const std::string& attr) {
+HiddenClass* HiddenClass::delAttrToMakeHC(InternedString attr) {
     int idx = getOffset(attr);
     assert(idx >= 0);
 
-    std::vector<std::string> new_attrs(attr_offsets.size() - 1);
-    for (auto it = attr_offsets.begin(); it != attr_offsets.end(); ++it) {
-        if (it->second < idx)
-            new_attrs[it->second] = it->first;
-        else if (it->second > idx) {
-            new_attrs[it->second - 1] = it->first;
-        }
+    // The classes up to the one that added the attribute stay the same, so start from its parent and re-add the
+    // attributes that came after it:
+    HiddenClass* cur = this;
+    while (cur->nattrs > idx)
+        cur = cur->parent;
+    for (int i = idx + 1; i < nattrs; i++) {
+        cur = cur->getOrMakeChild(getAttrName(i));
     }
+    return cur;
+}
+
+// Modules and classes always keep their attributes in hidden classes, since the ICs for global and method lookups
+// depend on it:
+static bool canUseDictBackedAttrs(Box* b) {
+    return !isSubclass(b->cls, module_cls) && !isSubclass(b->cls, type_cls);
+}
+
+// Moves all of the object's attributes into a dict, and switches it to dict_backed_hcls.
+static BoxedDict* convertToDictBackedAttrs(Box* b) {
+    HCAttrs* attrs = b->getHCAttrsPtr();
+    HiddenClass* hcls = attrs->hcls;
+    assert(hcls->getType() == HiddenClass::NORMAL);
+
+    static StatCounter num_dict_backed("num_dict_backed_objects");
+    num_dict_backed.log();
 
-    // TODO we can first locate the parent HiddenClass of the deleted
-    // attribute and hence avoid creation of its ancestors.
-    HiddenClass* cur = root_hcls;
-    for (const auto& attr : new_attrs) {
-        cur = cur->getOrMakeChild(attr);
+    BoxedDict* d = new BoxedDict();
+    int numattrs = hcls->attributeArraySize();
+    for (int i = 0; i < numattrs; i++) {
+        d->d[boxString(hcls->getAttrName(i).str())] = attrs->attr_list->attrs[i];
     }
-    return cur;
+
+    // Keep the hcls and the attr_list consistent for the collector the whole time:
+    HCAttrs::AttrList* new_list
+        = (HCAttrs::AttrList*)gc_alloc(sizeof(HCAttrs::AttrList) + sizeof(Box*), gc::GCKind::UNTRACKED);
+    new_list->attrs[0] = d;
+    attrs->attr_list = new_list;
+    attrs->hcls = dict_backed_hcls;
+    return d;
+}
+
+BoxedDict* getDictBackedAttrs(HCAttrs* attrs) {
+    assert(attrs->hcls->getType() == HiddenClass::DICT_BACKED);
+    Box* d = attrs->attr_list->attrs[0];
+    assert(d->cls == dict_cls);
+    return static_cast<BoxedDict*>(d);
 }
 
 HCAttrs* Box::getHCAttrsPtr() {
@@ -525,7 +634,7 @@ BoxedDict* Box::getDict() {
     return d;
 }
 
-Box* Box::getattr(const std::string& attr, GetattrRewriteArgs* rewrite_args) {
+Box* Box::getattr(InternedString attr, GetattrRewriteArgs* rewrite_args) {
     if (rewrite_args)
         rewrite_args->obj->addAttrGuard(BOX_CLS_OFFSET, (intptr_t)cls);
 
@@ -539,12 +648,23 @@ Box* Box::getattr(const std::string& attr, GetattrRewriteArgs* rewrite_args) {
     // structure (ex user class) and the same hidden classes, because
     // otherwise the guard will fail anyway.;
     if (cls->instancesHaveHCAttrs()) {
-        if (rewrite_args)
-            rewrite_args->out_success = true;
-
         HCAttrs* attrs = getHCAttrsPtr();
         HiddenClass* hcls = attrs->hcls;
 
+        if (unlikely(hcls->getType() == HiddenClass::DICT_BACKED)) {
+            if (rewrite_args)
+                REWRITE_ABORTED("");
+
+            BoxedDict* d = getDictBackedAttrs(attrs);
+            auto it = d->d.find(boxString(attr.str()));
+            if (it == d->d.end())
+                return NULL;
+            return it->second;
+        }
+
+        if (rewrite_args)
+            rewrite_args->out_success = true;
+
         if (rewrite_args) {
             if (!rewrite_args->obj_hcls_guarded)
                 rewrite_args->obj->addAttrGuard(cls->attrs_offset + HCATTRS_HCLS_OFFSET, (intptr_t)hcls);
@@ -573,7 +693,7 @@ Box* Box::getattr(const std::string& attr, GetattrRewriteArgs* rewrite_args) {
 
         BoxedDict* d = getDict();
 
-        Box* key = boxString(attr);
+        Box* key = boxString(attr.str());
         auto it = d->d.find(key);
         if (it == d->d.end())
             return NULL;
@@ -586,8 +706,31 @@ Box* Box::getattr(const std::string& attr, GetattrRewriteArgs* rewrite_args) {
     return NULL;
 }
 
-void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite_args) {
+void Box::setattr(InternedString attr, Box* val, SetattrRewriteArgs* rewrite_args) {
     assert(gc::isValidGCObject(val));
+    assert(attr.isInterned());
+
+    if (unlikely(isSubclass(cls, type_cls))) {
+        // Any change to a class's attributes has to give it a new version tag.  ICs do that too, see setattrInternal:
+        static_cast<BoxedClass*>(this)->modified();
+    }
+
+    GlobalCell* global_cell = NULL;
+    if (unlikely(isSubclass(cls, module_cls))) {
+        global_cell = static_cast<BoxedModule*>(this)->getGlobalCell(attr);
+        if (!global_cell->value) {
+            // A new global shadows any builtin of the same name, so the ICs that read the builtin have to go.  ICs
+            // that add attributes can't do that, so don't make one.
+            if (rewrite_args)
+                REWRITE_ABORTED("");
+            rewrite_args = NULL;
+            global_cell->dependent_builtin_reads.invalidateAll();
+        } else if (rewrite_args) {
+            // The IC will write to this particular module's cell:
+            rewrite_args->obj->addGuard((intptr_t)this);
+        }
+        global_cell->value = val;
+    }
 
     // Have to guard on the memory layout of this object.
     // Right now, guard on the specific Python-class, which in turn
@@ -601,14 +744,23 @@ void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite
     if (rewrite_args)
         rewrite_args->obj->addAttrGuard(BOX_CLS_OFFSET, (intptr_t)cls);
 
-    static const std::string none_str("None");
+    static const InternedString none_str = InternedString::get("None");
 
     RELEASE_ASSERT(attr != none_str || this == builtins_module, "can't assign to None");
 
     if (cls->instancesHaveHCAttrs()) {
         HCAttrs* attrs = getHCAttrsPtr();
         HiddenClass* hcls = attrs->hcls;
-        int numattrs = hcls->attr_offsets.size();
+
+        if (unlikely(hcls->getType() == HiddenClass::DICT_BACKED)) {
+            if (rewrite_args)
+                REWRITE_ABORTED("");
+
+            getDictBackedAttrs(attrs)->d[boxString(attr.str())] = val;
+            return;
+        }
+
+        int numattrs = hcls->attributeArraySize();
 
         int offset = hcls->getOffset(attr);
 
@@ -629,6 +781,11 @@ void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite
 
                 r_hattrs->setAttr(offset * sizeof(Box*) + ATTRLIST_ATTRS_OFFSET, rewrite_args->attrval);
 
+                if (global_cell) {
+                    RewriterVar* r_cell = rewrite_args->rewriter->loadConst((intptr_t)global_cell, Location::any());
+                    r_cell->setAttr(offsetof(GlobalCell, value), rewrite_args->attrval);
+                }
+
                 rewrite_args->out_success = true;
             }
 
@@ -636,13 +793,23 @@ void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite
         }
 
         assert(offset == -1);
+
+        if (numattrs >= HiddenClass::MAX_ATTRS && canUseDictBackedAttrs(this)) {
+            if (rewrite_args)
+                REWRITE_ABORTED("");
+
+            BoxedDict* d = convertToDictBackedAttrs(this);
+            d->d[boxString(attr.str())] = val;
+            return;
+        }
+
         HiddenClass* new_hcls = hcls->getOrMakeChild(attr);
 
         // TODO need to make sure we don't need to rearrange the attributes
-        assert(new_hcls->attr_offsets[attr] == numattrs);
+        assert(new_hcls->getOffset(attr) == numattrs);
 #ifndef NDEBUG
-        for (const auto& p : hcls->attr_offsets) {
-            assert(new_hcls->attr_offsets[p.first] == p.second);
+        for (int i = 0; i < numattrs; i++) {
+            assert(new_hcls->getAttrName(i) == hcls->getAttrName(i));
         }
 #endif
 
@@ -685,7 +852,7 @@ void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite
 
     if (cls->instancesHaveDictAttrs()) {
         BoxedDict* d = getDict();
-        d->d[boxString(attr)] = val;
+        d->d[boxString(attr.str())] = val;
         return;
     }
 
@@ -693,7 +860,7 @@ void Box::setattr(const std::string& attr, Box* val, SetattrRewriteArgs* rewrite
     abort();
 }
 
-Box* typeLookup(BoxedClass* cls, const std::string& attr, GetattrRewriteArgs* rewrite_args) {
+Box* typeLookup(BoxedClass* cls, InternedString attr, GetattrRewriteArgs* rewrite_args) {
     Box* val;
 
     if (rewrite_args) {
@@ -710,9 +877,34 @@ Box* typeLookup(BoxedClass* cls, const std::string& attr, GetattrRewriteArgs* re
         }
         return val;
     } else {
+        static StatCounter cache_hits("type_lookup_cache_hits");
+        static StatCounter cache_misses("type_lookup_cache_misses");
+
+        TypeLookupCacheEntry* entry = NULL;
+        uint64_t bases_version;
+        // Names that aren't interned only live as long as the lookup, so they can't go in the cache:
+        if (attr.isInterned() && assignVersionTag(cls) && getBasesVersion(cls, &bases_version)) {
+            size_t hash = (cls->tp_version_tag * 0x9e3779b1u) ^ ((uintptr_t)attr.getPtr() >> 3);
+            entry = &type_lookup_cache[hash & (TYPE_LOOKUP_CACHE_SIZE - 1)];
+            if (entry->version_tag == cls->tp_version_tag && entry->attr == attr
+                && entry->bases_version == bases_version) {
+                cache_hits.log();
+                return entry->val;
+            }
+            cache_misses.log();
+        }
+
         val = cls->getattr(attr, NULL);
         if (!val and cls->tp_base)
-            return typeLookup(cls->tp_base, attr, NULL);
+            val = typeLookup(cls->tp_base, attr, NULL);
+
+        if (entry) {
+            // The cache doesn't keep the value alive, but the class does for as long as the entry is valid:
+            entry->version_tag = cls->tp_version_tag;
+            entry->attr = attr;
+            entry->bases_version = bases_version;
+            entry->val = val;
+        }
         return val;
     }
 }
@@ -1097,8 +1289,12 @@ static Box* (*runtimeCall2)(Box*, ArgPassSpec, Box*, Box*) = (Box * (*)(Box*, Ar
 static Box* (*runtimeCall3)(Box*, ArgPassSpec, Box*, Box*, Box*)
     = (Box * (*)(Box*, ArgPassSpec, Box*, Box*, Box*))runtimeCall;
 
-Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArgs* rewrite_args, bool cls_only,
+Box* getattrInternalGeneral(Box* obj, InternedString attr, GetattrRewriteArgs* rewrite_args, bool cls_only,
                             bool for_call, Box** bind_obj_out, RewriterVar** r_bind_obj_out) {
+    static const InternedString getattribute_str = InternedString::get(_getattribute_str);
+    static const InternedString get_str = InternedString::get(_get_str);
+    static const InternedString set_str = InternedString::get("__set__");
+
     if (for_call) {
         *bind_obj_out = NULL;
     }
@@ -1141,10 +1337,10 @@ Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArg
         // Don't need to pass icentry args, since we special-case __getattribtue__ and __getattr__ to use
         // invalidation rather than guards
         // TODO since you changed this to typeLookup you need to guard
-        Box* getattribute = typeLookup(obj->cls, "__getattribute__", NULL);
+        Box* getattribute = typeLookup(obj->cls, getattribute_str, NULL);
         if (getattribute) {
             // TODO this is a good candidate for interning?
-            Box* boxstr = boxString(attr);
+            Box* boxstr = boxString(attr.str());
             Box* rtn = runtimeCall2(getattribute, ArgPassSpec(2), obj, boxstr);
             return rtn;
         }
@@ -1194,7 +1390,7 @@ Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArg
             r_descr->addAttrGuard(BOX_CLS_OFFSET, (uint64_t)descr->cls);
 
         // Special-case data descriptors (e.g., member descriptors)
-        Box* res = dataDescriptorInstanceSpecialCases(rewrite_args, attr, obj, descr, r_descr, for_call, bind_obj_out,
+        Box* res = dataDescriptorInstanceSpecialCases(rewrite_args, attr.str(), obj, descr, r_descr, for_call, bind_obj_out,
                                                       r_bind_obj_out);
         if (res) {
             return res;
@@ -1209,14 +1405,14 @@ Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArg
             if (rewrite_args) {
                 RewriterVar* r_descr_cls = r_descr->getAttr(BOX_CLS_OFFSET, Location::any());
                 GetattrRewriteArgs grewrite_args(rewrite_args->rewriter, r_descr_cls, Location::any());
-                _get_ = typeLookup(descr->cls, _get_str, &grewrite_args);
+                _get_ = typeLookup(descr->cls, get_str, &grewrite_args);
                 if (!grewrite_args.out_success) {
                     rewrite_args = NULL;
                 } else if (_get_) {
                     r_get = grewrite_args.out_rtn;
                 }
             } else {
-                _get_ = typeLookup(descr->cls, _get_str, NULL);
+                _get_ = typeLookup(descr->cls, get_str, NULL);
             }
 
             // As an optimization, don't check for __set__ if we're in cls_only mode, since it won't matter.
@@ -1226,12 +1422,12 @@ Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArg
                 if (rewrite_args) {
                     RewriterVar* r_descr_cls = r_descr->getAttr(BOX_CLS_OFFSET, Location::any());
                     GetattrRewriteArgs grewrite_args(rewrite_args->rewriter, r_descr_cls, Location::any());
-                    _set_ = typeLookup(descr->cls, "__set__", &grewrite_args);
+                    _set_ = typeLookup(descr->cls, set_str, &grewrite_args);
                     if (!grewrite_args.out_success) {
                         rewrite_args = NULL;
                     }
                 } else {
-                    _set_ = typeLookup(descr->cls, "__set__", NULL);
+                    _set_ = typeLookup(descr->cls, set_str, NULL);
                 }
 
                 // Call __get__(descr, obj, obj->cls)
@@ -1327,14 +1523,14 @@ Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArg
                 if (rewrite_args) {
                     RewriterVar* r_val_cls = r_val->getAttr(BOX_CLS_OFFSET, Location::any());
                     GetattrRewriteArgs grewrite_args(rewrite_args->rewriter, r_val_cls, Location::any());
-                    local_get = typeLookup(val->cls, _get_str, &grewrite_args);
+                    local_get = typeLookup(val->cls, get_str, &grewrite_args);
                     if (!grewrite_args.out_success) {
                         rewrite_args = NULL;
                     } else if (local_get) {
                         r_get = grewrite_args.out_rtn;
                     }
                 } else {
-                    local_get = typeLookup(val->cls, _get_str, NULL);
+                    local_get = typeLookup(val->cls, get_str, NULL);
                 }
 
                 // Call __get__(val, None, obj)
@@ -1429,7 +1625,7 @@ Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArg
         REWRITE_ABORTED("");
         Box* getattr = typeLookup(obj->cls, "__getattr__", NULL);
         if (getattr) {
-            Box* boxstr = boxString(attr);
+            Box* boxstr = boxString(attr.str());
             Box* rtn = runtimeCall2(getattr, ArgPassSpec(2), obj, boxstr);
             return rtn;
         }
@@ -1445,20 +1641,21 @@ Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArg
     return NULL;
 }
 
-Box* getattrInternal(Box* obj, const std::string& attr, GetattrRewriteArgs* rewrite_args) {
+Box* getattrInternal(Box* obj, InternedString attr, GetattrRewriteArgs* rewrite_args) {
     return getattrInternalGeneral(obj, attr, rewrite_args,
                                   /* cls_only */ false,
                                   /* for_call */ false, NULL, NULL);
 }
 
-extern "C" Box* getattr(Box* obj, const char* attr) {
+// return_addr is the IC's return address, or NULL if the lookup shouldn't get patched into anything.
+static Box* getattrSlowpath(Box* obj, InternedString attr, void* return_addr) {
     static StatCounter slowpath_getattr("slowpath_getattr");
     slowpath_getattr.log();
 
-    bool is_dunder = (attr[0] == '_' && attr[1] == '_');
+    bool is_dunder = (attr.str()[0] == '_' && attr.str()[1] == '_');
 
     if (is_dunder) {
-        if (strcmp(attr, "__dict__") == 0) {
+        if (attr.str() == "__dict__") {
             // TODO this is wrong, should be added at the class level as a getset
             if (obj->cls->instancesHaveHCAttrs())
                 return makeAttrWrapper(obj);
@@ -1467,14 +1664,13 @@ extern "C" Box* getattr(Box* obj, const char* attr) {
 
     if (VERBOSITY() >= 2) {
 #if !DISABLE_STATS
-        std::string per_name_stat_name = "getattr__" + std::string(attr);
+        std::string per_name_stat_name = "getattr__" + attr.str();
         int id = Stats::getStatId(per_name_stat_name);
         Stats::log(id);
 #endif
     }
 
-    std::unique_ptr<Rewriter> rewriter(
-        Rewriter::createRewriter(__builtin_extract_return_addr(__builtin_return_address(0)), 2, "getattr"));
+    std::unique_ptr<Rewriter> rewriter(return_addr ? Rewriter::createRewriter(return_addr, 2, "getattr") : NULL);
 
     Box* val;
     if (rewriter.get()) {
@@ -1512,13 +1708,13 @@ extern "C" Box* getattr(Box* obj, const char* attr) {
 
     if (is_dunder) {
         // There's more to it than this:
-        if (strcmp(attr, "__class__") == 0) {
+        if (attr.str() == "__class__") {
             assert(obj->cls != instance_cls); // I think in this case __class__ is supposed to be the classobj?
             return obj->cls;
         }
 
         // This doesn't belong here either:
-        if (strcmp(attr, "__bases__") == 0 && isSubclass(obj->cls, type_cls)) {
+        if (attr.str() == "__bases__" && isSubclass(obj->cls, type_cls)) {
             BoxedClass* cls = static_cast<BoxedClass*>(obj);
             if (cls->tp_base)
                 return new BoxedTuple({ static_cast<BoxedClass*>(obj)->tp_base });
@@ -1526,10 +1722,21 @@ extern "C" Box* getattr(Box* obj, const char* attr) {
         }
     }
 
-    raiseAttributeError(obj, attr);
+    raiseAttributeError(obj, attr.c_str());
 }
 
-void setattrInternal(Box* obj, const std::string& attr, Box* val, SetattrRewriteArgs* rewrite_args) {
+extern "C" Box* getattr(Box* obj, const char* attr) {
+    // Only look the name up: if it has never been interned, no object can have it in its hidden class.
+    std::string attr_str(attr);
+    return getattrSlowpath(obj, InternedString::lookup(attr_str),
+                           __builtin_extract_return_addr(__builtin_return_address(0)));
+}
+
+Box* getattr(Box* obj, InternedString attr) {
+    return getattrSlowpath(obj, attr, NULL);
+}
+
+void setattrInternal(Box* obj, InternedString attr, Box* val, SetattrRewriteArgs* rewrite_args) {
     assert(gc::isValidGCObject(val));
 
     // Lookup a descriptor
@@ -1586,15 +1793,22 @@ void setattrInternal(Box* obj, const std::string& attr, Box* val, SetattrRewrite
         }
     } else {
         obj->setattr(attr, val, rewrite_args);
+
+        // Box::setattr gave the class a new version tag; the IC has to as well.  This is a call, so it has to come
+        // after all of the guards that setattr added:
+        if (rewrite_args && rewrite_args->out_success && isSubclass(obj->cls, type_cls))
+            rewrite_args->rewriter->call(false, (void*)classModified, rewrite_args->obj);
     }
 
     if (isSubclass(obj->cls, type_cls)) {
         BoxedClass* self = static_cast<BoxedClass*>(obj);
 
-        if (attr == _getattr_str || attr == _getattribute_str) {
-            if (rewrite_args)
-                REWRITE_ABORTED("");
+        if (attr.str() == _getattr_str || attr.str() == _getattribute_str) {
             // Will have to embed the clear in the IC, so just disable the patching for now:
+            if (rewrite_args) {
+                REWRITE_ABORTED("");
+                rewrite_args->out_success = false;
+            }
             rewrite_args = NULL;
 
             // TODO should put this clearing behavior somewhere else, since there are probably more
@@ -1602,13 +1816,17 @@ void setattrInternal(Box* obj, const std::string& attr, Box* val, SetattrRewrite
             self->dependent_icgetattrs.invalidateAll();
         }
 
-        if (attr == "__base__" && self->getattr("__base__"))
+        if (attr.str() == "__base__" && self->getattr("__base__"))
             raiseExcHelper(TypeError, "readonly attribute");
 
-        bool touched_slot = update_slot(self, attr);
+        bool touched_slot = update_slot(self, attr.str());
         if (touched_slot) {
+            // The slots only get updated here, not in the IC:
+            if (rewrite_args) {
+                REWRITE_ABORTED("");
+                rewrite_args->out_success = false;
+            }
             rewrite_args = NULL;
-            REWRITE_ABORTED("");
         }
     }
 }
@@ -2211,14 +2429,52 @@ static inline Box*& getArg(int idx, Box*& arg1, Box*& arg2, Box*& arg3, Box** ar
     return args[idx - 3];
 }
 
+static bool isGenericVersion(CompiledFunction* cf) {
+    for (ConcreteCompilerType* t : cf->spec->arg_types) {
+        if (t != UNKNOWN)
+            return false;
+    }
+    return true;
+}
+
 static CompiledFunction* pickVersion(CLFunction* f, int num_output_args, Box* oarg1, Box* oarg2, Box* oarg3,
                                      Box** oargs) {
     LOCK_REGION(codegen_rwlock.asWrite());
 
+    static StatCounter sc_cache_hits("pickversion_cache_hits");
+    static StatCounter sc_cache_misses("pickversion_cache_misses");
+
+    // The choice of version only depends on the classes of the arguments (as long as none of them
+    // are NULL, which only builtin functions can pass), so remember it:
+    static std::vector<BoxedClass*> arg_classes;
+    arg_classes.clear();
+    for (int i = 0; i < num_output_args; i++) {
+        Box* arg = getArg(i, oarg1, oarg2, oarg3, oargs);
+        if (!arg) {
+            arg_classes.clear();
+            break;
+        }
+        arg_classes.push_back(arg->cls);
+    }
+    bool cacheable = (arg_classes.size() == num_output_args);
+
+    if (cacheable) {
+        auto it = f->version_cache.find(arg_classes);
+        if (it != f->version_cache.end()) {
+            sc_cache_hits.log();
+            return it->second;
+        }
+        sc_cache_misses.log();
+    }
+
     CompiledFunction* chosen_cf = NULL;
+    int num_specialized = 0;
     for (CompiledFunction* cf : f->versions) {
         assert(cf->spec->arg_types.size() == num_output_args);
 
+        if (!isGenericVersion(cf))
+            num_specialized++;
+
         if (cf->spec->rtn_type->llvmType() != UNKNOWN->llvmType())
             continue;
 
@@ -2247,19 +2503,49 @@ static CompiledFunction* pickVersion(CLFunction* f, int num_output_args, Box* oa
             abort();
         }
 
+        // Once a function has been called with enough different argument types, it's probably going to keep
+        // getting new ones; stop specializing and compile a version that works for everything, rather than
+        // compiling (and then scanning past) a new version for each combination.
+        bool generic = (num_specialized >= MAX_FUNCTION_VERSIONS);
+
         std::vector<ConcreteCompilerType*> arg_types;
         for (int i = 0; i < num_output_args; i++) {
             Box* arg = getArg(i, oarg1, oarg2, oarg3, oargs);
             assert(arg); // only builtin functions can pass NULL args
 
-            arg_types.push_back(typeFromClass(arg->cls));
+            arg_types.push_back(generic ? UNKNOWN : typeFromClass(arg->cls));
         }
         FunctionSpecialization* spec = new FunctionSpecialization(UNKNOWN, arg_types);
 
         EffortLevel::EffortLevel new_effort = initialEffort();
 
+        // Compiling can let other threads run (see LLVMLockRegion), and they might use arg_classes too:
+        std::vector<BoxedClass*> key;
+        key.swap(arg_classes);
         // this also pushes the new CompiledVersion to the back of the version list:
         chosen_cf = compileFunction(f, spec, new_effort, NULL);
+        key.swap(arg_classes);
+
+        if (generic) {
+            static StatCounter sc_generic("num_generic_versions");
+            sc_generic.log();
+        } else {
+            // Keep track of how many functions end up with how many versions:
+            static std::vector<StatCounter*> sc_versions;
+            int nversions = num_specialized + 1;
+            if (sc_versions.size() <= (size_t)nversions)
+                sc_versions.resize(nversions + 1, NULL);
+            if (!sc_versions[nversions])
+                sc_versions[nversions]
+                    = new StatCounter("num_functions_with_" + std::to_string(nversions) + "_versions");
+            sc_versions[nversions]->log();
+        }
+    }
+
+    if (cacheable) {
+        if (f->version_cache.size() >= CLFunction::MAX_VERSION_CACHE_ENTRIES)
+            f->version_cache.clear();
+        f->version_cache[arg_classes] = chosen_cf;
     }
 
     return chosen_cf;
@@ -3289,17 +3575,34 @@ extern "C" void delitem(Box* target, Box* slice) {
     }
 }
 
-void Box::delattr(const std::string& attr, DelattrRewriteArgs* rewrite_args) {
+void Box::delattr(InternedString attr, DelattrRewriteArgs* rewrite_args) {
+    if (isSubclass(cls, type_cls))
+        static_cast<BoxedClass*>(this)->modified();
+    // A name that isn't interned never got a cell:
+    if (isSubclass(cls, module_cls) && attr.isInterned())
+        static_cast<BoxedModule*>(this)->getGlobalCell(attr)->value = NULL;
+
     if (cls->instancesHaveHCAttrs()) {
         // as soon as the hcls changes, the guard on hidden class won't pass.
         HCAttrs* attrs = getHCAttrsPtr();
         HiddenClass* hcls = attrs->hcls;
+
+        if (hcls->getType() == HiddenClass::NORMAL && canUseDictBackedAttrs(this)) {
+            convertToDictBackedAttrs(this);
+            hcls = attrs->hcls;
+        }
+
+        if (hcls->getType() == HiddenClass::DICT_BACKED) {
+            getDictBackedAttrs(attrs)->d.erase(boxString(attr.str()));
+            return;
+        }
+
         HiddenClass* new_hcls = hcls->delAttrToMakeHC(attr);
 
         // The order of attributes is pertained as delAttrToMakeHC constructs
         // the new HiddenClass by invoking getOrMakeChild in the prevous order
         // of remaining attributes
-        int num_attrs = hcls->attr_offsets.size();
+        int num_attrs = hcls->attributeArraySize();
         int offset = hcls->getOffset(attr);
         assert(offset >= 0);
         Box** start = attrs->attr_list->attrs;
@@ -3322,8 +3625,8 @@ void Box::delattr(const std::string& attr, DelattrRewriteArgs* rewrite_args) {
 
 extern "C" void delattr_internal(Box* obj, const std::string& attr, bool allow_custom,
                                  DelattrRewriteArgs* rewrite_args) {
-    static const std::string delattr_str("__delattr__");
-    static const std::string delete_str("__delete__");
+    static const InternedString delattr_str = InternedString::get("__delattr__");
+    static const InternedString delete_str = InternedString::get("__delete__");
 
     // custom __delattr__
     if (allow_custom) {
@@ -3335,8 +3638,10 @@ extern "C" void delattr_internal(Box* obj, const std::string& attr, bool allow_c
         }
     }
 
+    InternedString interned_attr = InternedString::lookup(attr);
+
     // first check whether the deleting attribute is a descriptor
-    Box* clsAttr = typeLookup(obj->cls, attr, NULL);
+    Box* clsAttr = typeLookup(obj->cls, interned_attr, NULL);
     if (clsAttr != NULL) {
         Box* delAttr = typeLookup(static_cast<BoxedClass*>(clsAttr->cls), delete_str, NULL);
 
@@ -3348,9 +3653,9 @@ extern "C" void delattr_internal(Box* obj, const std::string& attr, bool allow_c
     }
 
     // check if the attribute is in the instance's __dict__
-    Box* attrVal = obj->getattr(attr, NULL);
+    Box* attrVal = obj->getattr(interned_attr, NULL);
     if (attrVal != NULL) {
-        obj->delattr(attr, NULL);
+        obj->delattr(interned_attr, NULL);
     } else {
         // the exception cpthon throws is different when the class contains the attribute
         if (clsAttr != NULL) {
@@ -3804,7 +4109,7 @@ extern "C" void delGlobal(BoxedModule* m, std::string* name) {
     m->delattr(*name, NULL);
 }
 
-extern "C" Box* getGlobal(BoxedModule* m, std::string* name) {
+extern "C" Box* getGlobal(BoxedModule* m, const std::string* name) {
     static StatCounter slowpath_getglobal("slowpath_getglobal");
     slowpath_getglobal.log();
     static StatCounter nopatch_getglobal("nopatch_getglobal");
@@ -3817,31 +4122,27 @@ extern "C" Box* getGlobal(BoxedModule* m, std::string* name) {
 #endif
     }
 
+    InternedString interned_name = InternedString::fromInternedPtr(name);
+
     { /* anonymous scope to make sure destructors get run before we err out */
         std::unique_ptr<Rewriter> rewriter(
             Rewriter::createRewriter(__builtin_extract_return_addr(__builtin_return_address(0)), 3, "getGlobal"));
-
-        Box* r;
-        if (rewriter.get()) {
-            // rewriter->trap();
-
-            GetattrRewriteArgs rewrite_args(rewriter.get(), rewriter->getArg(0), rewriter->getReturnDestination());
-            r = m->getattr(*name, &rewrite_args);
-            if (!rewrite_args.out_success) {
-                rewriter.reset(NULL);
-            }
-            if (r) {
-                if (rewriter.get()) {
-                    rewriter->commitReturning(rewrite_args.out_rtn);
-                }
-                return r;
-            }
-        } else {
-            r = m->getattr(*name, NULL);
+        if (!rewriter.get())
             nopatch_getglobal.log();
-            if (r) {
-                return r;
+
+        // The ICs read the globals straight out of their cells, so they don't depend on the module's hidden class,
+        // and storing to other globals doesn't affect them.  They only need a guard that the value is there, which
+        // fails if the global gets deleted.
+        GlobalCell* cell = m->getGlobalCell(interned_name);
+        if (cell->value) {
+            if (rewriter.get()) {
+                rewriter->getArg(0)->addGuard((intptr_t)m);
+                RewriterVar* r_cell = rewriter->loadConst((intptr_t)cell, Location::any());
+                RewriterVar* r_rtn = r_cell->getAttr(offsetof(GlobalCell, value), rewriter->getReturnDestination());
+                r_rtn->addGuardNotEq(0);
+                rewriter->commitReturning(r_rtn);
             }
+            return cell->value;
         }
 
         static StatCounter stat_builtins("getglobal_builtins");
@@ -3849,31 +4150,28 @@ extern "C" Box* getGlobal(BoxedModule* m, std::string* name) {
 
         if ((*name) == "__builtins__") {
             if (rewriter.get()) {
+                rewriter->getArg(0)->addGuard((intptr_t)m);
+                rewriter->addDependenceOn(cell->dependent_builtin_reads);
                 RewriterVar* r_rtn = rewriter->loadConst((intptr_t)builtins_module, rewriter->getReturnDestination());
                 rewriter->commitReturning(r_rtn);
             }
             return builtins_module;
         }
 
-        Box* rtn;
-        if (rewriter.get()) {
-            RewriterVar* builtins = rewriter->loadConst((intptr_t)builtins_module, Location::any());
-            GetattrRewriteArgs rewrite_args(rewriter.get(), builtins, rewriter->getReturnDestination());
-            rtn = builtins_module->getattr(*name, &rewrite_args);
-
-            if (!rtn || !rewrite_args.out_success) {
-                rewriter.reset(NULL);
-            }
-
+        // Reading a builtin only stays valid for as long as the module doesn't have a global of the same name,
+        // which is what dependent_builtin_reads tracks:
+        GlobalCell* builtin_cell = builtins_module->getGlobalCell(interned_name);
+        if (builtin_cell->value) {
             if (rewriter.get()) {
-                rewriter->commitReturning(rewrite_args.out_rtn);
+                rewriter->getArg(0)->addGuard((intptr_t)m);
+                rewriter->addDependenceOn(cell->dependent_builtin_reads);
+                RewriterVar* r_cell = rewriter->loadConst((intptr_t)builtin_cell, Location::any());
+                RewriterVar* r_rtn = r_cell->getAttr(offsetof(GlobalCell, value), rewriter->getReturnDestination());
+                r_rtn->addGuardNotEq(0);
+                rewriter->commitReturning(r_rtn);
             }
-        } else {
-            rtn = builtins_module->getattr(*name, NULL);
+            return builtin_cell->value;
         }
-
-        if (rtn)
-            return rtn;
     }
 
     raiseExcHelper(NameError, "global name '%s' is not defined", name->c_str());
@@ -3931,11 +4229,12 @@ extern "C" Box* importStar(Box* _from_module, BoxedModule* to_module) {
     }
 
     HCAttrs* module_attrs = from_module->getHCAttrsPtr();
-    for (auto& p : module_attrs->hcls->attr_offsets) {
-        if (p.first[0] == '_')
+    for (int i = 0; i < module_attrs->hcls->attributeArraySize(); i++) {
+        InternedString name = module_attrs->hcls->getAttrName(i);
+        if (name.str()[0] == '_')
             continue;
 
-        to_module->setattr(p.first, module_attrs->attr_list->attrs[p.second], NULL);
+        to_module->setattr(name, module_attrs->attr_list->attrs[i], NULL);
     }
 
     return None;
@@ -25,6 +25,7 @@ namespace pyston {
 
 class Box;
 class BoxedClass;
+class BoxedDict;
 class BoxedInt;
 class BoxedList;
 class BoxedString;
@@ -45,6 +46,8 @@ BoxedModule* getCurrentModule();
 extern "C" bool softspace(Box* b, bool newval);
 extern "C" void my_assert(bool b);
 extern "C" Box* getattr(Box* obj, const char* attr);
+// The same, for callers that already have the name interned, like the interpreter; this never makes an IC.
+Box* getattr(Box* obj, InternedString attr);
 extern "C" void setattr(Box* obj, const char* attr, Box* attr_val);
 extern "C" void delattr(Box* obj, const char* attr);
 extern "C" bool nonzero(Box* obj);
@@ -70,7 +73,8 @@ extern "C" BoxedInt* len(Box* obj);
 extern "C" i64 unboxedLen(Box* obj);
 extern "C" Box* binop(Box* lhs, Box* rhs, int op_type);
 extern "C" Box* augbinop(Box* lhs, Box* rhs, int op_type);
-extern "C" Box* getGlobal(BoxedModule* m, std::string* name);
+// name has to be interned (see InternedString::getPtr()); the JIT'd code passes the AST_Name's interned id.
+extern "C" Box* getGlobal(BoxedModule* m, const std::string* name);
 extern "C" void delGlobal(BoxedModule* m, std::string* name);
 extern "C" Box* getitem(Box* value, Box* slice);
 extern "C" void setitem(Box* target, Box* slice, Box* value);
@@ -92,7 +96,10 @@ extern "C" Box* getPystonIter(Box* o);
 extern "C" void dump(void* p);
 
 struct SetattrRewriteArgs;
-void setattrInternal(Box* obj, const std::string& attr, Box* val, SetattrRewriteArgs* rewrite_args);
+void setattrInternal(Box* obj, InternedString attr, Box* val, SetattrRewriteArgs* rewrite_args);
+inline void setattrInternal(Box* obj, const std::string& attr, Box* val, SetattrRewriteArgs* rewrite_args) {
+    setattrInternal(obj, InternedString::get(attr), val, rewrite_args);
+}
 
 struct BinopRewriteArgs;
 extern "C" Box* binopInternal(Box* lhs, Box* rhs, int op_type, bool inplace, BinopRewriteArgs* rewrite_args);
@@ -113,11 +120,27 @@ extern "C" void delattr_internal(Box* obj, const std::string& attr, bool allow_c
                                  DelattrRewriteArgs* rewrite_args);
 struct CompareRewriteArgs;
 Box* compareInternal(Box* lhs, Box* rhs, int op_type, CompareRewriteArgs* rewrite_args);
-Box* getattrInternal(Box* obj, const std::string& attr, GetattrRewriteArgs* rewrite_args);
-Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArgs* rewrite_args, bool cls_only,
+// These take the attribute name interned; the std::string versions look it up in the intern table first, without
+// adding it (see InternedString::lookup()).
+Box* getattrInternal(Box* obj, InternedString attr, GetattrRewriteArgs* rewrite_args);
+inline Box* getattrInternal(Box* obj, const std::string& attr, GetattrRewriteArgs* rewrite_args) {
+    return getattrInternal(obj, InternedString::lookup(attr), rewrite_args);
+}
+Box* getattrInternalGeneral(Box* obj, InternedString attr, GetattrRewriteArgs* rewrite_args, bool cls_only,
                             bool for_call, Box** bind_obj_out, RewriterVar** r_bind_obj_out);
+inline Box* getattrInternalGeneral(Box* obj, const std::string& attr, GetattrRewriteArgs* rewrite_args, bool cls_only,
+                                   bool for_call, Box** bind_obj_out, RewriterVar** r_bind_obj_out) {
+    return getattrInternalGeneral(obj, InternedString::lookup(attr), rewrite_args, cls_only, for_call, bind_obj_out,
+                                  r_bind_obj_out);
+}
+
+Box* typeLookup(BoxedClass* cls, InternedString attr, GetattrRewriteArgs* rewrite_args);
+inline Box* typeLookup(BoxedClass* cls, const std::string& attr, GetattrRewriteArgs* rewrite_args) {
+    return typeLookup(cls, InternedString::lookup(attr), rewrite_args);
+}
 
-Box* typeLookup(BoxedClass* cls, const std::string& attr, GetattrRewriteArgs* rewrite_args);
+// The dict that holds the attributes of an object whose hidden class is DICT_BACKED:
+BoxedDict* getDictBackedAttrs(HCAttrs* attrs);
 
 extern "C" void raiseAttributeErrorStr(const char* typeName, const char* attr) __attribute__((__noreturn__));
 extern "C" void raiseAttributeError(Box* obj, const char* attr) __attribute__((__noreturn__));
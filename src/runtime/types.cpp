@@ -326,6 +326,21 @@ BoxedModule::BoxedModule(const std::string& name, const std::string& fn) : fn(fn
     this->giveAttr("__file__", boxString(fn));
 }
 
+GlobalCell* BoxedModule::getGlobalCell(InternedString name) {
+    assert(name.isInterned());
+    auto it = global_cells.find(name);
+    if (it != global_cells.end())
+        return it->second;
+
+    static StatCounter num_cells("num_global_cells");
+    num_cells.log();
+
+    GlobalCell* cell = new GlobalCell();
+    cell->value = getattr(name);
+    global_cells[name] = cell;
+    return cell;
+}
+
 std::string BoxedModule::name() {
     Box* name = this->getattr("__name__");
     if (!name || name->cls != str_cls) {
@@ -356,7 +371,7 @@ extern "C" void boxGCHandler(GCVisitor* v, Box* b) {
             HCAttrs* attrs = b->getHCAttrsPtr();
 
             v->visit(attrs->hcls);
-            int nattrs = attrs->hcls->attr_offsets.size();
+            int nattrs = attrs->hcls->attributeArraySize();
             if (nattrs) {
                 HCAttrs::AttrList* attr_list = attrs->attr_list;
                 assert(attr_list);
@@ -645,7 +660,7 @@ Box* trap_obj = NULL;
 Box* range_obj = NULL;
 }
 
-HiddenClass* root_hcls;
+HiddenClass* root_hcls, *dict_backed_hcls;
 
 extern "C" Box* createSlice(Box* start, Box* stop, Box* step) {
     BoxedSlice* rtn = new BoxedSlice(start, stop, step);
@@ -838,13 +853,24 @@ public:
 
         HCAttrs* attrs = self->b->getHCAttrsPtr();
         bool first = true;
-        for (const auto& p : attrs->hcls->attr_offsets) {
-            if (!first)
-                os << ", ";
-            first = false;
+        if (attrs->hcls->getType() == HiddenClass::DICT_BACKED) {
+            for (const auto& p : getDictBackedAttrs(attrs)->d) {
+                if (!first)
+                    os << ", ";
+                first = false;
+
+                BoxedString* v = p.second->reprICAsString();
+                os << static_cast<BoxedString*>(p.first)->s << ": " << v->s;
+            }
+        } else {
+            for (int i = 0; i < attrs->hcls->attributeArraySize(); i++) {
+                if (!first)
+                    os << ", ";
+                first = false;
 
-            BoxedString* v = attrs->attr_list->attrs[p.second]->reprICAsString();
-            os << p.first << ": " << v->s;
+                BoxedString* v = attrs->attr_list->attrs[i]->reprICAsString();
+                os << attrs->hcls->getAttrName(i).str() << ": " << v->s;
+            }
         }
         os << "})";
         return boxString(os.str());
@@ -867,8 +893,14 @@ public:
         BoxedList* rtn = new BoxedList();
 
         HCAttrs* attrs = self->b->getHCAttrsPtr();
-        for (const auto& p : attrs->hcls->attr_offsets) {
-            listAppend(rtn, boxString(p.first));
+        if (attrs->hcls->getType() == HiddenClass::DICT_BACKED) {
+            for (const auto& p : getDictBackedAttrs(attrs)->d) {
+                listAppend(rtn, p.first);
+            }
+        } else {
+            for (int i = 0; i < attrs->hcls->attributeArraySize(); i++) {
+                listAppend(rtn, boxString(attrs->hcls->getAttrName(i).str()));
+            }
         }
         return rtn;
     }
@@ -880,8 +912,14 @@ public:
         BoxedList* rtn = new BoxedList();
 
         HCAttrs* attrs = self->b->getHCAttrsPtr();
-        for (const auto& p : attrs->hcls->attr_offsets) {
-            listAppend(rtn, attrs->attr_list->attrs[p.second]);
+        if (attrs->hcls->getType() == HiddenClass::DICT_BACKED) {
+            for (const auto& p : getDictBackedAttrs(attrs)->d) {
+                listAppend(rtn, p.second);
+            }
+        } else {
+            for (int i = 0; i < attrs->hcls->attributeArraySize(); i++) {
+                listAppend(rtn, attrs->attr_list->attrs[i]);
+            }
         }
         return rtn;
     }
@@ -893,9 +931,16 @@ public:
         BoxedList* rtn = new BoxedList();
 
         HCAttrs* attrs = self->b->getHCAttrsPtr();
-        for (const auto& p : attrs->hcls->attr_offsets) {
-            BoxedTuple* t = new BoxedTuple({ boxString(p.first), attrs->attr_list->attrs[p.second] });
-            listAppend(rtn, t);
+        if (attrs->hcls->getType() == HiddenClass::DICT_BACKED) {
+            for (const auto& p : getDictBackedAttrs(attrs)->d) {
+                listAppend(rtn, new BoxedTuple({ p.first, p.second }));
+            }
+        } else {
+            for (int i = 0; i < attrs->hcls->attributeArraySize(); i++) {
+                BoxedTuple* t
+                    = new BoxedTuple({ boxString(attrs->hcls->getAttrName(i).str()), attrs->attr_list->attrs[i] });
+                listAppend(rtn, t);
+            }
         }
         return rtn;
     }
@@ -905,7 +950,9 @@ public:
         AttrWrapper* self = static_cast<AttrWrapper*>(_self);
 
         HCAttrs* attrs = self->b->getHCAttrsPtr();
-        return boxInt(attrs->hcls->attr_offsets.size());
+        if (attrs->hcls->getType() == HiddenClass::DICT_BACKED)
+            return boxInt(getDictBackedAttrs(attrs)->d.size());
+        return boxInt(attrs->hcls->attributeArraySize());
     }
 };
 
@@ -979,6 +1026,8 @@ bool TRACK_ALLOCATIONS = false;
 void setupRuntime() {
     root_hcls = HiddenClass::makeRoot();
     gc::registerPermanentRoot(root_hcls);
+    dict_backed_hcls = HiddenClass::makeDictBacked();
+    gc::registerPermanentRoot(dict_backed_hcls);
 
     // We have to do a little dance to get object_cls and type_cls set up, since the normal
     // object-creation routines look at the class to see the allocation size.
@@ -1159,6 +1208,7 @@ void setupRuntime() {
     setupBuiltins();
     setupTime();
     setupThread();
+    setupGC();
 
     setupCAPI();
 
@@ -1271,5 +1321,6 @@ void teardownRuntime() {
     */
 
     freeHiddenClasses(root_hcls);
+    freeHiddenClasses(dict_backed_hcls);
 }
 }
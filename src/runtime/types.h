@@ -70,6 +70,7 @@ void setupSys();
 void setupBuiltins();
 void setupTime();
 void setupThread();
+void setupGC();
 void setupSysEnd();
 
 BoxedDict* getSysModulesDict();
@@ -222,6 +223,10 @@ public:
 
     void freeze();
 
+    // Has to be called whenever the class's attributes change: clears its tp_version_tag, so that the cached
+    // typeLookup() results for it and its subclasses stop matching.  It gets a new tag the next time it's looked up.
+    void modified();
+
     BoxedClass(BoxedClass* base, gcvisit_func gc_visit, int attrs_offset, int instance_size, bool is_user_defined);
 
     DEFAULT_CLASS(type_cls);
@@ -255,10 +260,43 @@ static_assert(offsetof(pyston::BoxedHeapClass, as_buffer) == offsetof(PyHeapType
 static_assert(sizeof(pyston::BoxedHeapClass) == sizeof(PyHeapTypeObject), "");
 
 
+// Hidden classes form a tree of transitions, rooted at root_hcls: each one is its parent plus one more attribute, which
+// goes at the end of the object's attribute array.  They don't change once they're made, and only know about their
+// own attribute; the name-to-offset lookups go through a table that's shared by a whole chain of hidden classes (see
+// getOrMakeChild()), so building up an object with N attributes only takes O(N) time and space.
+//
+// Objects that get too many attributes, or get attributes deleted, would keep adding new branches to the tree, so
+// they switch over to keeping their attributes in a dict instead (see DICT_BACKED).
 class HiddenClass : public ConservativeGCObject {
+public:
+    enum HCType : uint8_t {
+        NORMAL,
+        // The object's attribute array has a single entry, a BoxedDict that holds all of its attributes.  All objects
+        // in this mode share dict_backed_hcls, so nothing can be cached based on it.
+        DICT_BACKED,
+    };
+
+    // Objects that would get more attributes than this switch to DICT_BACKED (if they're allowed to):
+    static const int MAX_ATTRS = 128;
+
 private:
-    HiddenClass() {}
-    HiddenClass(const HiddenClass* parent) : attr_offsets(parent->attr_offsets) {}
+    // The attribute names of a chain of hidden classes, in offset order.  A hidden class with n attributes only
+    // looks at the first n entries, so a child can share its parent's chain by appending to it, as long as the parent
+    // is still the last class on that chain.
+    struct AttrChain {
+        std::vector<InternedString> names;
+        std::unordered_map<InternedString, int> offsets;
+    };
+
+    HCType type;
+    HiddenClass* parent;
+    // The attribute that this class adds to its parent:
+    InternedString attr;
+    int nattrs;
+    AttrChain* chain;
+
+    HiddenClass(HCType type) : type(type), parent(NULL), nattrs(0), chain(new AttrChain()) {}
+    HiddenClass(HiddenClass* parent, InternedString attr);
 
 public:
     static HiddenClass* makeRoot() {
@@ -267,21 +305,34 @@ public:
         assert(!made);
         made = true;
 #endif
-        return new HiddenClass();
+        return new HiddenClass(NORMAL);
     }
+    static HiddenClass* makeDictBacked() { return new HiddenClass(DICT_BACKED); }
+
+    conservative_unordered_map<InternedString, HiddenClass*> children;
 
-    conservative_unordered_map<std::string, int> attr_offsets;
-    conservative_unordered_map<std::string, HiddenClass*> children;
+    HCType getType() const { return type; }
+    HiddenClass* getParent() const { return parent; }
 
-    HiddenClass* getOrMakeChild(const std::string& attr);
+    // The number of entries in the attribute array of objects with this hidden class:
+    int attributeArraySize() const { return type == DICT_BACKED ? 1 : nattrs; }
+
+    InternedString getAttrName(int offset) const {
+        assert(type == NORMAL);
+        assert(offset >= 0 && offset < nattrs);
+        return chain->names[offset];
+    }
 
-    int getOffset(const std::string& attr) {
-        auto it = attr_offsets.find(attr);
-        if (it == attr_offsets.end())
+    int getOffset(InternedString attr) const {
+        assert(type == NORMAL);
+        auto it = chain->offsets.find(attr);
+        if (it == chain->offsets.end() || it->second >= nattrs)
             return -1;
         return it->second;
     }
-    HiddenClass* delAttrToMakeHC(const std::string& attr);
+
+    HiddenClass* getOrMakeChild(InternedString attr);
+    HiddenClass* delAttrToMakeHC(InternedString attr);
 };
 
 class BoxedInt : public Box {
@@ -453,15 +504,34 @@ public:
     DEFAULT_CLASS(function_cls);
 };
 
+// A stable place for the value of one module global, so that ICs can read the global with a single load instead of
+// guarding on the module's hidden class, which changes every time a global gets added (see getGlobal()).  The cell
+// mirrors the module attribute of the same name, and is NULL when the module doesn't have it.
+struct GlobalCell {
+    Box* value;
+
+    // ICs that read the builtin of the same name since this cell was empty; they get invalidated when the module
+    // gets a value that shadows the builtin.
+    ICInvalidator dependent_builtin_reads;
+
+    GlobalCell() : value(NULL) {}
+};
+
 class BoxedModule : public Box {
 public:
     HCAttrs attrs;
     std::string fn; // for traceback purposes; not the same as __file__
     FutureFlags future_flags;
 
+    // Made on demand, and never freed or moved.  The GC doesn't need to look at them, since all the values are
+    // attributes of the module as well.
+    std::unordered_map<InternedString, GlobalCell*> global_cells;
+
     BoxedModule(const std::string& name, const std::string& fn);
     std::string name();
 
+    GlobalCell* getGlobalCell(InternedString name);
+
     DEFAULT_CLASS(module_cls);
 };
 
@@ -0,0 +1,32 @@
+# Attribute names get interned on their way into the object model; make sure that names built at runtime find the
+# same attributes as the ones that appear in the source.
+
+class C(object):
+    pass
+
+c = C()
+c.attr = 1
+name = "".join(["at", "tr"])
+print getattr(c, name), hasattr(c, name), name in c.__dict__
+
+for i in xrange(5):
+    setattr(c, "dyn%d" % i, i * i)
+print c.dyn3, sorted(k for k in c.__dict__)
+
+delattr(c, "dyn" + "2")
+print hasattr(c, "dyn2"), c.dyn4
+
+class D(C):
+    x = "class"
+
+d = D()
+print d.x, getattr(d, "".join(["x"]))
+d.x = "instance"
+print d.x, D.x
+del d.x
+print d.x
+
+import sys
+mod = sys.modules[__name__]
+setattr(mod, "made_" + "up", 42)
+print made_up
@@ -0,0 +1,28 @@
+# run_args: -a
+# statcheck: stats.get('reopts_background', 0) >= 1
+# Tier-up compiles happen on a background thread; functions should keep working (in their current
+# version) while that happens, and switch over once the new version is ready.
+
+def f(x):
+    return x * 2 + 1
+
+def g(n):
+    t = 0
+    for i in xrange(n):
+        t += f(i)
+    return t
+
+total = 0
+for i in xrange(2000):
+    total += g(50)
+print total
+
+class C(object):
+    def m(self, x):
+        return x + 1
+
+c = C()
+t = 0
+for i in xrange(100000):
+    t = c.m(t)
+print t
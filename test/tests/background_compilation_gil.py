@@ -0,0 +1,20 @@
+# run_args: -a
+# statcheck: stats.get('reopts_background', 0) >= 1
+# statcheck: stats.get('background_compile_gil_handoffs', 0) >= 1
+# The background compiler releases the GIL while LLVM runs, so the main thread should get to keep
+# running while a tier-up compile is in flight, rather than stalling until the compile finishes.
+
+def f(x):
+    return x * 3 + 1
+
+def g(n):
+    t = 0
+    for i in xrange(n):
+        t = (t + f(i)) % 1000003
+    return t
+
+# Keep the main thread busy for long enough that the compiles overlap with it:
+total = 0
+for i in xrange(5000):
+    total = (total + g(100)) % 1000003
+print total
@@ -0,0 +1,96 @@
+# run_args: -J baseline=2
+# statcheck: "-n" in EXTRA_JIT_ARGS or "-O" in EXTRA_JIT_ARGS or stats.get('num_baseline_compiles', 0) >= 4
+# Functions that have been called a couple of times get run with baseline-JIT'd code; make sure that
+# control flow, exceptions, generators and frame introspection all still work once that happens.
+
+import sys
+
+def control_flow(n):
+    r = []
+    for i in xrange(n):
+        if i % 3 == 0:
+            continue
+        elif i == 7:
+            break
+        r.append(i)
+    else:
+        r.append("no break")
+    while n > 0:
+        n -= 4
+    return r, n
+
+for i in xrange(5):
+    print control_flow(i * 3)
+
+def exceptions(x):
+    try:
+        try:
+            return 10 / x
+        finally:
+            print "finally", x
+    except ZeroDivisionError as e:
+        print "caught", e
+    return -1
+
+for i in xrange(4):
+    print exceptions(i - 1)
+
+def thrower(x):
+    l = [x]
+    return l[x]
+
+def catch_from_outside():
+    for i in xrange(4):
+        try:
+            print thrower(i - 1)
+        except IndexError:
+            print "IndexError", sys.exc_info()[0]
+
+catch_from_outside()
+
+def gen(n):
+    for i in xrange(n):
+        if i % 2:
+            yield i
+    yield "done"
+
+for i in xrange(4):
+    print list(gen(i * 2))
+
+def introspect(a, b):
+    c = a + b
+    if c > 3:
+        del c
+    return sorted(locals().items())
+
+for i in xrange(4):
+    print introspect(i, 1)
+
+def make_counter():
+    count = [0]
+    def inc(k):
+        count[0] += k
+        return count[0]
+    return inc
+
+inc = make_counter()
+for i in xrange(5):
+    print inc(i)
+
+class C(object):
+    def __init__(self, x):
+        self.x = x
+
+    def get(self):
+        return self.x
+
+for i in xrange(4):
+    print C(i).get()
+
+# A loop that's long enough to switch to baseline code partway through and then OSR out of it:
+def long_loop(n):
+    t = 0
+    for i in xrange(n):
+        t += i
+    return t
+print long_loop(20000)
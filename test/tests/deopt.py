@@ -0,0 +1,60 @@
+# Once f() has been optimized with a speculation on the class of o.x, passing it something else
+# should hand the frame off to the interpreter in the middle of the function, with all of the
+# locals intact.  After a few of those it should get recompiled without that speculation.
+# statcheck: stats.get('num_deopt', 0) >= 1
+# statcheck: stats.get('num_deopt_recompiles', 0) >= 1
+# statcheck: stats.get('num_deopt', 0) <= 20
+
+class C(object):
+    pass
+
+def f(o, n):
+    before = n * 2
+    l = [before]
+    y = o.x
+    l.append(y)
+    try:
+        l.append(y + 1)
+    except TypeError:
+        l.append("error")
+    i = 0
+    while i < n:
+        i += 1
+    return before, l, i
+
+ints = C()
+ints.x = 1
+strs = C()
+strs.x = "hello"
+floats = C()
+floats.x = 1.5
+
+for i in xrange(20000):
+    f(ints, 3)
+print f(ints, 3)
+print f(floats, 4)
+print f(strs, 5)
+for i in xrange(100):
+    r = f(floats, 2)
+print r
+print f(ints, 3)
+
+def make_adder(k):
+    def g(o):
+        z = o.x
+        return z + k
+    return g
+
+g = make_adder(10)
+for i in xrange(20000):
+    g(ints)
+print g(ints), g(floats)
+
+def gen(o, n):
+    for i in xrange(n):
+        v = o.x
+        yield v * 2
+
+for i in xrange(20000):
+    list(gen(ints, 1))
+print list(gen(ints, 3)), list(gen(floats, 3))
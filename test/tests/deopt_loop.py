@@ -0,0 +1,29 @@
+# statcheck: stats.get('num_deopt', 0) >= 1
+# statcheck: stats.get('num_osr_from_deopt', 0) >= 1
+# When a speculation fails in the middle of a hot loop, the frame gets handed off to the interpreter;
+# it should OSR back into compiled code for the rest of the loop instead of interpreting all of it.
+
+class C(object):
+    pass
+
+ints = C()
+ints.x = 1
+floats = C()
+floats.x = 1.5
+
+def f(objs, n):
+    t = 0
+    for o in objs:
+        y = o.x
+        t = t + y
+    i = 0
+    while i < n:
+        i += 1
+        t = t + i
+    return t
+
+l = [ints] * 20000
+for i in xrange(10):
+    print f(l, 10)
+print f(l + [floats], 20000)
+print f([floats] + l, 20000)
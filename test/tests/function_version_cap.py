@@ -0,0 +1,23 @@
+# statcheck: stats.get('num_generic_versions', 0) == 1
+# statcheck: 'num_functions_with_9_versions' not in stats
+# A function that gets called with lots of different argument types shouldn't get a new
+# specialized version for each of them.
+
+class C(object):
+    pass
+
+def f(a, b):
+    return (type(a).__name__, type(b).__name__)
+
+values = [1, 1.0, 1L, "s", u"u", (), [], {}, None, C(), True, 1j]
+seen = set()
+for a in values:
+    for b in values:
+        seen.add(f(a, b))
+print len(seen)
+
+# These should all reuse the versions that were picked above:
+for i in xrange(1000):
+    for a in values:
+        f(a, a)
+print sorted(f(a, a) for a in values)
@@ -0,0 +1,34 @@
+# run_args: -G
+# skip-if: not soft_dirty_supported()
+# statcheck: stats.get('gc_minor_collections', 0) >= 1
+# Regression test for generational collection: objects that have survived a collection
+# (and are thus old) need to keep the young objects that get stored into them alive
+# across minor collections.
+# On kernels without soft-dirty page tracking the collector only does full collections, so there
+# would be nothing to test.
+
+class C(object):
+    pass
+
+def churn():
+    # allocate some data to try to force a few collections:
+    for i in xrange(10):
+        range(10000)
+
+old_obj = C()
+old_list = [None] * 100
+old_dict = {}
+churn()
+
+for i in xrange(100):
+    o = C()
+    o.n = i
+    old_obj.x = o
+    old_list[i] = [i]
+    old_dict[i] = str(i) * 3
+    churn()
+    assert old_obj.x.n == i
+
+print old_obj.x.n
+print sum(l[0] for l in old_list)
+print sum(len(s) for s in old_dict.values())
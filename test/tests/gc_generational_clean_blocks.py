@@ -0,0 +1,20 @@
+# run_args: -G
+# skip-if: not soft_dirty_supported()
+# statcheck: stats.get('gc_minor_collections', 0) >= 1
+# statcheck: stats.get('gc_minor_clean_blocks', 0) > stats.get('gc_minor_dirty_blocks', 0)
+# Minor collections should only have to look at the blocks that were written to since the previous
+# collection.  Here, most of the heap is old data that doesn't change, so most blocks should get
+# skipped; if something (like the sweep) writes to every block after the write tracking gets reset,
+# they would all look dirty.
+
+class C(object):
+    def __init__(self, i):
+        self.i = i
+
+old_data = [C(i) for i in xrange(50000)]
+
+# Allocate large objects, so that the garbage doesn't dirty many small-object blocks:
+for i in xrange(2000):
+    s = "x" * 100000
+
+print sum(o.i for o in old_data)
@@ -0,0 +1,41 @@
+# run_args: -H 4096
+# statcheck: stats['gc_heap_profile_samples'] >= 10
+# Allocate a bunch of objects that stay alive, and check that the heap profile attributes them
+# to the right class and allocation site.
+import gc
+
+class Retained(object):
+    def __init__(self, i):
+        self.i = i
+
+def make_garbage():
+    for i in xrange(10000):
+        Retained(i)
+
+def make_retained():
+    return [Retained(i) for i in xrange(10000)]
+
+make_garbage()
+l = make_retained()
+
+fn = "/tmp/pyston_gc_heap_profile_test.txt"
+gc.dump_heap_profile(fn)
+
+classes = {}
+sites = []
+for line in open(fn):
+    words = line.split()
+    if words[0] == "class":
+        classes[words[3]] = (int(words[1]), int(words[2]))
+    elif words[0] == "site":
+        sites.append((words[3], line.split(' ', 4)[4]))
+
+nbytes, nobjects = classes["__main__.Retained"]
+print nobjects >= 10000, nbytes >= 10000 * 16
+print any(cls == "__main__.Retained" and "make_retained" in stack for cls, stack in sites)
+
+try:
+    gc.dump_heap_profile("/nonexistent/directory/profile.txt")
+except IOError:
+    print "IOError"
+print len(l)
@@ -0,0 +1,20 @@
+# Allocate and free lots of objects in the range between the small-object size classes
+# and 1MB, so that their page runs get split, coalesced, and reused.
+
+def make(n):
+    return [n] * n
+
+total = 0
+keep = []
+for i in xrange(3000):
+    n = 300 + (i * 7919) % 100000
+    l = make(n)
+    total += len(l)
+    if i % 10 == 0:
+        keep.append(l)
+    if len(keep) > 20:
+        keep.pop(0)
+
+print total
+print sum(len(l) for l in keep)
+print all(l[0] == len(l) and l[-1] == len(l) for l in keep)
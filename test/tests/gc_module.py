@@ -0,0 +1,37 @@
+# Pyston's gc module exposes the adaptive collection policy instead of CPython's
+# generation thresholds.
+# statcheck: stats['gc_collections'] >= 2
+
+import gc
+
+print gc.collect() >= 0
+
+# Like CPython's, gc.collect() returns how many unreachable objects it found:
+def make_garbage():
+    for i in xrange(1000):
+        [i]
+make_garbage()
+print gc.collect() >= 500
+
+gc.set_threshold(50, 1000000, 4000000, 0)
+print gc.get_threshold()
+
+stats = gc.get_stats()
+print sorted(stats.keys())
+print 1000000 <= stats["threshold_bytes"] <= 4000000
+
+l = []
+for i in xrange(100000):
+    l.append([i])
+    if len(l) > 1000:
+        l = []
+
+stats = gc.get_stats()
+print stats["collections"] > 1
+print stats["live_bytes"] > 0
+print stats["total_pause_us"] >= stats["max_pause_us"] >= stats["last_pause_us"]
+
+try:
+    gc.set_threshold(100, 10, 5)
+except ValueError, e:
+    print e
@@ -0,0 +1,6 @@
+# run_args: -g growth_percent=50,min_bytes=1000000,pause_target_ms=5
+# The -g settings should be what the gc module starts out with.
+
+import gc
+
+print gc.get_threshold()
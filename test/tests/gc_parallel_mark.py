@@ -0,0 +1,29 @@
+# run_args: -T4
+# Build up a large object graph and then allocate enough to trigger a number of collections,
+# so that the marker threads have to split up the work.
+
+class Node(object):
+    def __init__(self, val, children):
+        self.val = val
+        self.children = children
+
+def build(depth, val):
+    if depth == 0:
+        return Node(val, [])
+    return Node(val, [build(depth - 1, val * 3 + i) for i in xrange(3)])
+
+def total(n):
+    t = n.val
+    for c in n.children:
+        t += total(c)
+    return t
+
+trees = [build(6, i) for i in xrange(10)]
+d = dict((i, str(i)) for i in xrange(10000))
+
+for i in xrange(20):
+    # allocate some data to try to force a collection:
+    range(100000)
+
+print sum(total(t) for t in trees)
+print sum(len(v) for v in d.itervalues())
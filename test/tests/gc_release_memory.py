@@ -0,0 +1,16 @@
+# Allocate a spike of small and medium objects, drop them, and then allocate again, so that
+# the emptied blocks and page runs get pooled, decommitted, and reused.
+import gc
+
+def spike(n):
+    return [(str(i), [i] * (i % 700)) for i in xrange(n)]
+
+for round in xrange(3):
+    l = spike(50000)
+    print round, len(l), sum(len(t[1]) for t in l)
+    del l
+    gc.collect()
+    gc.collect()
+
+l = [str(i) for i in xrange(100000)]
+print len(l), l[-1]
@@ -0,0 +1,31 @@
+# Several threads allocate small objects of every size class from their own free lists while
+# collections happen in between, which have to put the unused free list entries back.
+from thread import start_new_thread
+import gc
+import time
+
+done = []
+
+def worker(id):
+    l = []
+    for i in xrange(20000):
+        # Strings of varying length cover the different size classes:
+        l.append("x" * (i % 1500))
+        if i % 5000 == 0:
+            gc.collect()
+            l = l[-100:]
+    done.append(sum(len(s) for s in l))
+
+for i in xrange(4):
+    start_new_thread(worker, (i,))
+
+while len(done) < 4:
+    time.sleep(0.01)
+
+print sorted(done)
+
+# The main thread's free lists should survive collections too:
+for i in xrange(10):
+    t = tuple(range(i))
+    gc.collect()
+    print t, [str(j) * j for j in t]
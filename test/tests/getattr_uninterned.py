@@ -0,0 +1,38 @@
+# statcheck: stats.get('num_uninterned_lookups', 0) >= 1000
+# Looking up names that nothing has ever been stored under shouldn't add them to the intern table, but they
+# still have to go through __getattr__, dict-backed attributes and the like.
+
+class C(object):
+    pass
+
+c = C()
+misses = 0
+for i in xrange(1000):
+    if getattr(c, "missing_%d" % i, None) is None:
+        misses += 1
+print misses
+print hasattr(c, "never_stored"), hasattr(C, "never_stored_either")
+
+class G(object):
+    def __getattr__(self, name):
+        return "__getattr__ " + name
+print getattr(G(), "made_up_" + str(5))
+
+# Lots of attributes push an instance over to a dict-backed hidden class; ones that only went in through the
+# __dict__ have to be found too:
+d = C()
+for i in xrange(200):
+    setattr(d, "a%d" % i, i)
+d.__dict__["only_" + "in_dict"] = "found"
+print getattr(d, "only_in_" + "dict", None)
+
+try:
+    delattr(c, "not_" + "there")
+except AttributeError as e:
+    print e
+
+import sys
+try:
+    print getattr(sys, "no_such_" + "module_attr")
+except AttributeError as e:
+    print e
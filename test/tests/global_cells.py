@@ -0,0 +1,63 @@
+# statcheck: stats.get('num_global_cells', 0) > 0
+# Global reads go through per-name cells; make sure that adding, deleting and shadowing globals and builtins is seen
+# by code that has already been run a bunch of times.
+
+import __builtin__
+
+def f():
+    return len([1, 2, 3]), x
+
+x = 1
+for i in xrange(1000):
+    f()
+print f()
+
+# Storing to a global:
+for i in xrange(1000):
+    x = i
+print f()
+
+# Shadowing a builtin:
+def len(l):
+    return "shadowed"
+print f()
+del len
+print f()
+globals()["len"] = lambda l: "shadowed through globals()"
+print f()
+del len
+print f()
+
+# Deleting a global:
+del x
+try:
+    f()
+except NameError as e:
+    print "NameError:", e
+x = "back"
+print f()
+
+# Adding and removing builtins:
+def g():
+    return new_builtin
+try:
+    g()
+except NameError as e:
+    print "NameError:", e
+__builtin__.new_builtin = "new builtin"
+for i in xrange(1000):
+    g()
+print g()
+new_builtin = "global"
+print g()
+del new_builtin
+print g()
+del __builtin__.new_builtin
+try:
+    g()
+except NameError as e:
+    print "NameError:", e
+
+def h():
+    return __builtins__ is not None
+print h()
@@ -0,0 +1,53 @@
+# statcheck: stats.get('num_dict_backed_objects', 0) >= 2
+# Objects that get lots of attributes, or that have attributes deleted, switch from hidden classes to keeping their
+# attributes in a dict; make sure they still behave the same.
+
+class C(object):
+    def method(self):
+        return "method"
+
+def get(o, n):
+    return o.a5
+
+c = C()
+for i in xrange(300):
+    setattr(c, "a%d" % i, i)
+print c.a0, c.a127, c.a128, c.a299, getattr(c, "a200")
+print len(c.__dict__), sorted(c.__dict__.values())[-3:]
+print c.method()
+c.a5 = "five"
+for i in xrange(3):
+    print get(c, i)
+del c.a6
+print hasattr(c, "a6"), len(c.__dict__.keys()), len(c.__dict__.items())
+print "a7" in dir(c), "a6" in dir(c), "method" in dir(c)
+
+# Deleting an attribute also switches the object over:
+d = C()
+d.x = 1
+d.y = 2
+d.z = 3
+del d.y
+print sorted(d.__dict__.items())
+d.y = 4
+print d.x, d.y, d.z
+try:
+    d.w
+except AttributeError as e:
+    print "AttributeError:", e
+
+# Objects that stay small keep sharing hidden classes:
+l = []
+for i in xrange(5):
+    o = C()
+    o.p = i
+    o.q = i * 2
+    l.append(o)
+print [o.p + o.q for o in l]
+
+# Classes and modules keep using hidden classes even when they lose attributes:
+class E(object):
+    a = 1
+    b = 2
+del E.a
+print hasattr(E, "a"), E.b
@@ -0,0 +1,39 @@
+# statcheck: stats.get('type_lookup_cache_hits', 0) > 0
+# A site that sees lots of different classes keeps evicting IC slots until it gets marked megamorphic, and from then
+# on relies on the slowpath's caches; make sure those notice changes to the classes.
+
+classes = []
+for i in xrange(40):
+    classes.append(type("C%d" % i, (object,), {"n": i, "get": lambda self: self.n * 2}))
+
+def f(o):
+    return o.n + o.get()
+
+for rep in xrange(20):
+    t = 0
+    for c in classes:
+        t += f(c())
+print t
+
+# Changing a class attribute has to be visible at the megamorphic site:
+classes[3].n = 100
+print f(classes[3]())
+
+# And so does changing a base class:
+class Base(object):
+    def get(self):
+        return 1
+class Derived(Base):
+    n = 5
+for i in xrange(10):
+    f(Derived())
+print f(Derived())
+Base.get = lambda self: 1000
+print f(Derived())
+del Base.get
+try:
+    f(Derived())
+except AttributeError as e:
+    print "AttributeError:", e
+Derived.get = lambda self: -1
+print f(Derived())
@@ -0,0 +1,125 @@
+# run_args: -J baseline=1000000
+# statcheck: "-n" in EXTRA_JIT_ARGS or "-O" in EXTRA_JIT_ARGS or stats.get('num_bytecode_instrs', 0) > 0
+# statcheck: "-n" in EXTRA_JIT_ARGS or "-O" in EXTRA_JIT_ARGS or stats.get('num_bytecode_register_instrs', 0) > 0
+# Keep everything in the interpreter's bytecode loop (the baseline JIT never kicks in), and exercise the
+# different kinds of name lookups and the control flow instructions.
+
+x = 1
+
+def read_global():
+    return x
+
+def write_global(v):
+    global x
+    x = v
+
+print read_global()
+write_global(5)
+print read_global(), x
+
+def closures(a):
+    b = a * 2
+    def inner(c):
+        return a + b + c
+    b += 1
+    return inner
+
+print closures(1)(10)
+
+y = "global y"
+class C(object):
+    print y
+    y = "class y"
+    print y
+    z = [y]
+print C.y, C.z, y
+
+def unbound(n):
+    if n:
+        v = n
+    try:
+        return v
+    except UnboundLocalError as e:
+        return "UnboundLocalError: %s" % e
+
+print unbound(3)
+print unbound(0)
+
+def deleting():
+    a = 1
+    del a
+    try:
+        print a
+    except NameError as e:
+        print "NameError:", e
+
+deleting()
+
+def loops(n):
+    t = 0
+    i = 0
+    while True:
+        i += 1
+        if i % 2:
+            continue
+        if i > n:
+            break
+        for j in xrange(i):
+            t += j
+    else:
+        t = -1
+    return t
+
+print loops(10)
+
+def exceptions(l):
+    r = []
+    for o in l:
+        try:
+            r.append(1 / o)
+        except ZeroDivisionError:
+            r.append("zero")
+        except TypeError as e:
+            r.append(type(e).__name__)
+        finally:
+            r.append("finally")
+    return r
+
+print exceptions([1, 0, "a", 2])
+
+def unpacking():
+    (a, b), c = (1, 2), 3
+    d = e = [a, b, c]
+    d[0] = 10
+    return a, b, c, e
+
+print unpacking()
+
+# Statements that get lowered to register instructions, with operands that are locals, globals, closure variables
+# and constants:
+def registers(l, k):
+    s = l[0] + k
+    s += x
+    c = s < 100
+    n = len(l)
+    m = l.index(k)
+    d = {}
+    d[k] = n
+    r = d.get(k), d[k], str(n).zfill(3)
+    def inner():
+        return k * 2
+    return s, c, n, m, r, inner(), k.__class__.__name__
+
+print registers([1, 2, 3], 2)
+
+def register_unbound(n):
+    if n:
+        v = n
+    try:
+        w = v + 1
+        return w
+    except UnboundLocalError as e:
+        return "UnboundLocalError: %s" % e
+
+print register_unbound(1)
+print register_unbound(0)
@@ -0,0 +1,44 @@
+# run_args: -J baseline=1000000
+# The interpreter keeps locals in slots; make sure that locals(), del and class bodies see the right set of names.
+
+def f(a, *args, **kw):
+    b = 1
+    print sorted(locals().items())
+    if a:
+        c = 2
+    del b
+    print sorted(locals().items())
+    for i in xrange(2):
+        d = i
+    print sorted(locals().keys())
+    try:
+        print b
+    except NameError as e:
+        print "NameError", e
+
+f(0)
+f(1, 2, x=3)
+
+def g():
+    x = 1
+    def inner():
+        return x
+    x = 2
+    return locals().keys(), inner()
+
+l, r = g()
+print sorted(l), r
+
+class C(object):
+    a = 1
+    b = a + 1
+    del a
+    c = [b * i for i in range(3)]
+print sorted(k for k in C.__dict__ if not k.startswith("__")), C.b, C.c
+
+def many():
+    v0 = 0; v1 = 1; v2 = 2; v3 = 3; v4 = 4; v5 = 5; v6 = 6; v7 = 7; v8 = 8; v9 = 9
+    return sum([v0, v1, v2, v3, v4, v5, v6, v7, v8, v9]), len(locals())
+
+for i in xrange(3):
+    print many()
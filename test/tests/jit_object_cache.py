@@ -0,0 +1,25 @@
+# run_args: -n -C /tmp/pyston_test_object_cache
+# statcheck: stats.get('jit_objcache_stores', 0) + stats.get('jit_objcache_hits', 0) >= 1
+# JIT'd code gets stored in (and on later runs, loaded from) the object cache.  The cached code refers to
+# runtime objects through relocations, so it has to work regardless of which run produced it.
+
+def f(x):
+    return x * 2 + 1
+
+class C(object):
+    def __init__(self, n):
+        self.n = n
+
+    def m(self, s):
+        return s + str(self.n)
+
+def g(n):
+    t = 0
+    l = []
+    for i in xrange(n):
+        t += f(i)
+        l.append(C(i).m("c"))
+    return t, l[-1], len(l)
+
+print g(1000)
+print g(1000)
@@ -0,0 +1,8 @@
+# statcheck: 'us_startup_total' in stats
+# statcheck: "-n" in EXTRA_JIT_ARGS or "-O" in EXTRA_JIT_ARGS or stats.get('us_jit_engine_init', 0) == 0
+# Programs that never leave the interpreter shouldn't have to pay for setting up the JIT.
+
+def f(x):
+    return x + 1
+
+print f(1)
@@ -0,0 +1,23 @@
+# statcheck: stats.get('typefeedback_not_speculated_failures', 0) >= 1
+# A site whose speculation keeps failing should stop getting speculated on.  The o.x load here is
+# nested inside a bigger expression, so its guard branches to the in-function deopt path rather
+# than to the interpreter; that path has to count the failures too.
+
+class C(object):
+    pass
+
+a = C()
+a.x = 1
+b = C()
+b.x = 1.5
+
+def f(objs):
+    t = 0
+    for o in objs:
+        t = t + (o.x + 1)
+    return t
+
+# Each call sees ints for long enough to speculate on them, then fails the guard at the end:
+l = [a] * 5000 + [b]
+for i in xrange(20):
+    print f(l)
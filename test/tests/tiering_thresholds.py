@@ -0,0 +1,20 @@
+# run_args: -J reopt_interpreted=2,reopt_minimal=5,reopt_moderate=20,osr_interpreted=10,osr_compiled=50
+# statcheck: ("-O" in EXTRA_JIT_ARGS) or stats.get('num_compiles_3_maximal', 0) >= 1
+# statcheck: ("-O" in EXTRA_JIT_ARGS) or stats["OSR exits"] >= 1
+# With lowered thresholds, a function that's only called 100 times should still make it all the
+# way up to the highest tier, and so should a short loop.
+
+def f(x):
+    return x * 2 + 1
+
+t = 0
+for i in xrange(100):
+    t += f(i)
+print t
+
+def g(n):
+    total = 0
+    for i in xrange(n):
+        total += i
+    return total
+print g(200)
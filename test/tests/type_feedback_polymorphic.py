@@ -0,0 +1,27 @@
+# Attribute sites that see more than one class, or that change class after the JIT has
+# already speculated on them, should keep producing the right results.
+
+class C(object):
+    pass
+
+def f(objs):
+    t = 0
+    for o in objs:
+        t += o.x
+    return t
+
+a = C()
+a.x = 1
+b = C()
+b.x = 1.5
+
+# Bimorphic: half ints and half floats
+print f([a, b] * 10000)
+
+# Monomorphic for a long time, then the class changes
+ints = [a] * 10000
+for i in xrange(5):
+    print f(ints)
+print f(ints + [b])
+for i in xrange(5):
+    print f([b] * 1000 + ints)
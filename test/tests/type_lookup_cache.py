@@ -0,0 +1,70 @@
+# statcheck: stats.get('type_lookup_cache_hits', 0) > 0
+# Lookups that don't go through an IC get cached by class version; make sure that changes anywhere in the class
+# hierarchy show up.
+
+class A(object):
+    x = "A.x"
+class B(A):
+    pass
+class C(B):
+    pass
+
+c = C()
+def lookups():
+    return getattr(c, "x", None), getattr(C, "y", None), hasattr(c, "z")
+
+print lookups()
+print lookups()
+
+# Adding an attribute in the middle of the hierarchy shadows the one further up:
+B.x = "B.x"
+print lookups()
+
+A.y = "A.y"
+print lookups()
+
+del B.x
+print lookups()
+
+setattr(A, "z", 1)
+print lookups()
+delattr(A, "x")
+print lookups()
+
+# Instance attributes vs data descriptors on the class:
+class D(object):
+    pass
+d = D()
+d.__dict__["p"] = "instance"
+print d.p
+D.p = property(lambda self: "property")
+print d.p
+del D.p
+print d.p
+
+# Methods that get replaced after they've been looked up:
+class E(object):
+    def m(self):
+        return 1
+e = E()
+for i in xrange(5):
+    e.m()
+print e.m(), E.m(e)
+E.m = lambda self: 2
+print e.m(), E.m(e)
+
+# Lots of classes, so that the cache's entries get reused:
+classes = [type("T%d" % i, (A,), {"v": i}) for i in xrange(5000)]
+print sum(cls.v for cls in classes), sum(cls().v for cls in classes)
+print classes[1234].y
+
+# Class attribute stores that have been patched into an IC have to invalidate the cache as well:
+class F(A):
+    pass
+f = F()
+def store(v):
+    F.x = v
+for i in xrange(1000):
+    store(i)
+    assert getattr(f, "x") == i, (i, getattr(f, "x"))
+print getattr(f, "x"), getattr(F, "x")
@@ -0,0 +1,85 @@
+# Compares two heap profile snapshots written by gc.dump_heap_profile() (see the -H flag),
+# printing the classes and allocation sites whose retained memory changed the most.
+#
+# Usage: python tools/heap_profile_diff.py before.txt after.txt [num_entries]
+
+import sys
+
+def parse(fn):
+    classes = {}
+    sites = {}
+    sample_bytes = None
+
+    for l in open(fn):
+        l = l.rstrip('\n')
+        if not l or l.startswith('#'):
+            continue
+
+        kind = l.split(' ', 1)[0]
+        if kind == "sample_bytes":
+            sample_bytes = int(l.split()[1])
+        elif kind == "class":
+            _, nbytes, nobjects, name = l.split(' ', 3)
+            classes[name] = (int(nbytes), int(nobjects))
+        elif kind == "site":
+            _, nbytes, nsamples, cls, stack = l.split(' ', 4)
+            sites[(cls, stack)] = (int(nbytes), int(nsamples))
+
+    return sample_bytes, classes, sites
+
+def format_bytes(n):
+    sign = '-' if n < 0 else '+'
+    n = abs(n)
+    if n > (1 << 20):
+        return "%s%.1fMB" % (sign, n * 1.0 / (1 << 20))
+    if n > (1 << 10):
+        return "%s%.1fKB" % (sign, n * 1.0 / (1 << 10))
+    return "%s%dB" % (sign, n)
+
+def format_stack(stack, max_frames=4):
+    frames = stack.split(';')
+    # The innermost frames are the most interesting ones:
+    frames = frames[-max_frames:]
+    return "\n        ".join(reversed(frames))
+
+def diff(d1, d2):
+    rtn = []
+    for k in set(d1.keys()) | set(d2.keys()):
+        b1, n1 = d1.get(k, (0, 0))
+        b2, n2 = d2.get(k, (0, 0))
+        if b1 != b2 or n1 != n2:
+            rtn.append((b2 - b1, n2 - n1, b2, k))
+    rtn.sort(key=lambda t: abs(t[0]), reverse=True)
+    return rtn
+
+def main():
+    if len(sys.argv) < 3:
+        print >>sys.stderr, "Usage: %s before.txt after.txt [num_entries]" % sys.argv[0]
+        sys.exit(1)
+
+    fn1, fn2 = sys.argv[1:3]
+    num_entries = int(sys.argv[3]) if len(sys.argv) > 3 else 20
+
+    sample_bytes1, classes1, sites1 = parse(fn1)
+    sample_bytes2, classes2, sites2 = parse(fn2)
+    if sample_bytes1 != sample_bytes2:
+        print >>sys.stderr, "Warning: the snapshots were taken with different sampling rates (%s vs %s)" % (
+                sample_bytes1, sample_bytes2)
+
+    total1 = sum(b for b, n in classes1.values())
+    total2 = sum(b for b, n in classes2.values())
+    print "Live bytes: %d -> %d (%s)" % (total1, total2, format_bytes(total2 - total1))
+    print
+
+    print "Classes:"
+    for dbytes, dobjects, nbytes, name in diff(classes1, classes2)[:num_entries]:
+        print "  %10s %+9d objects  (now %d bytes)  %s" % (format_bytes(dbytes), dobjects, nbytes, name)
+    print
+
+    print "Allocation sites (estimated from samples):"
+    for dbytes, dsamples, nbytes, (cls, stack) in diff(sites1, sites2)[:num_entries]:
+        print "  %10s %+9d samples  %s" % (format_bytes(dbytes), dsamples, cls)
+        print "        " + format_stack(stack)
+
+if __name__ == "__main__":
+    main()
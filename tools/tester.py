@@ -67,6 +67,37 @@ def get_extmodule_mtime():
     _extmodule_mtime = rtn
     return rtn
 
+# For tests of generational GC (-G), which falls back to full collections without soft-dirty page tracking.
+# This is the same check as WriteTracker::probe() in src/gc/heap.cpp: kernels built without
+# CONFIG_MEM_SOFT_DIRTY accept the clear_refs write but never set the bit.
+_soft_dirty_supported = None
+def soft_dirty_supported():
+    global _soft_dirty_supported
+    if _soft_dirty_supported is not None:
+        return _soft_dirty_supported
+
+    import ctypes
+    import struct
+    page_size = resource.getpagesize()
+    buf = ctypes.create_string_buffer(page_size * 2)
+    page = (ctypes.addressof(buf) + page_size - 1) // page_size * page_size
+
+    def is_dirty():
+        with open("/proc/self/pagemap", "rb") as f:
+            f.seek(page // page_size * 8)
+            return bool(struct.unpack("Q", f.read(8))[0] & (1 << 55))
+
+    try:
+        ctypes.memset(page, 1, 1)
+        with open("/proc/self/clear_refs", "w") as f:
+            f.write("4")
+        dirty_before = is_dirty()
+        ctypes.memset(page, 2, 1)
+        _soft_dirty_supported = not dirty_before and is_dirty()
+    except (IOError, OSError):
+        _soft_dirty_supported = False
+    return _soft_dirty_supported
+
 def get_expected_output(fn):
     sys.stdout.flush()
     assert fn.endswith(".py")